@@ -0,0 +1,9 @@
+#!/bin/sh
+# Builds snekc on Linux and macOS with the LLVM found by llvm-config, override with CC, LLVM_CONFIG and CFLAGS
+set -e
+cd "$(dirname "$0")"
+CC=${CC:-cc}
+LLVM_CONFIG=${LLVM_CONFIG:-llvm-config}
+CFLAGS=${CFLAGS:--O2 -g -Wall -Wextra}
+mkdir -p build
+$CC -std=gnu11 $CFLAGS $($LLVM_CONFIG --cflags) src/*.c -o build/snekc $($LLVM_CONFIG --ldflags --libs all --system-libs) -lpthread
@@ -0,0 +1,140 @@
+#include "alloc.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "utils.h"
+
+const char* MEM_SUBSYSTEM_NAMES[NUM_MEM_SUBSYSTEMS] = { "driver", "input", "intern", "lexer", "parser", "resolver", "codegen", "lto", "linker", "runtime" };
+
+// Keeps the block behind it aligned like malloc's
+typedef union MEM_HEADER_t {
+	struct {
+		size_t size;
+		uint8_t subsystem;
+	};
+	max_align_t align;
+} MEM_HEADER;
+
+MEM_STATS mem_stats;
+THREAD_LOCAL uint8_t mem_subsystem;
+
+void* system_alloc(size_t size, uint8_t subsystem) {
+	(void)subsystem;
+	return malloc(size);
+}
+
+void* system_realloc(void* ptr, size_t size, uint8_t subsystem) {
+	(void)subsystem;
+	return realloc(ptr, size);
+}
+
+void system_free(void* ptr) {
+	free(ptr);
+}
+
+const ALLOCATOR SYSTEM_ALLOCATOR = { system_alloc, system_realloc, system_free };
+ALLOCATOR allocator = { system_alloc, system_realloc, system_free };
+
+void count_block(uint8_t subsystem, int64_t bytes, int64_t blocks, uint64_t allocations) {
+	mutex_lock(&mem_stats.lock);
+	MEM_COUNTERS* counters[] = { &mem_stats.subsystems[subsystem], &mem_stats.total };
+	for (int i = 0; i < 2; i++) {
+		MEM_COUNTERS* c = counters[i];
+		c->bytes += bytes;
+		c->peak_bytes = max(c->peak_bytes, c->bytes);
+		c->blocks += blocks;
+		c->allocations += allocations;
+	}
+	mutex_unlock(&mem_stats.lock);
+}
+
+void* tracking_alloc(size_t size, uint8_t subsystem) {
+	MEM_HEADER* header = malloc(sizeof(MEM_HEADER) + size);
+	if (!header) return NULL;
+	header->size = size;
+	header->subsystem = subsystem;
+	count_block(subsystem, size, 1, 1);
+	return header + 1;
+}
+
+void* tracking_realloc(void* ptr, size_t size, uint8_t subsystem) {
+	if (!ptr) return tracking_alloc(size, subsystem);
+	MEM_HEADER* header = realloc((MEM_HEADER*)ptr - 1, sizeof(MEM_HEADER) + size);
+	if (!header) return NULL;
+	int64_t growth = (int64_t)size - (int64_t)header->size;
+	header->size = size;
+	count_block(header->subsystem, growth, 0, 1);
+	return header + 1;
+}
+
+void tracking_free(void* ptr) {
+	if (!ptr) return;
+	MEM_HEADER* header = (MEM_HEADER*)ptr - 1;
+	count_block(header->subsystem, -(int64_t)header->size, -1, 0);
+	free(header);
+}
+
+const ALLOCATOR TRACKING_ALLOCATOR = { tracking_alloc, tracking_realloc, tracking_free };
+
+void mem_init(const ALLOCATOR* a) {
+	allocator = *a;
+	memset(&mem_stats, 0, sizeof(mem_stats));
+	mutex_init(&mem_stats.lock);
+	mem_subsystem = MEM_DRIVER;
+}
+
+void* mem_alloc(size_t size) {
+	return allocator.alloc(size, mem_subsystem);
+}
+
+void* mem_calloc(size_t count, size_t size) {
+	void* ptr = allocator.alloc(count * size, mem_subsystem);
+	if (ptr) memset(ptr, 0, count * size);
+	return ptr;
+}
+
+void* mem_realloc(void* ptr, size_t size) {
+	return allocator.realloc(ptr, size, mem_subsystem);
+}
+
+void mem_free(void* ptr) {
+	allocator.free(ptr);
+}
+
+uint8_t mem_enter(uint8_t subsystem) {
+	uint8_t previous = mem_subsystem;
+	mem_subsystem = subsystem;
+	return previous;
+}
+
+void mem_leave(uint8_t previous) {
+	mem_subsystem = previous;
+}
+
+void print_counters(FILE* out, const char* name, MEM_COUNTERS* c) {
+	fprintf(out, "%-10s %12llu %12.1f %12.1f %10llu\n", name, (unsigned long long)c->allocations, c->peak_bytes / 1024.0, c->bytes / 1024.0, (unsigned long long)c->blocks);
+}
+
+void mem_print_report(FILE* out) {
+	mutex_lock(&mem_stats.lock);
+	fputs("### MEMORY REPORT ###\n", out);
+	fprintf(out, "%-10s %12s %12s %12s %10s\n", "subsystem", "allocations", "peak KB", "live KB", "live");
+	for (uint8_t i = 0; i < NUM_MEM_SUBSYSTEMS; i++) {
+		if (mem_stats.subsystems[i].allocations) print_counters(out, MEM_SUBSYSTEM_NAMES[i], &mem_stats.subsystems[i]);
+	}
+	print_counters(out, "total", &mem_stats.total);
+	mutex_unlock(&mem_stats.lock);
+	fputc('\n', out);
+}
+
+uint64_t mem_check_leaks(FILE* out) {
+	mutex_lock(&mem_stats.lock);
+	uint64_t leaked = mem_stats.total.blocks;
+	for (uint8_t i = 0; i < NUM_MEM_SUBSYSTEMS; i++) {
+		MEM_COUNTERS* c = &mem_stats.subsystems[i];
+		if (c->blocks) fprintf(out, "Leaked %llu blocks (%llu bytes) allocated by %s\n", (unsigned long long)c->blocks, (unsigned long long)c->bytes, MEM_SUBSYSTEM_NAMES[i]);
+	}
+	mutex_unlock(&mem_stats.lock);
+	return leaked;
+}
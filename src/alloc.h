@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "thread.h"
+
+// Every heap allocation of the compiler goes through the installed ALLOCATOR and is attributed to the subsystem
+// the calling thread is working in. Subsystems enter their scope at their entry points with mem_enter, so vectors
+// and strings are counted where they are created. Reallocations and frees stay with the subsystem that allocated.
+// Memory allocated by LLVM and the C library is not counted.
+
+enum MEM_SUBSYSTEM {
+	MEM_DRIVER,
+	MEM_INPUT, // source files, line tables, diagnostics
+	MEM_INTERN,
+	MEM_LEXER,
+	MEM_PARSER, // including the AST
+	MEM_RESOLVER, // including the types of the AST
+	MEM_CODEGEN,
+	MEM_LTO,
+	MEM_LINKER,
+	MEM_RUNTIME, // thread pool, stack segments, profiling events
+	NUM_MEM_SUBSYSTEMS
+};
+
+extern const char* MEM_SUBSYSTEM_NAMES[NUM_MEM_SUBSYSTEMS];
+
+typedef struct ALLOCATOR_t {
+	void* (*alloc)(size_t size, uint8_t subsystem);
+	void* (*realloc)(void* ptr, size_t size, uint8_t subsystem); // subsystem is only used if ptr is NULL
+	void (*free)(void* ptr);
+} ALLOCATOR;
+
+// malloc, realloc and free without any accounting
+extern const ALLOCATOR SYSTEM_ALLOCATOR;
+// Keeps the size and subsystem in a header in front of every block and counts them
+extern const ALLOCATOR TRACKING_ALLOCATOR;
+
+typedef struct MEM_COUNTERS_t {
+	uint64_t bytes; // live
+	uint64_t peak_bytes; // high-water mark of bytes
+	uint64_t blocks; // live
+	uint64_t allocations; // all that were ever made, reallocations included
+} MEM_COUNTERS;
+
+typedef struct MEM_STATS_t {
+	MUTEX lock;
+	MEM_COUNTERS subsystems[NUM_MEM_SUBSYSTEMS];
+	MEM_COUNTERS total; // its peak is that of the sum, not the sum of the peaks
+} MEM_STATS;
+
+extern ALLOCATOR allocator;
+extern MEM_STATS mem_stats;
+extern THREAD_LOCAL uint8_t mem_subsystem;
+
+// Installs the allocator, must be called before anything is allocated since blocks can't change allocators
+void mem_init(const ALLOCATOR* a);
+
+void* mem_alloc(size_t size);
+void* mem_calloc(size_t count, size_t size);
+void* mem_realloc(void* ptr, size_t size);
+void mem_free(void* ptr);
+
+// Attributes the thread's following allocations to subsystem, returns the previous one to be restored with mem_leave
+uint8_t mem_enter(uint8_t subsystem);
+void mem_leave(uint8_t previous);
+
+void mem_print_report(FILE* out);
+// Prints the blocks that are still allocated per subsystem and returns their number
+uint64_t mem_check_leaks(FILE* out);
@@ -0,0 +1,76 @@
+#include "arena.h"
+
+#include <string.h>
+
+#include "alloc.h"
+#include "utils.h"
+
+#define ARENA_ALIGNMENT 8
+#define BLOCK_DATA(block) ((char*)(block) + sizeof(ARENA_BLOCK))
+
+ARENA arena_new(size_t block_size) {
+	ARENA a;
+	a.first = NULL;
+	a.current = NULL;
+	a.block_size = block_size;
+	return a;
+}
+
+void arena_delete(ARENA* a) {
+	ARENA_BLOCK* block = a->first;
+	while (block) {
+		ARENA_BLOCK* next = block->next;
+		mem_free(block);
+		block = next;
+	}
+	a->first = NULL;
+	a->current = NULL;
+}
+
+// Keeps the first block around so the arena can be refilled without going back to malloc
+void arena_reset(ARENA* a) {
+	if (!a->first) return;
+	ARENA_BLOCK* block = a->first->next;
+	while (block) {
+		ARENA_BLOCK* next = block->next;
+		mem_free(block);
+		block = next;
+	}
+	a->first->next = NULL;
+	a->first->used = 0;
+	a->current = a->first;
+}
+
+ARENA_BLOCK* arena_new_block(ARENA* a, size_t min_size) {
+	size_t size = max(a->block_size, min_size);
+	ARENA_BLOCK* block = mem_alloc(sizeof(ARENA_BLOCK) + size);
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	if (a->current) a->current->next = block;
+	else a->first = block;
+	a->current = block;
+	return block;
+}
+
+void* arena_alloc(ARENA* a, size_t size) {
+	size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+	ARENA_BLOCK* block = a->current;
+	if (!block || block->used + size > block->size) block = arena_new_block(a, size);
+	void* ptr = BLOCK_DATA(block) + block->used;
+	block->used += size;
+	return ptr;
+}
+
+void* arena_copy(ARENA* a, const void* src, size_t size) {
+	void* ptr = arena_alloc(a, size);
+	memcpy(ptr, src, size);
+	return ptr;
+}
+
+char* arena_strn(ARENA* a, const char* str, long len) {
+	char* ptr = arena_alloc(a, len + 1);
+	memcpy(ptr, str, len);
+	ptr[len] = 0;
+	return ptr;
+}
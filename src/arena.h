@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bump allocator, everything allocated from an arena is freed at once by arena_reset/arena_delete
+
+typedef struct ARENA_BLOCK_t {
+	struct ARENA_BLOCK_t* next;
+	size_t size;
+	size_t used;
+} ARENA_BLOCK;
+
+typedef struct ARENA_t {
+	ARENA_BLOCK* first;
+	ARENA_BLOCK* current;
+	size_t block_size;
+} ARENA;
+
+ARENA arena_new(size_t block_size);
+void arena_delete(ARENA* a);
+void arena_reset(ARENA* a);
+
+void* arena_alloc(ARENA* a, size_t size);
+void* arena_copy(ARENA* a, const void* src, size_t size);
+char* arena_strn(ARENA* a, const char* str, long len);
@@ -0,0 +1,215 @@
+#include "ast.h"
+
+#include <string.h>
+
+DEF_DYNAMIC_VECTOR(NODE, NODE_VEC, nodevec)
+DEF_DYNAMIC_VECTOR(NODE_LIST, NODE_LIST_VEC, nlvec)
+DEF_DYNAMIC_VECTOR(int64_t, INT_VEC, intvec)
+DEF_DYNAMIC_VECTOR(double, FLOAT_VEC, fltvec)
+DEF_DYNAMIC_VECTOR(ASSIGN, ASSIGN_VEC, assignvec)
+DEF_DYNAMIC_VECTOR(BINARY_OP, BINARY_OP_VEC, binopvec)
+DEF_DYNAMIC_VECTOR(UNARY_OP, UNARY_OP_VEC, unopvec)
+DEF_DYNAMIC_VECTOR(IF, IF_VEC, ifvec)
+DEF_DYNAMIC_VECTOR(LOOP, LOOP_VEC, loopvec)
+DEF_DYNAMIC_VECTOR(FUNC_CALL, FUNC_CALL_VEC, callvec)
+DEF_DYNAMIC_VECTOR(FUNC_DECL, FUNC_DECL_VEC, fdeclvec)
+DEF_DYNAMIC_VECTOR(FUNC_DEF, FUNC_DEF_VEC, fdefvec)
+DEF_DYNAMIC_VECTOR(VAR_DECL, VAR_DECL_VEC, vdvec)
+DEF_DYNAMIC_VECTOR(BINDING, BINDING_VEC, bindvec)
+DEF_DYNAMIC_VECTOR(AST, AST_VEC, astvec)
+
+AST ast_new() {
+	AST ast;
+
+	ast.capacity = 256;
+	ast.num_nodes = 0;
+	ast.types = mem_alloc(ast.capacity * sizeof(uint8_t));
+	ast.payloads = mem_alloc(ast.capacity * sizeof(uint32_t));
+	ast.offsets = mem_alloc(ast.capacity * sizeof(uint32_t));
+
+	ast.root = (NODE_LIST){ 0, 0 };
+
+	ast.lists = nodevec_new(64);
+	ast.ints = intvec_new(16);
+	ast.floats = fltvec_new(4);
+	ast.strings = strvec_new(4);
+	ast.names = strvec_new(64);
+	ast.blocks = nlvec_new(8);
+	ast.assigns = assignvec_new(8);
+	ast.binary_ops = binopvec_new(16);
+	ast.unary_ops = unopvec_new(8);
+	ast.ifs = ifvec_new(4);
+	ast.loops = loopvec_new(4);
+	ast.calls = callvec_new(16);
+	ast.func_decls = fdeclvec_new(4);
+	ast.func_defs = fdefvec_new(4);
+
+	ast.value_types = NULL;
+	ast.target_types = NULL;
+	ast.conversions = NULL;
+	ast.node_bindings = NULL;
+	ast.bindings = (BINDING_VEC){ 0 };
+
+	// Node 0 is the null node
+	ast_add_node(&ast, EXPR_TYPE_NULL, 0, 0);
+
+	return ast;
+}
+
+void ast_delete(AST* ast) {
+	mem_free(ast->types);
+	mem_free(ast->payloads);
+	mem_free(ast->offsets);
+
+	nodevec_delete(&ast->lists);
+	intvec_delete(&ast->ints);
+	fltvec_delete(&ast->floats);
+	strvec_delete(&ast->strings);
+	strvec_delete(&ast->names);
+	nlvec_delete(&ast->blocks);
+	assignvec_delete(&ast->assigns);
+	binopvec_delete(&ast->binary_ops);
+	unopvec_delete(&ast->unary_ops);
+	ifvec_delete(&ast->ifs);
+	loopvec_delete(&ast->loops);
+	callvec_delete(&ast->calls);
+	fdeclvec_delete(&ast->func_decls);
+	fdefvec_delete(&ast->func_defs);
+
+	mem_free(ast->value_types);
+	mem_free(ast->target_types);
+	mem_free(ast->conversions);
+	mem_free(ast->node_bindings);
+	bindvec_delete(&ast->bindings);
+}
+
+NODE ast_add_node(AST* ast, uint8_t type, uint32_t payload, uint32_t offset) {
+	if (ast->num_nodes == ast->capacity) {
+		ast->capacity *= 2;
+		ast->types = mem_realloc(ast->types, ast->capacity * sizeof(uint8_t));
+		ast->payloads = mem_realloc(ast->payloads, ast->capacity * sizeof(uint32_t));
+		ast->offsets = mem_realloc(ast->offsets, ast->capacity * sizeof(uint32_t));
+	}
+	ast->types[ast->num_nodes] = type;
+	ast->payloads[ast->num_nodes] = payload;
+	ast->offsets[ast->num_nodes] = offset;
+	return ast->num_nodes++;
+}
+
+NODE_LIST ast_add_list(AST* ast, NODE* nodes, uint32_t num_nodes) {
+	NODE_LIST list = { (uint32_t)ast->lists.size, num_nodes };
+	for (uint32_t i = 0; i < num_nodes; i++) nodevec_push(&ast->lists, nodes[i]);
+	return list;
+}
+
+NODE ast_int_literal(AST* ast, int64_t value, uint32_t offset) {
+	intvec_push(&ast->ints, value);
+	return ast_add_node(ast, EXPR_TYPE_INT_LITERAL, (uint32_t)ast->ints.size - 1, offset);
+}
+
+NODE ast_char_literal(AST* ast, uint8_t value, uint32_t offset) {
+	return ast_add_node(ast, EXPR_TYPE_CHAR_LITERAL, value, offset);
+}
+
+NODE ast_bool_literal(AST* ast, bool value, uint32_t offset) {
+	return ast_add_node(ast, EXPR_TYPE_BOOL_LITERAL, value, offset);
+}
+
+NODE ast_float_literal(AST* ast, double value, uint32_t offset) {
+	fltvec_push(&ast->floats, value);
+	return ast_add_node(ast, EXPR_TYPE_FLOAT_LITERAL, (uint32_t)ast->floats.size - 1, offset);
+}
+
+NODE ast_string_literal(AST* ast, char* value, uint32_t offset) {
+	strvec_push(&ast->strings, value);
+	return ast_add_node(ast, EXPR_TYPE_STRING_LITERAL, (uint32_t)ast->strings.size - 1, offset);
+}
+
+NODE ast_identifier(AST* ast, char* name, uint32_t offset) {
+	strvec_push(&ast->names, name);
+	return ast_add_node(ast, EXPR_TYPE_IDENTIFIER, (uint32_t)ast->names.size - 1, offset);
+}
+
+NODE ast_compound_expr(AST* ast, NODE expr, uint32_t offset) {
+	return ast_add_node(ast, EXPR_TYPE_COMPOUND_EXPR, expr, offset);
+}
+
+NODE ast_assign(AST* ast, ASSIGN assign, uint32_t offset) {
+	assignvec_push(&ast->assigns, assign);
+	return ast_add_node(ast, EXPR_TYPE_ASSIGN, (uint32_t)ast->assigns.size - 1, offset);
+}
+
+NODE ast_binary_op(AST* ast, BINARY_OP binary_op, uint32_t offset) {
+	binopvec_push(&ast->binary_ops, binary_op);
+	return ast_add_node(ast, EXPR_TYPE_BINARY_OP, (uint32_t)ast->binary_ops.size - 1, offset);
+}
+
+NODE ast_unary_op(AST* ast, UNARY_OP unary_op, uint32_t offset) {
+	unopvec_push(&ast->unary_ops, unary_op);
+	return ast_add_node(ast, EXPR_TYPE_UNARY_OP, (uint32_t)ast->unary_ops.size - 1, offset);
+}
+
+NODE ast_compound(AST* ast, NODE_LIST block, uint32_t offset) {
+	nlvec_push(&ast->blocks, block);
+	return ast_add_node(ast, EXPR_TYPE_COMPOUND, (uint32_t)ast->blocks.size - 1, offset);
+}
+
+NODE ast_return(AST* ast, NODE value, uint32_t offset) {
+	return ast_add_node(ast, EXPR_TYPE_RETURN, value, offset);
+}
+
+NODE ast_if_statement(AST* ast, IF if_statement, uint32_t offset) {
+	ifvec_push(&ast->ifs, if_statement);
+	return ast_add_node(ast, EXPR_TYPE_IF_STATEMENT, (uint32_t)ast->ifs.size - 1, offset);
+}
+
+NODE ast_loop(AST* ast, LOOP loop, uint32_t offset) {
+	loopvec_push(&ast->loops, loop);
+	return ast_add_node(ast, EXPR_TYPE_LOOP, (uint32_t)ast->loops.size - 1, offset);
+}
+
+NODE ast_break(AST* ast, uint8_t idx, uint32_t offset) {
+	return ast_add_node(ast, EXPR_TYPE_BREAK, idx, offset);
+}
+
+NODE ast_continue(AST* ast, uint8_t idx, uint32_t offset) {
+	return ast_add_node(ast, EXPR_TYPE_CONTINUE, idx, offset);
+}
+
+NODE ast_func_call(AST* ast, FUNC_CALL func_call, uint32_t offset) {
+	callvec_push(&ast->calls, func_call);
+	return ast_add_node(ast, EXPR_TYPE_FUNC_CALL, (uint32_t)ast->calls.size - 1, offset);
+}
+
+NODE ast_func_decl(AST* ast, FUNC_DECL func_decl, uint32_t offset) {
+	fdeclvec_push(&ast->func_decls, func_decl);
+	return ast_add_node(ast, EXPR_TYPE_FUNC_DECL, (uint32_t)ast->func_decls.size - 1, offset);
+}
+
+NODE ast_func_def(AST* ast, FUNC_DEF func_def, uint32_t offset) {
+	fdefvec_push(&ast->func_defs, func_def);
+	return ast_add_node(ast, EXPR_TYPE_FUNC_DEF, (uint32_t)ast->func_defs.size - 1, offset);
+}
+
+NODE ast_import(AST* ast, char* module_name, uint32_t offset) {
+	strvec_push(&ast->names, module_name);
+	return ast_add_node(ast, EXPR_TYPE_IMPORT, (uint32_t)ast->names.size - 1, offset);
+}
+
+size_t ast_memory_size(AST* ast) {
+	return ast->num_nodes * (sizeof(uint8_t) + 2 * sizeof(uint32_t))
+		+ ast->lists.size * sizeof(NODE)
+		+ ast->ints.size * sizeof(int64_t)
+		+ ast->floats.size * sizeof(double)
+		+ ast->strings.size * sizeof(char*)
+		+ ast->names.size * sizeof(char*)
+		+ ast->blocks.size * sizeof(NODE_LIST)
+		+ ast->assigns.size * sizeof(ASSIGN)
+		+ ast->binary_ops.size * sizeof(BINARY_OP)
+		+ ast->unary_ops.size * sizeof(UNARY_OP)
+		+ ast->ifs.size * sizeof(IF)
+		+ ast->loops.size * sizeof(LOOP)
+		+ ast->calls.size * sizeof(FUNC_CALL)
+		+ ast->func_decls.size * sizeof(FUNC_DECL)
+		+ ast->func_defs.size * sizeof(FUNC_DEF);
+}
@@ -5,6 +5,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "utils.h"
+#include "types.h"
+
 enum EXPR_TYPE {
 	EXPR_TYPE_NULL,
 	EXPR_TYPE_INT_LITERAL,
@@ -32,85 +35,52 @@ enum EXPR_TYPE {
 	EXPR_TYPE_IMPORT
 };
 
-typedef struct EXPRESSION_t EXPRESSION;
-
-typedef struct INT_t {
-	int64_t value;
-} INT;
-
-typedef struct CHAR_t {
-	uint8_t value;
-} CHAR;
-
-typedef struct BOOL_t {
-	bool value;
-} BOOL;
+// Nodes are 32 bit handles into the AST of their module, node 0 is the null node.
+// The type of every node lives in a dense array, its payload is either stored inline
+// (char, bool, break/continue index, single child) or is an index into the pool of its kind.
+// Every node also records the byte offset of the token it starts at (or of its operator) in the module's source.
+typedef uint32_t NODE;
 
-typedef struct FLOAT_t {
-	double value;
-} FLOAT;
+#define NODE_NULL 0
 
-typedef struct STRING_t {
-	char* value;
-} STRING;
-
-typedef struct IDENTIFIER_t {
-	char* name;
-} IDENTIFIER;
-
-typedef struct COMPOUND_EXPR_t {
-	EXPRESSION* expr;
-} COMPOUND_EXPR;
+// Range of nodes in AST.lists, used for blocks and call arguments
+typedef struct NODE_LIST_t {
+	uint32_t first;
+	uint32_t size;
+} NODE_LIST;
 
 typedef struct ASSIGN_t {
-	char* op;
-	EXPRESSION* left;
-	EXPRESSION* right;
+	uint8_t op; // OP_TYPE
+	NODE left;
+	NODE right;
 } ASSIGN;
 
 typedef struct BINARY_OP_t {
-	char* op;
-	EXPRESSION* left;
-	EXPRESSION* right;
+	uint8_t op;
+	NODE left;
+	NODE right;
 } BINARY_OP;
 
 typedef struct UNARY_OP_t {
-	char* op;
+	uint8_t op;
 	bool position;
-	EXPRESSION* expr;
+	NODE expr;
 } UNARY_OP;
 
-typedef struct COMPOUND_t {
-	struct AST* ast;
-} COMPOUND;
-
-typedef struct RETURN_t {
-	EXPRESSION* value;
-} RETURN;
-
 typedef struct IF_t {
-	EXPRESSION* condition;
-	EXPRESSION* then_block;
-	EXPRESSION* else_block;
+	NODE condition;
+	NODE then_block;
+	NODE else_block;
 } IF;
 
 typedef struct LOOP_t {
-	EXPRESSION* condition;
-	EXPRESSION* body;
+	NODE condition;
+	NODE body;
 } LOOP;
 
-typedef struct BREAK_t {
-	uint8_t idx;
-} BREAK;
-
-typedef struct CONTINUE_t {
-	uint8_t idx;
-} CONTINUE;
-
 typedef struct FUNC_CALL_t {
-	EXPRESSION* callee;
-	EXPRESSION* args;
-	uint8_t num_args;
+	NODE callee;
+	NODE_LIST args;
 } FUNC_CALL;
 
 typedef struct TYPE_t {
@@ -131,42 +101,128 @@ typedef struct FUNC_DECL_t {
 
 typedef struct FUNC_DEF_t {
 	FUNC_DECL decl;
-	EXPRESSION* body;
+	NODE body;
 } FUNC_DEF;
 
-typedef struct IMPORT_t {
-	char* module_name;
-} IMPORT;
-
-typedef struct EXPRESSION_t {
-	uint8_t type;
-	union {
-		INT int_literal;
-		CHAR char_literal;
-		BOOL bool_literal;
-		FLOAT float_literal;
-		STRING string_literal;
-		IDENTIFIER identifier;
-		COMPOUND_EXPR compound_expr;
-
-		ASSIGN assign;
-		BINARY_OP binary_op;
-		UNARY_OP unary_op;
-		COMPOUND compound;
-		RETURN ret_statement;
-		IF if_statement;
-		LOOP loop;
-		BREAK break_statement;
-		CONTINUE continue_statement;
-		FUNC_CALL func_call;
-		FUNC_DECL func_decl;
-		FUNC_DEF func_def;
-
-		IMPORT import;
-	};
-} EXPRESSION;
+enum BINDING_KIND {
+	BINDING_LOCAL,
+	BINDING_PARAM,
+	BINDING_FUNCTION
+};
+
+// Declaration a name resolves to, created by the resolver
+typedef struct BINDING_t {
+	char* name;
+	TYPE_ID type;
+	uint8_t kind;
+	uint32_t owner; // function binding a local or parameter belongs to, 0 at module level
+	uint32_t first_param; // defined functions: binding of the first parameter, the others follow it
+	bool needs_storage; // assigned after its definition or passed by reference, otherwise codegen keeps it in an SSA value
+} BINDING;
+
+DECL_DYNAMIC_VECTOR(NODE, NODE_VEC, nodevec)
+DECL_DYNAMIC_VECTOR(NODE_LIST, NODE_LIST_VEC, nlvec)
+DECL_DYNAMIC_VECTOR(int64_t, INT_VEC, intvec)
+DECL_DYNAMIC_VECTOR(double, FLOAT_VEC, fltvec)
+DECL_DYNAMIC_VECTOR(ASSIGN, ASSIGN_VEC, assignvec)
+DECL_DYNAMIC_VECTOR(BINARY_OP, BINARY_OP_VEC, binopvec)
+DECL_DYNAMIC_VECTOR(UNARY_OP, UNARY_OP_VEC, unopvec)
+DECL_DYNAMIC_VECTOR(IF, IF_VEC, ifvec)
+DECL_DYNAMIC_VECTOR(LOOP, LOOP_VEC, loopvec)
+DECL_DYNAMIC_VECTOR(FUNC_CALL, FUNC_CALL_VEC, callvec)
+DECL_DYNAMIC_VECTOR(FUNC_DECL, FUNC_DECL_VEC, fdeclvec)
+DECL_DYNAMIC_VECTOR(FUNC_DEF, FUNC_DEF_VEC, fdefvec)
+DECL_DYNAMIC_VECTOR(VAR_DECL, VAR_DECL_VEC, vdvec)
+DECL_DYNAMIC_VECTOR(BINDING, BINDING_VEC, bindvec)
 
 typedef struct AST_t {
-	EXPRESSION* expressions;
-	uint64_t num_expressions;
+	uint8_t* types;
+	uint32_t* payloads;
+	uint32_t* offsets;
+	uint32_t num_nodes;
+	uint32_t capacity;
+
+	NODE_LIST root;
+
+	NODE_VEC lists;
+	INT_VEC ints;
+	FLOAT_VEC floats;
+	STRING_VEC strings;
+	STRING_VEC names;
+	NODE_LIST_VEC blocks;
+	ASSIGN_VEC assigns;
+	BINARY_OP_VEC binary_ops;
+	UNARY_OP_VEC unary_ops;
+	IF_VEC ifs;
+	LOOP_VEC loops;
+	FUNC_CALL_VEC calls;
+	FUNC_DECL_VEC func_decls;
+	FUNC_DEF_VEC func_defs;
+
+	// Filled in by the resolver: the type of every node's value, the conversion applied where it is used and the
+	// binding of identifiers, variable definitions and functions. Binding 0 is unused.
+	TYPE_ID* value_types;
+	TYPE_ID* target_types;
+	uint8_t* conversions;
+	uint32_t* node_bindings;
+	BINDING_VEC bindings;
 } AST;
+
+DECL_DYNAMIC_VECTOR(AST, AST_VEC, astvec)
+
+#define AST_TYPE(ast, node) ((ast)->types[node])
+#define AST_PAYLOAD(ast, node) ((ast)->payloads[node])
+#define AST_OFFSET(ast, node) ((ast)->offsets[node])
+
+#define AST_INT(ast, node) ((ast)->ints.buffer[(ast)->payloads[node]])
+#define AST_FLOAT(ast, node) ((ast)->floats.buffer[(ast)->payloads[node]])
+#define AST_STRING(ast, node) ((ast)->strings.buffer[(ast)->payloads[node]])
+#define AST_NAME(ast, node) ((ast)->names.buffer[(ast)->payloads[node]])
+#define AST_CHILD(ast, node) ((NODE)(ast)->payloads[node])
+#define AST_BLOCK(ast, node) ((ast)->blocks.buffer[(ast)->payloads[node]])
+#define AST_ASSIGN(ast, node) (&(ast)->assigns.buffer[(ast)->payloads[node]])
+#define AST_BINARY_OP(ast, node) (&(ast)->binary_ops.buffer[(ast)->payloads[node]])
+#define AST_UNARY_OP(ast, node) (&(ast)->unary_ops.buffer[(ast)->payloads[node]])
+#define AST_IF(ast, node) (&(ast)->ifs.buffer[(ast)->payloads[node]])
+#define AST_LOOP(ast, node) (&(ast)->loops.buffer[(ast)->payloads[node]])
+#define AST_FUNC_CALL(ast, node) (&(ast)->calls.buffer[(ast)->payloads[node]])
+#define AST_FUNC_DECL(ast, node) (&(ast)->func_decls.buffer[(ast)->payloads[node]])
+#define AST_FUNC_DEF(ast, node) (&(ast)->func_defs.buffer[(ast)->payloads[node]])
+
+#define AST_LIST_NODE(ast, list, i) ((ast)->lists.buffer[(list).first + (i)])
+
+#define AST_VALUE_TYPE(ast, node) ((ast)->value_types[node])
+#define AST_TARGET_TYPE(ast, node) ((ast)->target_types[node])
+#define AST_CONVERSION(ast, node) ((ast)->conversions[node])
+#define AST_BINDING_ID(ast, node) ((ast)->node_bindings[node])
+#define AST_BINDING(ast, id) (&(ast)->bindings.buffer[id])
+
+AST ast_new();
+void ast_delete(AST* ast);
+
+NODE ast_add_node(AST* ast, uint8_t type, uint32_t payload, uint32_t offset);
+NODE_LIST ast_add_list(AST* ast, NODE* nodes, uint32_t num_nodes);
+
+NODE ast_int_literal(AST* ast, int64_t value, uint32_t offset);
+NODE ast_char_literal(AST* ast, uint8_t value, uint32_t offset);
+NODE ast_bool_literal(AST* ast, bool value, uint32_t offset);
+NODE ast_float_literal(AST* ast, double value, uint32_t offset);
+NODE ast_string_literal(AST* ast, char* value, uint32_t offset);
+NODE ast_identifier(AST* ast, char* name, uint32_t offset);
+NODE ast_compound_expr(AST* ast, NODE expr, uint32_t offset);
+NODE ast_assign(AST* ast, ASSIGN assign, uint32_t offset);
+NODE ast_binary_op(AST* ast, BINARY_OP binary_op, uint32_t offset);
+NODE ast_unary_op(AST* ast, UNARY_OP unary_op, uint32_t offset);
+NODE ast_compound(AST* ast, NODE_LIST block, uint32_t offset);
+NODE ast_return(AST* ast, NODE value, uint32_t offset);
+NODE ast_if_statement(AST* ast, IF if_statement, uint32_t offset);
+NODE ast_loop(AST* ast, LOOP loop, uint32_t offset);
+NODE ast_break(AST* ast, uint8_t idx, uint32_t offset);
+NODE ast_continue(AST* ast, uint8_t idx, uint32_t offset);
+NODE ast_func_call(AST* ast, FUNC_CALL func_call, uint32_t offset);
+NODE ast_func_decl(AST* ast, FUNC_DECL func_decl, uint32_t offset);
+NODE ast_func_def(AST* ast, FUNC_DEF func_def, uint32_t offset);
+NODE ast_import(AST* ast, char* module_name, uint32_t offset);
+
+// Bytes used by the node arrays and pools (excluding spare capacity and strings)
+size_t ast_memory_size(AST* ast);
@@ -1,25 +1,95 @@
-#include <stdlib.h>
-#include <stdio.h>
-
-char* load_file(const char* filepath) {
-	FILE* file = fopen(filepath, "rb");
-	fseek(file, 0, SEEK_END);
-	long length = ftell(file);
-	rewind(file);
-	char* buffer = malloc(length + 1);
-	fread(buffer, 1, length, file);
-	buffer[length] = 0;
-	fclose(file);
-	return buffer;
-	/*
-	FILE* file = fopen(filepath, "rb");
-	fseek(file, 0, SEEK_END);
-	long length = ftell(file);
-	fseek(file, 0, SEEK_SET);
-	char* buffer = malloc(length + 1);
-	fread(buffer, 0, length, file);
-	buffer[length] = 0;
-	fclose(file);
-	return buffer;
-	*/
+#define _FILE_OFFSET_BITS 64
+
+#include "file.h"
+
+#include <string.h>
+
+#include "alloc.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Reads a stream of unknown length into a heap buffer
+bool read_stream(FILE* stream, SOURCE_FILE* file) {
+	uint8_t subsystem = mem_enter(MEM_INPUT);
+	size_t capacity = 64 * 1024;
+	size_t size = 0;
+	char* buffer = mem_alloc(capacity + 1);
+	size_t n;
+	while ((n = fread(buffer + size, 1, capacity - size, stream)) > 0) {
+		size += n;
+		if (size == capacity) {
+			capacity *= 2;
+			buffer = mem_realloc(buffer, capacity + 1);
+		}
+	}
+	mem_leave(subsystem);
+	if (ferror(stream)) {
+		mem_free(buffer);
+		return false;
+	}
+	buffer[size] = 0;
+	*file = (SOURCE_FILE){ buffer, size, NULL, 0 };
+	return true;
+}
+
+#ifndef _WIN32
+// The mapping is one byte longer than the file, rounded up to whole pages. The bytes past the end of
+// the file are either the zero filled tail of its last page or an anonymous zero page, so the sentinel costs nothing.
+bool map_file(int fd, size_t size, SOURCE_FILE* file) {
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	size_t mapping_size = (size + 1 + page_size - 1) & ~(page_size - 1);
+	char* base = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) return false;
+	if (size > 0) {
+		if (mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+			munmap(base, mapping_size);
+			return false;
+		}
+		madvise(base, size, MADV_SEQUENTIAL);
+	}
+	*file = (SOURCE_FILE){ base, size, base, mapping_size };
+	return true;
+}
+#endif
+
+bool load_file(const char* filepath, SOURCE_FILE* file) {
+	if (strcmp(filepath, "-") == 0) return read_stream(stdin, file);
+
+#ifdef _WIN32
+	FILE* stream = fopen(filepath, "rb");
+	if (!stream) return false;
+	bool result = read_stream(stream, file);
+	fclose(stream);
+	return result;
+#else
+	int fd = open(filepath, O_RDONLY);
+	if (fd == -1) return false;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (uint64_t)st.st_size < SIZE_MAX && map_file(fd, (size_t)st.st_size, file)) {
+		close(fd);
+		return true;
+	}
+	FILE* stream = fdopen(fd, "rb");
+	if (!stream) {
+		close(fd);
+		return false;
+	}
+	bool result = read_stream(stream, file);
+	fclose(stream);
+	return result;
+#endif
+}
+
+void unload_file(SOURCE_FILE* file) {
+#ifndef _WIN32
+	if (file->mapping) munmap(file->mapping, file->mapping_size);
+	else
+#endif
+	mem_free((char*)file->data);
+	*file = (SOURCE_FILE){ 0 };
 }
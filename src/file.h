@@ -2,5 +2,18 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 
-char* load_file(const char* filepath);
+// Read-only view of a source file, data[size] is always 0.
+// Regular files are memory mapped, pipes and stdin ("-") are read into a heap buffer.
+typedef struct SOURCE_FILE_t {
+	const char* data;
+	size_t size;
+
+	void* mapping;
+	size_t mapping_size;
+} SOURCE_FILE;
+
+bool load_file(const char* filepath, SOURCE_FILE* file);
+void unload_file(SOURCE_FILE* file);
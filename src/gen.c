@@ -2,33 +2,39 @@
 
 #include <string.h>
 
-#include <llvm-c/TargetMachine.h>
-#include <llvm-c/Linker.h>
-
-SCOPE* scope_new(SCOPE* parent) {
-	SCOPE* scope = malloc(sizeof(SCOPE));
-	*scope = (SCOPE){ parent };
-
-	scope->break_dest = NULL;
-	scope->continue_dest = NULL;
+#include "operators.h"
+#include "stack.h"
+#include "stats.h"
 
-	scope->locals_k = strvec_new(8);
-	scope->locals_v = valvec_new(8);
-
-	return scope;
+#include <llvm-c/Linker.h>
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+// Scopes live on the stack of the function that enters them
+void scope_push(CODEGEN* g, SCOPE* scope) {
+	*scope = (SCOPE){ g->current_scope, NULL, NULL };
+	g->current_scope = scope;
 }
 
-void scope_delete(SCOPE* scope) {
-	strvec_delete(&scope->locals_k);
-	valvec_delete(&scope->locals_v);
-	free(scope);
+void scope_pop(CODEGEN* g) {
+	g->current_scope = g->current_scope->parent;
 }
 
 CODEGEN gen_new() {
+	uint8_t subsystem = mem_enter(MEM_CODEGEN);
 	CODEGEN g;
 
 	g.llvm_context = LLVMContextCreate();
 	g.llvm_builder = LLVMCreateBuilderInContext(g.llvm_context);
+	g.alloca_builder = LLVMCreateBuilderInContext(g.llvm_context);
 	g.module_name_vec = strvec_new(2);
 	g.module_ast_vec = astvec_new(2);
 	g.module_vec = mdvec_new(2);
@@ -39,8 +45,23 @@ CODEGEN gen_new() {
 	g.llvm_func = NULL;
 	g.has_branched = false;
 
-	g.globals_k = strvec_new(8);
-	g.globals_v = valvec_new(8);
+	g.binding_values = NULL;
+	g.llvm_types = NULL;
+	g.num_llvm_types = 0;
+
+	g.opt_level = 0;
+	g.passes = NULL;
+	g.lto = LTO_NONE;
+	g.num_partitions = 1;
+	g.thin_lto = thinlto_new();
+	g.target_machine = NULL;
+	g.pool = NULL;
+	g.emit = EMIT_FLAG(EMIT_EXE);
+	g.llvm_out = NULL;
+	g.asm_out = NULL;
+	g.output_path = NULL;
+	g.run = false;
+	g.run_status = 0;
 
 	LLVMInitializeX86TargetInfo();
 	LLVMInitializeX86Target();
@@ -48,90 +69,174 @@ CODEGEN gen_new() {
 	LLVMInitializeX86AsmParser();
 	LLVMInitializeX86AsmPrinter();
 
+	mem_leave(subsystem);
 	return g;
 }
 
 void gen_delete(CODEGEN* codegen) {
-	for (int i = 0; i < codegen->module_name_vec.size; i++) free(codegen->module_name_vec.buffer[i]);
 	strvec_delete(&codegen->module_name_vec);
 	astvec_delete(&codegen->module_ast_vec);
 	mdvec_delete(&codegen->module_vec);
 
-	strvec_delete(&codegen->globals_k);
-	valvec_delete(&codegen->globals_v);
+	mem_free(codegen->llvm_types);
+	LLVMDisposeBuilder(codegen->llvm_builder);
+	LLVMDisposeBuilder(codegen->alloca_builder);
+	if (codegen->target_machine) LLVMDisposeTargetMachine(codegen->target_machine);
+	thinlto_delete(&codegen->thin_lto);
+	// Also frees the modules that were not linked
+	LLVMContextDispose(codegen->llvm_context);
 }
 
-LLVMValueRef find_local_value(SCOPE* s, char* name) {
-	for (int i = 0; i < s->locals_k.size; i++) {
-		if (strcmp(s->locals_k.buffer[i], name) == 0) return s->locals_v.buffer[i];
+// Copy of g's options for generating one module on a worker thread, with a context, builders and target machine of its own
+CODEGEN gen_new_worker(CODEGEN* g) {
+	CODEGEN w = *g;
+	w.llvm_context = LLVMContextCreate();
+	w.llvm_builder = LLVMCreateBuilderInContext(w.llvm_context);
+	w.alloca_builder = LLVMCreateBuilderInContext(w.llvm_context);
+	w.llvm_module = NULL;
+	w.llvm_types = NULL;
+	w.num_llvm_types = 0;
+	w.target_machine = NULL;
+	return w;
+}
+
+// The context outlives the worker, it still holds the generated module
+void gen_delete_worker(CODEGEN* w) {
+	mem_free(w->llvm_types);
+	LLVMDisposeBuilder(w->llvm_builder);
+	LLVMDisposeBuilder(w->alloca_builder);
+	if (w->target_machine) LLVMDisposeTargetMachine(w->target_machine);
+}
+
+// Created on first use, after the driver has set the optimization level
+LLVMTargetMachineRef gen_target_machine(CODEGEN* g) {
+	if (g->target_machine) return g->target_machine;
+
+	LLVMTargetRef target;
+	char* error = NULL;
+	if (LLVMGetTargetFromTriple(LLVM_DEFAULT_TARGET_TRIPLE, &target, &error)) {
+		printf("%s\n", error);
+		LLVMDisposeMessage(error);
+		return NULL;
 	}
-	return NULL;
+	char* cpu = "generic";
+	char* features = "";
+	static const LLVMCodeGenOptLevel CODEGEN_LEVELS[] = { LLVMCodeGenLevelNone, LLVMCodeGenLevelLess, LLVMCodeGenLevelDefault, LLVMCodeGenLevelAggressive };
+	LLVMRelocMode reloc = LLVMRelocDefault;
+	LLVMCodeModel code_model = LLVMCodeModelDefault;
+	g->target_machine = LLVMCreateTargetMachine(target, LLVM_DEFAULT_TARGET_TRIPLE, cpu, features, CODEGEN_LEVELS[g->opt_level], reloc, code_model);
+	return g->target_machine;
 }
 
-LLVMValueRef find_global_value(CODEGEN* g, char* name) {
-	for (int i = 0; i < g->globals_k.size; i++) {
-		if (strcmp(g->globals_k.buffer[i], name) == 0) return g->globals_v.buffer[i];
+// Modules carry the target's data layout, so the optimizer knows type sizes and alignments
+void gen_set_target(CODEGEN* g, LLVMModuleRef module) {
+	LLVMTargetMachineRef target_machine = gen_target_machine(g);
+	if (!target_machine) return;
+	LLVMSetTarget(module, LLVM_DEFAULT_TARGET_TRIPLE);
+	LLVMTargetDataRef data_layout = LLVMCreateTargetDataLayout(target_machine);
+	LLVMSetModuleDataLayout(module, data_layout);
+	LLVMDisposeTargetData(data_layout);
+}
+
+uint64_t count_instructions(LLVMModuleRef module) {
+	uint64_t count = 0;
+	for (LLVMValueRef func = LLVMGetFirstFunction(module); func; func = LLVMGetNextFunction(func)) {
+		for (LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(func); block; block = LLVMGetNextBasicBlock(block)) {
+			for (LLVMValueRef inst = LLVMGetFirstInstruction(block); inst; inst = LLVMGetNextInstruction(inst)) count++;
+		}
 	}
-	return NULL;
+	return count;
 }
 
-LLVMValueRef find_named_value(CODEGEN* g, SCOPE* s, char* name) {
-	if (!s) return NULL;
-	LLVMValueRef result = NULL;
-	if (result = find_local_value(s, name)) return result;
-	if (result = find_named_value(g, s->parent, name)) return result;
-	if (result = find_global_value(g, name)) return result;
-	return NULL;
+char* module_identifier(LLVMModuleRef module) {
+	size_t len = 0;
+	return (char*)LLVMGetModuleIdentifier(module, &len);
 }
 
-LLVMTypeRef get_llvm_type_from_str(char* name, bool cpy) {
-	LLVMTypeRef val_type = NULL;
-	if (strlen(name) >= 2 && name[0] == 'i') {
-		int bitsize = strtol(name + 1, NULL, 10);
-		val_type = LLVMIntType(bitsize);
+void gen_run_passes(CODEGEN* g, LLVMModuleRef module, const char* passes) {
+	double start = stats_begin();
+	LLVMPassBuilderOptionsRef options = LLVMCreatePassBuilderOptions();
+	LLVMPassBuilderOptionsSetLoopInterleaving(options, g->opt_level >= 2);
+	LLVMPassBuilderOptionsSetLoopVectorization(options, g->opt_level >= 2);
+	LLVMPassBuilderOptionsSetSLPVectorization(options, g->opt_level >= 2);
+	LLVMErrorRef error = LLVMRunPasses(module, passes, gen_target_machine(g), options);
+	LLVMDisposePassBuilderOptions(options);
+	if (error) {
+		char* msg = LLVMGetErrorMessage(error);
+		printf("Can't run passes '%s': %s\n", passes, msg);
+		LLVMDisposeErrorMessage(msg);
 	}
-	if (!val_type) return NULL;
-	return cpy ? val_type : LLVMPointerType(val_type, 0);
+	stats_end(PHASE_OPTIMIZE, module_identifier(module), start, stats.enabled ? count_instructions(module) : 0);
 }
 
-LLVMTypeRef get_llvm_type(TYPE* type) {
-	return get_llvm_type_from_str(type->name, type->cpy);
+// Runs the default pipeline of the optimization level (like clang's -On) or the custom one given with --passes=.
+// With LTO the modules only get the pre-link pipeline, the rest runs after linking or importing.
+void gen_optimize(CODEGEN* g, LLVMModuleRef module) {
+	if (g->passes) {
+		gen_run_passes(g, module, g->passes);
+		return;
+	}
+	if (g->opt_level == 0) return;
+
+	static const char* PIPELINES[] = { "default<O%d>", "lto-pre-link<O%d>", "thinlto-pre-link<O%d>" };
+	char passes[32];
+	snprintf(passes, sizeof(passes), PIPELINES[g->lto], g->opt_level);
+	gen_run_passes(g, module, passes);
 }
 
-LLVMValueRef cast_value(CODEGEN* g, LLVMValueRef val, LLVMTypeRef type) {
-	LLVMTypeRef val_type = LLVMTypeOf(val);
-	if (LLVMTypeOf(val) == type) return val;
-	// Int-int cast
-	if (LLVMGetTypeKind(val_type) == LLVMIntegerTypeKind && LLVMGetTypeKind(type) == LLVMIntegerTypeKind) {
-		return LLVMGetIntTypeWidth(val_type) > LLVMGetIntTypeWidth(type)
-			? LLVMBuildTrunc(g->llvm_builder, val, type, "")
-			: LLVMBuildSExt(g->llvm_builder, val, type, "");
+// Everything but the entry point becomes internal, so the interprocedural passes see the whole program:
+// they inline across modules, propagate constants into functions and drop everything that is unused.
+void gen_optimize_linked(CODEGEN* g, LLVMModuleRef module, LLVMValueRef entry_point) {
+	for (LLVMValueRef func = LLVMGetFirstFunction(module); func; func = LLVMGetNextFunction(func)) {
+		if (func != entry_point && !LLVMIsDeclaration(func)) LLVMSetLinkage(func, LLVMInternalLinkage);
 	}
-	// Float-int cast
-	if ((LLVMGetTypeKind(val_type) == LLVMFloatTypeKind || LLVMGetTypeKind(val_type) == LLVMDoubleTypeKind)
-		&& LLVMGetTypeKind(type) == LLVMIntegerTypeKind) {
-		return LLVMBuildFPToSI(g->llvm_builder, val, type, "");
+	for (LLVMValueRef global = LLVMGetFirstGlobal(module); global; global = LLVMGetNextGlobal(global)) {
+		if (!LLVMIsDeclaration(global)) LLVMSetLinkage(global, LLVMInternalLinkage);
 	}
-	// Int-float cast
-	if (LLVMGetTypeKind(val_type) == LLVMIntegerTypeKind
-		&& (LLVMGetTypeKind(val_type) == LLVMFloatTypeKind || LLVMGetTypeKind(val_type) == LLVMDoubleTypeKind)) {
-		return LLVMBuildSIToFP(g->llvm_builder, val, type, "");
+
+	char passes[64];
+	snprintf(passes, sizeof(passes), "lto<O%d>,mergefunc,globaldce", max(g->opt_level, 1));
+	gen_run_passes(g, module, passes);
+}
+
+LLVMTypeRef gen_type(CODEGEN* g, TYPE_ID type) {
+	if (type >= g->num_llvm_types) {
+		uint32_t num_types = (uint32_t)type_table.types.size;
+		g->llvm_types = mem_realloc(g->llvm_types, num_types * sizeof(LLVMTypeRef));
+		memset(g->llvm_types + g->num_llvm_types, 0, (num_types - g->num_llvm_types) * sizeof(LLVMTypeRef));
+		g->num_llvm_types = num_types;
 	}
-	return NULL;
+	if (g->llvm_types[type]) return g->llvm_types[type];
+
+	TYPE_INFO* info = TYPE_INFO_OF(type);
+	LLVMTypeRef llvm_type = NULL;
+	switch (info->kind) {
+	case TYPE_KIND_VOID: llvm_type = LLVMVoidTypeInContext(g->llvm_context); break;
+	case TYPE_KIND_BOOL: llvm_type = LLVMInt1TypeInContext(g->llvm_context); break;
+	case TYPE_KIND_INT: llvm_type = LLVMIntTypeInContext(g->llvm_context, info->bits); break;
+	case TYPE_KIND_FLOAT: llvm_type = info->bits == 32 ? LLVMFloatTypeInContext(g->llvm_context) : LLVMDoubleTypeInContext(g->llvm_context); break;
+	case TYPE_KIND_POINTER: llvm_type = LLVMPointerType(gen_type(g, info->element), 0); break;
+	case TYPE_KIND_FUNCTION: {
+		LLVMTypeRef param_types[256];
+		for (int i = 0; i < info->num_params; i++) param_types[i] = gen_type(g, info->params[i]);
+		llvm_type = LLVMFunctionType(gen_type(g, info->element), param_types, info->num_params, false);
+		break;
+	}
+	}
+	g->llvm_types[type] = llvm_type;
+	return llvm_type;
 }
 
+// Stack slots are allocated at the start of the entry block, so they are allocated once per call even inside loops
 LLVMValueRef alloc_value(CODEGEN* g, char* name, LLVMTypeRef type) {
 	LLVMBasicBlockRef entry_block = LLVMGetEntryBasicBlock(g->llvm_func);
-	LLVMBuilderRef new_builder = LLVMCreateBuilderInContext(g->llvm_context);
-	LLVMValueRef first_inst = NULL;
-	if (first_inst = LLVMGetFirstInstruction(entry_block)) {
-		LLVMPositionBuilderBefore(new_builder, first_inst);
+	LLVMValueRef first_inst = LLVMGetFirstInstruction(entry_block);
+	if (first_inst != NULL) {
+		LLVMPositionBuilderBefore(g->alloca_builder, first_inst);
 	} else {
-		LLVMPositionBuilderAtEnd(new_builder, entry_block);
+		LLVMPositionBuilderAtEnd(g->alloca_builder, entry_block);
 	}
-	LLVMValueRef ptr = LLVMBuildAlloca(new_builder, type, name);
-
-	return ptr;
+	return LLVMBuildAlloca(g->alloca_builder, type, name);
 }
 
 LLVMValueRef alloc_value_with_content(CODEGEN* g, char* name, LLVMValueRef value) {
@@ -140,134 +245,190 @@ LLVMValueRef alloc_value_with_content(CODEGEN* g, char* name, LLVMValueRef value
 	return ptr;
 }
 
-LLVMValueRef gen_expr(CODEGEN*, EXPRESSION*);
-LLVMValueRef gen_ast(CODEGEN*, AST*);
+// Names an SSA value after the variable it is bound to, unless it already has a name
+void name_value(LLVMValueRef value, char* name) {
+	size_t len = 0;
+	if (name && (LLVMIsAInstruction(value) || LLVMIsAArgument(value)) && (LLVMGetValueName2(value, &len), len == 0)) LLVMSetValueName2(value, name, strlen(name));
+}
 
-LLVMValueRef gen_int_literal(CODEGEN* g, INT* i) {
-	LLVMValueRef value = LLVMConstInt(LLVMInt64Type(), i->value, true);
-	LLVMValueRef ptr = alloc_value(g, "", LLVMTypeOf(value));
-	LLVMBuildStore(g->llvm_builder, value, ptr);
-	return ptr;
+LLVMValueRef gen_expr(CODEGEN*, NODE);
+LLVMValueRef gen_block(CODEGEN*, NODE_LIST);
+
+// Address of an assignable expression. Other expressions are only addressed when passed by reference,
+// they are copied into a temporary slot.
+LLVMValueRef gen_lvalue(CODEGEN* g, NODE node) {
+	AST* ast = g->ast;
+	while (AST_TYPE(ast, node) == EXPR_TYPE_COMPOUND_EXPR) node = AST_CHILD(ast, node);
+	switch (AST_TYPE(ast, node)) {
+	case EXPR_TYPE_IDENTIFIER: return g->binding_values[AST_BINDING_ID(ast, node)];
+	case EXPR_TYPE_UNARY_OP:
+		if (AST_UNARY_OP(ast, node)->op == OP_MUL) return gen_expr(g, AST_UNARY_OP(ast, node)->expr);
+		break;
+	}
+	return alloc_value_with_content(g, "", gen_expr(g, node));
 }
 
-LLVMValueRef gen_char_literal(CODEGEN* g, CHAR* ch) {
-	LLVMValueRef value = LLVMConstInt(LLVMInt8Type(), ch->value, false);
-	LLVMValueRef ptr = alloc_value(g, "", LLVMTypeOf(value));
-	LLVMBuildStore(g->llvm_builder, value, ptr);
-	return ptr;
+LLVMValueRef convert_value(CODEGEN* g, LLVMValueRef value, uint8_t conversion, TYPE_ID target) {
+	LLVMTypeRef type = gen_type(g, target);
+	switch (conversion) {
+	case CONV_INT_EXTEND: return LLVMBuildSExt(g->llvm_builder, value, type, "");
+	case CONV_INT_TRUNCATE: return LLVMBuildTrunc(g->llvm_builder, value, type, "");
+	case CONV_BOOL_TO_INT: return LLVMBuildZExt(g->llvm_builder, value, type, "");
+	case CONV_INT_TO_BOOL: return LLVMBuildICmp(g->llvm_builder, LLVMIntNE, value, LLVMConstInt(LLVMTypeOf(value), 0, false), "");
+	case CONV_INT_TO_FLOAT: return LLVMBuildSIToFP(g->llvm_builder, value, type, "");
+	case CONV_FLOAT_TO_INT: return LLVMBuildFPToSI(g->llvm_builder, value, type, "");
+	case CONV_FLOAT_EXTEND: return LLVMBuildFPExt(g->llvm_builder, value, type, "");
+	case CONV_FLOAT_TRUNCATE: return LLVMBuildFPTrunc(g->llvm_builder, value, type, "");
+	default: return value;
+	}
 }
 
-LLVMValueRef gen_bool_literal(CODEGEN* g, BOOL* b) {
-	LLVMValueRef value = LLVMConstInt(LLVMInt1Type(), b->value, false);
-	LLVMValueRef ptr = alloc_value(g, "", LLVMTypeOf(value));
-	LLVMBuildStore(g->llvm_builder, value, ptr);
-	return ptr;
+// Value of node in the type its user expects, by reference operands are passed as their address
+LLVMValueRef gen_operand(CODEGEN* g, NODE node) {
+	uint8_t conversion = AST_CONVERSION(g->ast, node);
+	if (conversion == CONV_ADDRESS) return gen_lvalue(g, node);
+	return convert_value(g, gen_expr(g, node), conversion, AST_TARGET_TYPE(g->ast, node));
 }
 
-LLVMValueRef gen_float_literal(CODEGEN* g, FLOAT* f) {
-	LLVMValueRef value = LLVMConstReal(LLVMDoubleType(), f->value);
-	LLVMValueRef ptr = alloc_value(g, "", LLVMTypeOf(value));
-	LLVMBuildStore(g->llvm_builder, value, ptr);
-	return ptr;
+LLVMValueRef gen_int_literal(CODEGEN* g, int64_t i) {
+	return LLVMConstInt(gen_type(g, TYPE_I64), i, true);
 }
 
-LLVMValueRef gen_string_literal(CODEGEN* g, STRING* str) {
-	LLVMValueRef value = LLVMConstString(str->value, (unsigned int)strlen(str->value), false);
-	LLVMValueRef ptr = alloc_value(g, "", LLVMArrayType(LLVMInt8Type(), (unsigned int)strlen(str->value) + 1));
-	LLVMBuildStore(g->llvm_builder, value, ptr);
-	return LLVMBuildBitCast(g->llvm_builder, ptr, LLVMPointerType(LLVMInt8Type(), 0), "");
-}
-
-LLVMValueRef gen_identifier(CODEGEN* g, IDENTIFIER* i) {
-	return find_named_value(g, g->current_scope, i->name);
-}
-
-LLVMValueRef gen_compound_expr(CODEGEN* g, COMPOUND_EXPR* compound_expr) {
-	return gen_expr(g, compound_expr->expr);
-}
-
-LLVMValueRef create_binary_op(CODEGEN* g, const char* op, LLVMValueRef left, LLVMValueRef right) {
-	LLVMTypeRef ltype = LLVMTypeOf(left);
-	LLVMTypeRef rtype = LLVMTypeOf(right);
-	if (LLVMGetTypeKind(ltype) == LLVMIntegerTypeKind && LLVMGetTypeKind(rtype) == LLVMIntegerTypeKind) {
-		LLVMTypeRef type = LLVMIntType(max(LLVMGetIntTypeWidth(ltype), LLVMGetIntTypeWidth(rtype)));
-		left = cast_value(g, left, type);
-		right = cast_value(g, right, type);
-		if (strcmp(op, "+") == 0) return LLVMBuildAdd(g->llvm_builder, left, right, "");
-		if (strcmp(op, "-") == 0) return LLVMBuildSub(g->llvm_builder, left, right, "");
-		if (strcmp(op, "*") == 0) return LLVMBuildMul(g->llvm_builder, left, right, "");
-		if (strcmp(op, "/") == 0) return LLVMBuildSDiv(g->llvm_builder, left, right, "");
-		if (strcmp(op, "%") == 0) return LLVMBuildSRem(g->llvm_builder, left, right, "");
-		if (strcmp(op, "==") == 0) return LLVMBuildICmp(g->llvm_builder, LLVMIntEQ, left, right, "");
-		if (strcmp(op, "!=") == 0) return LLVMBuildICmp(g->llvm_builder, LLVMIntNE, left, right, "");
-		if (strcmp(op, "<") == 0) return LLVMBuildICmp(g->llvm_builder, LLVMIntSLT, left, right, "");
-		if (strcmp(op, ">") == 0) return LLVMBuildICmp(g->llvm_builder, LLVMIntSGT, left, right, "");
-		if (strcmp(op, "<=") == 0) return LLVMBuildICmp(g->llvm_builder, LLVMIntSLE, left, right, "");
-		if (strcmp(op, ">=") == 0) return LLVMBuildICmp(g->llvm_builder, LLVMIntSGE, left, right, "");
-		if (strcmp(op, "&&") == 0) return LLVMBuildAnd(g->llvm_builder, left, right, "");
-		if (strcmp(op, "||") == 0) return LLVMBuildOr(g->llvm_builder, left, right, "");
+LLVMValueRef gen_char_literal(CODEGEN* g, uint8_t ch) {
+	return LLVMConstInt(gen_type(g, TYPE_I8), ch, false);
+}
+
+LLVMValueRef gen_bool_literal(CODEGEN* g, bool b) {
+	return LLVMConstInt(gen_type(g, TYPE_BOOL), b, false);
+}
+
+LLVMValueRef gen_float_literal(CODEGEN* g, double f) {
+	return LLVMConstReal(gen_type(g, TYPE_F64), f);
+}
+
+// String literals are private constants like in C, modifying one is undefined
+LLVMValueRef gen_string_literal(CODEGEN* g, char* str) {
+	return LLVMBuildGlobalStringPtr(g->llvm_builder, str, "str");
+}
+
+LLVMValueRef gen_identifier(CODEGEN* g, NODE node) {
+	BINDING* binding = AST_BINDING(g->ast, AST_BINDING_ID(g->ast, node));
+	LLVMValueRef value = g->binding_values[AST_BINDING_ID(g->ast, node)];
+	if (!binding->needs_storage) return value;
+	return LLVMBuildLoad2(g->llvm_builder, gen_type(g, binding->type), value, "");
+}
+
+LLVMValueRef gen_compound_expr(CODEGEN* g, NODE expr) {
+	return gen_expr(g, expr);
+}
+
+LLVMValueRef create_binary_op(CODEGEN* g, uint8_t op, TYPE_ID type, LLVMValueRef left, LLVMValueRef right) {
+	if (TYPE_KIND_OF(type) == TYPE_KIND_FLOAT) {
+		switch (op) {
+		case OP_ADD: return LLVMBuildFAdd(g->llvm_builder, left, right, "");
+		case OP_SUB: return LLVMBuildFSub(g->llvm_builder, left, right, "");
+		case OP_MUL: return LLVMBuildFMul(g->llvm_builder, left, right, "");
+		case OP_DIV: return LLVMBuildFDiv(g->llvm_builder, left, right, "");
+		case OP_MOD: return LLVMBuildFRem(g->llvm_builder, left, right, "");
+		case OP_EQ: return LLVMBuildFCmp(g->llvm_builder, LLVMRealOEQ, left, right, "");
+		case OP_NE: return LLVMBuildFCmp(g->llvm_builder, LLVMRealUNE, left, right, "");
+		case OP_LT: return LLVMBuildFCmp(g->llvm_builder, LLVMRealOLT, left, right, "");
+		case OP_GT: return LLVMBuildFCmp(g->llvm_builder, LLVMRealOGT, left, right, "");
+		case OP_LE: return LLVMBuildFCmp(g->llvm_builder, LLVMRealOLE, left, right, "");
+		case OP_GE: return LLVMBuildFCmp(g->llvm_builder, LLVMRealOGE, left, right, "");
+		}
+		return NULL;
+	}
+	// Bools compare as unsigned integers
+	bool is_signed = TYPE_KIND_OF(type) == TYPE_KIND_INT;
+	switch (op) {
+	case OP_ADD: return LLVMBuildAdd(g->llvm_builder, left, right, "");
+	case OP_SUB: return LLVMBuildSub(g->llvm_builder, left, right, "");
+	case OP_MUL: return LLVMBuildMul(g->llvm_builder, left, right, "");
+	case OP_DIV: return LLVMBuildSDiv(g->llvm_builder, left, right, "");
+	case OP_MOD: return LLVMBuildSRem(g->llvm_builder, left, right, "");
+	case OP_EQ: return LLVMBuildICmp(g->llvm_builder, LLVMIntEQ, left, right, "");
+	case OP_NE: return LLVMBuildICmp(g->llvm_builder, LLVMIntNE, left, right, "");
+	case OP_LT: return LLVMBuildICmp(g->llvm_builder, is_signed ? LLVMIntSLT : LLVMIntULT, left, right, "");
+	case OP_GT: return LLVMBuildICmp(g->llvm_builder, is_signed ? LLVMIntSGT : LLVMIntUGT, left, right, "");
+	case OP_LE: return LLVMBuildICmp(g->llvm_builder, is_signed ? LLVMIntSLE : LLVMIntULE, left, right, "");
+	case OP_GE: return LLVMBuildICmp(g->llvm_builder, is_signed ? LLVMIntSGE : LLVMIntUGE, left, right, "");
+	case OP_AND: return LLVMBuildAnd(g->llvm_builder, left, right, "");
+	case OP_OR: return LLVMBuildOr(g->llvm_builder, left, right, "");
 	}
 	return NULL;
 }
 
-LLVMValueRef gen_assign(CODEGEN* g, ASSIGN* assign) {
-	LLVMValueRef left = gen_expr(g, assign->left);
-	LLVMValueRef right = gen_expr(g, assign->right);
-	if (strcmp(assign->op, "=") == 0 && !left) {
-		if (assign->left->type != EXPR_TYPE_IDENTIFIER) {
-			// TODO ERROR
-		}
-		strvec_push(&g->current_scope->locals_k, assign->left->identifier.name);
-		valvec_push(&g->current_scope->locals_v, right);
-	} else if (assign->op[strlen(assign->op) - 1] == '=') {
-		LLVMValueRef value = NULL;
-		switch (assign->op[0]) {
-		case '=': value = LLVMBuildLoad(g->llvm_builder, right, ""); break;
-		case '+': value = create_binary_op(g, "+", LLVMBuildLoad(g->llvm_builder, left, ""), LLVMBuildLoad(g->llvm_builder, right, "")); break;
-		case '-': value = create_binary_op(g, "-", LLVMBuildLoad(g->llvm_builder, left, ""), LLVMBuildLoad(g->llvm_builder, right, "")); break;
-		case '*': value = create_binary_op(g, "*", LLVMBuildLoad(g->llvm_builder, left, ""), LLVMBuildLoad(g->llvm_builder, right, "")); break;
-		case '/': value = create_binary_op(g, "/", LLVMBuildLoad(g->llvm_builder, left, ""), LLVMBuildLoad(g->llvm_builder, right, "")); break;
-		case '%': value = create_binary_op(g, "%", LLVMBuildLoad(g->llvm_builder, left, ""), LLVMBuildLoad(g->llvm_builder, right, "")); break;
+LLVMValueRef gen_assign(CODEGEN* g, NODE node, ASSIGN* assign) {
+	AST* ast = g->ast;
+	// The resolver binds assignments that define a variable
+	uint32_t binding_id = AST_BINDING_ID(ast, node);
+	if (binding_id) {
+		BINDING* binding = AST_BINDING(ast, binding_id);
+		LLVMValueRef value = gen_expr(g, assign->right);
+		if (binding->needs_storage) {
+			g->binding_values[binding_id] = alloc_value_with_content(g, binding->name, value);
+		} else {
+			name_value(value, binding->name);
+			g->binding_values[binding_id] = value;
 		}
-		LLVMBuildStore(g->llvm_builder, cast_value(g, value, LLVMGetElementType(LLVMTypeOf(left))), left);
+		return value;
+	}
+
+	LLVMValueRef left = gen_lvalue(g, assign->left);
+	LLVMValueRef value = gen_operand(g, assign->right);
+	if (assign->op != OP_ASSIGN) {
+		TYPE_ID type = AST_VALUE_TYPE(ast, assign->left);
+		value = create_binary_op(g, OPERATORS[assign->op].assign_op, type, LLVMBuildLoad2(g->llvm_builder, gen_type(g, type), left, ""), value);
 	}
+	LLVMBuildStore(g->llvm_builder, value, left);
 
-	return right;
+	return value;
 }
 
 LLVMValueRef gen_binary_op(CODEGEN* g, BINARY_OP* binary_op) {
-	LLVMValueRef value = create_binary_op(g, binary_op->op, LLVMBuildLoad(g->llvm_builder, gen_expr(g, binary_op->left), ""), LLVMBuildLoad(g->llvm_builder, gen_expr(g, binary_op->right), ""));
-	LLVMValueRef ptr = alloc_value(g, "", LLVMTypeOf(value));
-	LLVMBuildStore(g->llvm_builder, value, ptr);
-
-	return ptr;
+	LLVMValueRef left = gen_operand(g, binary_op->left);
+	LLVMValueRef right = gen_operand(g, binary_op->right);
+	return create_binary_op(g, binary_op->op, AST_TARGET_TYPE(g->ast, binary_op->left), left, right);
 }
 
-LLVMValueRef gen_unary_op(CODEGEN* g, UNARY_OP* unary_op) {
-	LLVMValueRef expr = gen_expr(g, unary_op->expr);
+LLVMValueRef gen_unary_op(CODEGEN* g, NODE node, UNARY_OP* unary_op) {
+	TYPE_ID type = AST_VALUE_TYPE(g->ast, node);
 
-	if (strcmp(unary_op->op, "*") == 0) return LLVMBuildLoad(g->llvm_builder, expr, "abc");
-	if (strcmp(unary_op->op, "++") == 0 || strcmp(unary_op->op, "--") == 0) {
-		LLVMValueRef initial_value = LLVMBuildLoad(g->llvm_builder, expr, "");
-		char* op = strcmp(unary_op->op, "++") == 0 ? "+" : "-";
-		LLVMValueRef result = create_binary_op(g, op, initial_value, LLVMConstInt(LLVMInt64Type(), 1, true));
+	switch (unary_op->op) {
+	case OP_MUL: return LLVMBuildLoad2(g->llvm_builder, gen_type(g, type), gen_expr(g, unary_op->expr), "");
+	case OP_ADD: return gen_expr(g, unary_op->expr);
+	case OP_SUB: {
+		LLVMValueRef value = gen_expr(g, unary_op->expr);
+		return TYPE_KIND_OF(type) == TYPE_KIND_FLOAT ? LLVMBuildFNeg(g->llvm_builder, value, "") : LLVMBuildNeg(g->llvm_builder, value, "");
+	}
+	case OP_INC:
+	case OP_DEC: {
+		LLVMValueRef expr = gen_lvalue(g, unary_op->expr);
+		LLVMValueRef initial_value = LLVMBuildLoad2(g->llvm_builder, gen_type(g, type), expr, "");
+		LLVMValueRef result = create_binary_op(g, unary_op->op == OP_INC ? OP_ADD : OP_SUB, type, initial_value, LLVMConstInt(gen_type(g, type), 1, true));
 		LLVMBuildStore(g->llvm_builder, result, expr);
-		return unary_op->position ? alloc_value_with_content(g, "", initial_value) : expr;
+		return unary_op->position ? initial_value : result;
+	}
 	}
 
 	return NULL;
 }
 
-LLVMValueRef gen_compound(CODEGEN* g, COMPOUND* compound) {
-	return gen_ast(g, compound->ast);
+LLVMValueRef gen_compound(CODEGEN* g, NODE_LIST block) {
+	return gen_block(g, block);
 }
 
-LLVMValueRef gen_return(CODEGEN* g, RETURN* ret_statement) {
+LLVMValueRef gen_return(CODEGEN* g, NODE value) {
+	LLVMValueRef ret_value = value ? gen_operand(g, value) : LLVMConstInt(gen_type(g, TYPE_I32), 0, true);
+	LLVMBuildRet(g->llvm_builder, ret_value);
+	g->has_branched = true;
 	return NULL;
 }
 
-LLVMValueRef gen_if_statement(CODEGEN* g, IF* if_statement) {
-	LLVMValueRef condition = cast_value(g, LLVMBuildLoad(g->llvm_builder, gen_expr(g, if_statement->condition), ""), LLVMInt1Type());
+LLVMValueRef gen_if_statement(CODEGEN* g, NODE node, IF* if_statement) {
+	TYPE_ID type = AST_VALUE_TYPE(g->ast, node);
+	LLVMValueRef condition = gen_operand(g, if_statement->condition);
 	LLVMBasicBlockRef before_block = LLVMGetInsertBlock(g->llvm_builder);
 
 	LLVMBasicBlockRef then_block = LLVMAppendBasicBlockInContext(g->llvm_context, g->llvm_func, "then");
@@ -277,37 +438,35 @@ LLVMValueRef gen_if_statement(CODEGEN* g, IF* if_statement) {
 	LLVMPositionBuilderAtEnd(g->llvm_builder, before_block);
 	LLVMBuildCondBr(g->llvm_builder, condition, then_block, else_block);
 
+	LLVMValueRef incoming_values[2];
+	LLVMBasicBlockRef incoming_blocks[2];
+	int num_incoming = 0;
+
 	LLVMPositionBuilderAtEnd(g->llvm_builder, then_block);
 	LLVMValueRef then_result = gen_expr(g, if_statement->then_block);
-	if (!g->has_branched) LLVMBuildBr(g->llvm_builder, merge_block);
-	else g->has_branched = false;
-	then_block = LLVMGetInsertBlock(g->llvm_builder);
+	if (!g->has_branched) {
+		LLVMBuildBr(g->llvm_builder, merge_block);
+		incoming_values[num_incoming] = then_result;
+		incoming_blocks[num_incoming++] = LLVMGetInsertBlock(g->llvm_builder);
+	} else g->has_branched = false;
 
 	LLVMPositionBuilderAtEnd(g->llvm_builder, else_block);
-	LLVMValueRef else_result = NULL;
 	if (if_statement->else_block) {
-		else_result = gen_expr(g, if_statement->else_block);
-		if (!g->has_branched) LLVMBuildBr(g->llvm_builder, merge_block);
-		else g->has_branched = false;
-		else_block = LLVMGetInsertBlock(g->llvm_builder);
+		LLVMValueRef else_result = gen_expr(g, if_statement->else_block);
+		if (!g->has_branched) {
+			LLVMBuildBr(g->llvm_builder, merge_block);
+			incoming_values[num_incoming] = else_result;
+			incoming_blocks[num_incoming++] = LLVMGetInsertBlock(g->llvm_builder);
+		} else g->has_branched = false;
 	} else LLVMBuildBr(g->llvm_builder, merge_block);
 
 	LLVMPositionBuilderAtEnd(g->llvm_builder, merge_block);
 
-	if (then_result && else_result) {
-		if (LLVMTypeOf(then_result) != LLVMTypeOf(else_result)) {
-			// TODO ERROR
-			else_result = cast_value(g, else_result, LLVMTypeOf(then_result));
-		}
-		LLVMValueRef phi = LLVMBuildPhi(g->llvm_builder, LLVMTypeOf(then_result), "");
-		LLVMValueRef incoming_values[] = { then_result, else_result };
-		LLVMBasicBlockRef incoming_blocks[] = { then_block, else_block };
-		LLVMAddIncoming(phi, incoming_values, incoming_blocks, 2);
-		return phi;
-	}
-	if (then_result) return then_result;
-	else if (else_result) return else_result;
-	else return NULL;
+	if (!type) return NULL;
+	if (!num_incoming) return LLVMGetUndef(gen_type(g, type));
+	LLVMValueRef phi = LLVMBuildPhi(g->llvm_builder, gen_type(g, type), "");
+	LLVMAddIncoming(phi, incoming_values, incoming_blocks, num_incoming);
+	return phi;
 }
 
 LLVMValueRef gen_loop(CODEGEN* g, LOOP* loop) {
@@ -325,7 +484,7 @@ LLVMValueRef gen_loop(CODEGEN* g, LOOP* loop) {
 
 	LLVMPositionBuilderAtEnd(g->llvm_builder, head_block);
 	if (loop->condition) {
-		LLVMValueRef condition = cast_value(g, LLVMBuildLoad(g->llvm_builder, gen_expr(g, loop->condition), ""), LLVMInt1Type());
+		LLVMValueRef condition = gen_operand(g, loop->condition);
 		LLVMBuildCondBr(g->llvm_builder, condition, loop_block, merge_block);
 	} else LLVMBuildBr(g->llvm_builder, loop_block);
 
@@ -342,13 +501,13 @@ LLVMValueRef gen_loop(CODEGEN* g, LOOP* loop) {
 	return NULL;
 }
 
-LLVMValueRef gen_break(CODEGEN* g, BREAK* break_statement) {
+LLVMValueRef gen_break(CODEGEN* g, uint8_t idx) {
 	SCOPE* scope = g->current_scope;
 	int i = 0;
 	while (true) {
 		if (!scope->break_dest) scope = scope->parent;
 		else {
-			if (i >= break_statement->idx) break;
+			if (i >= idx) break;
 			else {
 				i++;
 			}
@@ -362,13 +521,13 @@ LLVMValueRef gen_break(CODEGEN* g, BREAK* break_statement) {
 	return NULL;
 }
 
-LLVMValueRef gen_continue(CODEGEN* g, CONTINUE* continue_statement) {
+LLVMValueRef gen_continue(CODEGEN* g, uint8_t idx) {
 	SCOPE* scope = g->current_scope;
 	int i = 0;
 	while (true) {
 		if (!scope->continue_dest) scope = scope->parent;
 		else {
-			if (i >= continue_statement->idx) break;
+			if (i >= idx) break;
 			else {
 				i++;
 			}
@@ -383,248 +542,625 @@ LLVMValueRef gen_continue(CODEGEN* g, CONTINUE* continue_statement) {
 }
 
 LLVMValueRef gen_func_call(CODEGEN* g, FUNC_CALL* func_call) {
-	// Cast
-	if (func_call->callee->type == EXPR_TYPE_IDENTIFIER && func_call->num_args == 1) {
-		LLVMTypeRef llvm_type = NULL;
-		if (llvm_type = get_llvm_type_from_str(func_call->callee->identifier.name, true)) {
-			LLVMValueRef value = cast_value(g, LLVMBuildLoad(g->llvm_builder, gen_expr(g, &func_call->args[0]), ""), llvm_type);
-			LLVMValueRef ptr = alloc_value(g, "", LLVMTypeOf(value));
-			LLVMBuildStore(g->llvm_builder, value, ptr);
-			return ptr;
-		}
-	}
+	// The resolver leaves the callee of a conversion untyped
+	TYPE_ID type = AST_VALUE_TYPE(g->ast, func_call->callee);
+	if (TYPE_KIND_OF(type) != TYPE_KIND_FUNCTION) return gen_operand(g, AST_LIST_NODE(g->ast, func_call->args, 0));
 
 	LLVMValueRef callee = gen_expr(g, func_call->callee);
 
-	LLVMValueRef* args = malloc(func_call->num_args * sizeof(LLVMValueRef));
-	LLVMTypeRef* arg_types = malloc(LLVMCountParams(callee) * sizeof(LLVMTypeRef));
-	for (int i = 0; i < func_call->num_args; i++) {
-		LLVMValueRef arg = gen_expr(g, &func_call->args[i]);
-		LLVMTypeRef arg_type = LLVMTypeOf(arg);
-		LLVMTypeRef param_type = LLVMTypeOf(LLVMGetParam(callee, i));
-		if (LLVMGetTypeKind(arg_type) == LLVMGetTypeKind(param_type)) {
-			if (LLVMGetTypeKind(arg_type) == LLVMPointerTypeKind) args[i] = arg;
-			else args[i] = cast_value(g, arg, param_type);
-		} else {
-			if (LLVMGetTypeKind(arg_type) == LLVMPointerTypeKind) {
-				LLVMValueRef value = LLVMBuildLoad(g->llvm_builder, arg, "");
-				args[i] = cast_value(g, value, param_type);
-			} else if (LLVMGetTypeKind(param_type) == LLVMPointerTypeKind) {
-				LLVMValueRef ptr = LLVMBuildAlloca(g->llvm_builder, LLVMGetElementType(param_type), "");
-				LLVMBuildStore(g->llvm_builder, cast_value(g, arg, LLVMGetElementType(param_type)), ptr);
-				args[i] = ptr;
-			}
-		}
+	LLVMValueRef* args = mem_alloc(func_call->args.size * sizeof(LLVMValueRef));
+	for (uint32_t i = 0; i < func_call->args.size; i++) {
+		args[i] = gen_operand(g, AST_LIST_NODE(g->ast, func_call->args, i));
 	}
-	LLVMValueRef ret_val = LLVMBuildCall2(g->llvm_builder, LLVMGetElementType(LLVMTypeOf(callee)), callee, args, func_call->num_args, "");
-	free(args);
+	LLVMValueRef ret_val = LLVMBuildCall2(g->llvm_builder, gen_type(g, type), callee, args, func_call->args.size, "");
+	mem_free(args);
 	return ret_val;
 }
 
-LLVMValueRef gen_func_decl(CODEGEN* g, FUNC_DECL* func_decl) {
-	LLVMTypeRef* arg_types = malloc(func_decl->num_args * sizeof(LLVMTypeRef));
-	for (int i = 0; i < func_decl->num_args; i++) {
-		arg_types[i] = get_llvm_type(&func_decl->args[i].type);
-	}
-	LLVMTypeRef func_type = LLVMFunctionType(LLVMInt32Type(), arg_types, func_decl->num_args, false);
-	LLVMValueRef func = LLVMAddFunction(g->llvm_module, func_decl->funcname, func_type);
-	strvec_push(&g->globals_k, func_decl->funcname);
-	valvec_push(&g->globals_v, func);
+// All declarations of a function in a module share its binding and so its LLVM function
+LLVMValueRef gen_func_decl(CODEGEN* g, NODE node, FUNC_DECL* func_decl) {
+	uint32_t binding = AST_BINDING_ID(g->ast, node);
+	if (g->binding_values[binding]) return g->binding_values[binding];
+	LLVMValueRef func = LLVMAddFunction(g->llvm_module, func_decl->funcname, gen_type(g, AST_BINDING(g->ast, binding)->type));
+	g->binding_values[binding] = func;
 	return func;
 }
 
-LLVMValueRef gen_func_def(CODEGEN* g, FUNC_DEF* func_def) {
-	LLVMValueRef func = gen_func_decl(g, &func_def->decl);
+LLVMValueRef gen_func_def(CODEGEN* g, NODE node, FUNC_DEF* func_def) {
+	LLVMValueRef func = gen_func_decl(g, node, &func_def->decl);
 	LLVMSetLinkage(func, LLVMPrivateLinkage);
 	LLVMValueRef parent_func = g->llvm_func;
 	g->llvm_func = func;
 
-	SCOPE* parent_scope = g->current_scope;
-	g->current_scope = scope_new(parent_scope);
+	SCOPE scope;
+	scope_push(g, &scope);
 
 	LLVMBasicBlockRef parent_block = LLVMGetInsertBlock(g->llvm_builder);
-	LLVMBasicBlockRef entry_block = LLVMAppendBasicBlock(func, "entry");
+	LLVMBasicBlockRef entry_block = LLVMAppendBasicBlockInContext(g->llvm_context, func, "entry");
 	LLVMPositionBuilderAtEnd(g->llvm_builder, entry_block);
 
-	int num_args = LLVMCountParams(func);
-	for (int i = 0; i < num_args; i++) {
-		//LLVMValueRef arg = alloc_value_with_content(g, func_def->decl.args[i].name, LLVMGetParam(func, i), g->current_scope);
+	// By reference parameters already point to their storage, copies only get a slot if they are assigned to
+	BINDING* function = AST_BINDING(g->ast, AST_BINDING_ID(g->ast, node));
+	TYPE_INFO* func_type = TYPE_INFO_OF(function->type);
+	for (int i = 0; i < func_type->num_params; i++) {
 		LLVMValueRef arg = LLVMGetParam(func, i);
-		strvec_push(&g->current_scope->locals_k, func_def->decl.args[i].name);
-		valvec_push(&g->current_scope->locals_v, arg);
+		char* name = func_def->decl.args[i].name;
+		name_value(arg, name);
+		if (TYPE_KIND_OF(func_type->params[i]) != TYPE_KIND_POINTER && AST_BINDING(g->ast, function->first_param + i)->needs_storage) {
+			arg = alloc_value_with_content(g, name ? name : "", arg);
+		}
+		g->binding_values[function->first_param + i] = arg;
 	}
 
 	gen_expr(g, func_def->body);
 
-	scope_delete(g->current_scope);
-	g->current_scope = parent_scope;
+	scope_pop(g);
 
-	LLVMBuildRet(g->llvm_builder, LLVMConstInt(LLVMInt32Type(), 0, true));
+	if (!g->has_branched) LLVMBuildRet(g->llvm_builder, LLVMConstInt(gen_type(g, TYPE_I32), 0, true));
+	g->has_branched = false;
 	g->llvm_func = parent_func;
 	LLVMPositionBuilderAtEnd(g->llvm_builder, parent_block);
 
 	return func;
 }
 
-LLVMValueRef gen_import(CODEGEN* g, IMPORT* import) {
+LLVMValueRef gen_import(CODEGEN* g, char* module_name) {
 	DYNAMIC_STRING init_func_name = string_new(8);
 	string_push_s(&init_func_name, "__");
-	string_push_s(&init_func_name, import->module_name);
+	string_push_s(&init_func_name, module_name);
 	string_push_s(&init_func_name, "_init");
-	LLVMValueRef init_func = LLVMAddFunction(g->llvm_module, init_func_name.buffer, LLVMFunctionType(LLVMInt32Type(), NULL, 0, false));
-	return LLVMBuildCall(g->llvm_builder, init_func, NULL, 0, "");
+	LLVMTypeRef init_func_type = LLVMFunctionType(gen_type(g, TYPE_I32), NULL, 0, false);
+	LLVMValueRef init_func = LLVMAddFunction(g->llvm_module, init_func_name.buffer, init_func_type);
 	string_delete(&init_func_name);
+	return LLVMBuildCall2(g->llvm_builder, init_func_type, init_func, NULL, 0, "");
 }
 
-LLVMValueRef gen_expr(CODEGEN* g, EXPRESSION* expr) {
-	switch (expr->type) {
-	case EXPR_TYPE_INT_LITERAL: return gen_int_literal(g, &expr->int_literal);
-	case EXPR_TYPE_CHAR_LITERAL: return gen_char_literal(g, &expr->char_literal);
-	case EXPR_TYPE_BOOL_LITERAL: return gen_bool_literal(g, &expr->bool_literal);
-	case EXPR_TYPE_FLOAT_LITERAL: return gen_float_literal(g, &expr->float_literal);
-	case EXPR_TYPE_STRING_LITERAL: return gen_string_literal(g, &expr->string_literal);
-	case EXPR_TYPE_IDENTIFIER: return gen_identifier(g, &expr->identifier);
-	case EXPR_TYPE_COMPOUND_EXPR: return gen_compound_expr(g, &expr->compound_expr);
-
-	case EXPR_TYPE_ASSIGN: return gen_assign(g, &expr->assign);
-	case EXPR_TYPE_BINARY_OP: return gen_binary_op(g, &expr->binary_op);
-	case EXPR_TYPE_UNARY_OP: return gen_unary_op(g, &expr->unary_op);
-	case EXPR_TYPE_COMPOUND: return gen_compound(g, &expr->compound);
-	case EXPR_TYPE_RETURN: return gen_return(g, &expr->ret_statement);
-	case EXPR_TYPE_IF_STATEMENT: return gen_if_statement(g, &expr->if_statement);
-	case EXPR_TYPE_LOOP: return gen_loop(g, &expr->loop);
-	case EXPR_TYPE_BREAK: return gen_break(g, &expr->break_statement);
-	case EXPR_TYPE_CONTINUE: return gen_continue(g, &expr->continue_statement);
-	case EXPR_TYPE_FUNC_CALL: return gen_func_call(g, &expr->func_call);
-
-	case EXPR_TYPE_FUNC_DECL: return gen_func_decl(g, &expr->func_decl);
-	case EXPR_TYPE_FUNC_DEF: return gen_func_def(g, &expr->func_def);
-
-	case EXPR_TYPE_IMPORT: return gen_import(g, &expr->import);
+typedef struct GEN_EXPR_CALL_t {
+	CODEGEN* g;
+	NODE expr;
+	LLVMValueRef result;
+} GEN_EXPR_CALL;
+
+void gen_expr_continuation(void* arg) {
+	GEN_EXPR_CALL* call = arg;
+	call->result = gen_expr(call->g, call->expr);
+}
+
+LLVMValueRef gen_expr(CODEGEN* g, NODE expr) {
+	if (stack_low()) {
+		GEN_EXPR_CALL call = { g, expr, NULL };
+		stack_grow_call(gen_expr_continuation, &call);
+		return call.result;
+	}
+	AST* ast = g->ast;
+	switch (AST_TYPE(ast, expr)) {
+	case EXPR_TYPE_INT_LITERAL: return gen_int_literal(g, AST_INT(ast, expr));
+	case EXPR_TYPE_CHAR_LITERAL: return gen_char_literal(g, (uint8_t)AST_PAYLOAD(ast, expr));
+	case EXPR_TYPE_BOOL_LITERAL: return gen_bool_literal(g, AST_PAYLOAD(ast, expr));
+	case EXPR_TYPE_FLOAT_LITERAL: return gen_float_literal(g, AST_FLOAT(ast, expr));
+	case EXPR_TYPE_STRING_LITERAL: return gen_string_literal(g, AST_STRING(ast, expr));
+	case EXPR_TYPE_IDENTIFIER: return gen_identifier(g, expr);
+	case EXPR_TYPE_COMPOUND_EXPR: return gen_compound_expr(g, AST_CHILD(ast, expr));
+
+	case EXPR_TYPE_ASSIGN: return gen_assign(g, expr, AST_ASSIGN(ast, expr));
+	case EXPR_TYPE_BINARY_OP: return gen_binary_op(g, AST_BINARY_OP(ast, expr));
+	case EXPR_TYPE_UNARY_OP: return gen_unary_op(g, expr, AST_UNARY_OP(ast, expr));
+	case EXPR_TYPE_COMPOUND: return gen_compound(g, AST_BLOCK(ast, expr));
+	case EXPR_TYPE_RETURN: return gen_return(g, AST_CHILD(ast, expr));
+	case EXPR_TYPE_IF_STATEMENT: return gen_if_statement(g, expr, AST_IF(ast, expr));
+	case EXPR_TYPE_LOOP: return gen_loop(g, AST_LOOP(ast, expr));
+	case EXPR_TYPE_BREAK: return gen_break(g, (uint8_t)AST_PAYLOAD(ast, expr));
+	case EXPR_TYPE_CONTINUE: return gen_continue(g, (uint8_t)AST_PAYLOAD(ast, expr));
+	case EXPR_TYPE_FUNC_CALL: return gen_func_call(g, AST_FUNC_CALL(ast, expr));
+
+	case EXPR_TYPE_FUNC_DECL: return gen_func_decl(g, expr, AST_FUNC_DECL(ast, expr));
+	case EXPR_TYPE_FUNC_DEF: return gen_func_def(g, expr, AST_FUNC_DEF(ast, expr));
+
+	case EXPR_TYPE_IMPORT: return gen_import(g, AST_NAME(ast, expr));
 
 	default: return NULL;
 	}
 }
 
-LLVMValueRef gen_ast(CODEGEN* g, AST* ast) {
-	SCOPE* parent = g->current_scope;
-	g->current_scope = scope_new(parent);
+LLVMValueRef gen_block(CODEGEN* g, NODE_LIST block) {
+	SCOPE scope;
+	scope_push(g, &scope);
 
 	LLVMValueRef ret_value = NULL;
-	for (int i = 0; i < ast->num_expressions; i++) {
-		ret_value = gen_expr(g, &ast->expressions[i]);
+	for (uint32_t i = 0; i < block.size; i++) {
+		ret_value = gen_expr(g, AST_LIST_NODE(g->ast, block, i));
 		if (g->has_branched) break;
 	}
 
-	scope_delete(g->current_scope);
-	g->current_scope = parent;
+	scope_pop(g);
 
 	return ret_value;
 }
 
 void gen_toplevel(CODEGEN* g, AST* ast, char* module_name) {
-	char* init_func_name = malloc(strlen(module_name) + 8);
+	char* init_func_name = mem_alloc(strlen(module_name) + 8);
 	memcpy(init_func_name + 2, module_name, strlen(module_name));
 	memcpy(init_func_name, "__", 2);
 	memcpy(init_func_name + 2 + strlen(module_name), "_init", 5);
 	init_func_name[strlen(module_name) + 2 + 5] = 0;
 
-	LLVMTypeRef func_type = LLVMFunctionType(LLVMInt32Type(), NULL, 0, false);
+	LLVMTypeRef func_type = LLVMFunctionType(gen_type(g, TYPE_I32), NULL, 0, false);
 	LLVMValueRef function = LLVMAddFunction(g->llvm_module, init_func_name, func_type);
 	LLVMSetLinkage(function, LLVMExternalLinkage);
 	g->llvm_func = function;
 
-	LLVMBasicBlockRef entry_block = LLVMAppendBasicBlock(function, "entry");
+	LLVMBasicBlockRef entry_block = LLVMAppendBasicBlockInContext(g->llvm_context, function, "entry");
 	LLVMPositionBuilderAtEnd(g->llvm_builder, entry_block);
 
-	gen_ast(g, ast);
+	gen_block(g, ast->root);
 
-	LLVMBuildRet(g->llvm_builder, LLVMConstInt(LLVMInt32Type(), 0, true));
+	if (!g->has_branched) LLVMBuildRet(g->llvm_builder, LLVMConstInt(gen_type(g, TYPE_I32), 0, true));
+	g->has_branched = false;
 	g->llvm_func = NULL;
 
-	free(init_func_name);
+	mem_free(init_func_name);
 }
 
 void gen_create_module(CODEGEN* g, AST* ast, char* module_name) {
 	g->llvm_module = LLVMModuleCreateWithNameInContext(module_name, g->llvm_context);
+	gen_set_target(g, g->llvm_module);
 	g->ast = ast;
+	g->binding_values = mem_calloc(ast->bindings.size, sizeof(LLVMValueRef));
 
+	double start = stats_begin();
 	gen_toplevel(g, ast, module_name);
+	stats_end(PHASE_CODEGEN, module_name, start, stats.enabled ? count_instructions(g->llvm_module) : 0);
 
-	puts(LLVMPrintModuleToString(g->llvm_module));
-	printf("-----\n\n");
-	LLVMPassManagerRef pass_manager = LLVMCreatePassManager();
-	LLVMRunPassManager(pass_manager, g->llvm_module);
+	mem_free(g->binding_values);
+	g->binding_values = NULL;
 
-	mdvec_push(&g->module_vec, g->llvm_module);
+	gen_optimize(g, g->llvm_module);
 }
 
-void output_module(LLVMModuleRef module, char* output_file) {
-	LLVMSetTarget(module, LLVM_DEFAULT_TARGET_TRIPLE);
+typedef struct GEN_MODULES_TASK_t {
+	CODEGEN* g;
+	GENERATED_MODULE* modules;
+} GEN_MODULES_TASK;
+
+void gen_module_task(void* arg, long index) {
+	GEN_MODULES_TASK* task = arg;
+	GENERATED_MODULE* out = &task->modules[index];
+	uint8_t subsystem = mem_enter(MEM_CODEGEN);
+	CODEGEN w = gen_new_worker(task->g);
+	gen_create_module(&w, &task->g->module_ast_vec.buffer[index], task->g->module_name_vec.buffer[index]);
+	gen_delete_worker(&w);
+
+	if (task->g->llvm_out) out->ir = LLVMPrintModuleToString(w.llvm_module);
+	if (task->g->lto == LTO_THIN) {
+		out->context = w.llvm_context;
+		out->module = w.llvm_module;
+	} else {
+		out->bitcode = LLVMWriteBitcodeToMemoryBuffer(w.llvm_module);
+		LLVMDisposeModule(w.llvm_module);
+		LLVMContextDispose(w.llvm_context);
+	}
+	mem_leave(subsystem);
+}
 
-	LLVMTargetRef target;
+void gen_create_modules(CODEGEN* g) {
+	uint8_t subsystem = mem_enter(MEM_CODEGEN);
+	GENERATED_MODULE* modules = mem_calloc(g->module_ast_vec.size, sizeof(GENERATED_MODULE));
+	GEN_MODULES_TASK task = { g, modules };
+	pool_run(g->pool, gen_module_task, &task, g->module_ast_vec.size);
+
+	for (long i = 0; i < g->module_ast_vec.size; i++) {
+		GENERATED_MODULE* m = &modules[i];
+		char* module_name = g->module_name_vec.buffer[i];
+		if (m->ir) {
+			fputs(m->ir, g->llvm_out);
+			fputs("\n-----\n\n", g->llvm_out);
+			LLVMDisposeMessage(m->ir);
+		}
+
+		double start = stats_begin();
+		if (g->lto == LTO_THIN) {
+			thinlto_add_module(&g->thin_lto, m->module, module_name);
+			LLVMDisposeModule(m->module);
+			LLVMContextDispose(m->context);
+		} else {
+			LLVMModuleRef module = NULL;
+			if (LLVMParseBitcodeInContext2(g->llvm_context, m->bitcode, &module)) printf("Can't load the bitcode of module '%s'\n", module_name);
+			else {
+				// Modules loaded from memory are named after the buffer
+				LLVMSetModuleIdentifier(module, module_name, strlen(module_name));
+				mdvec_push(&g->module_vec, module);
+			}
+			LLVMDisposeMemoryBuffer(m->bitcode);
+		}
+		stats_end(PHASE_MERGE, module_name, start, 0);
+	}
+	mem_free(modules);
+	mem_leave(subsystem);
+}
+
+// Compiles a module to an object or assembly in memory, NULL on errors
+LLVMMemoryBufferRef gen_emit_file(CODEGEN* g, LLVMModuleRef module, LLVMCodeGenFileType type) {
+	LLVMTargetMachineRef target_machine = gen_target_machine(g);
+	if (!target_machine) return NULL;
+
+	LLVMMemoryBufferRef file = NULL;
 	char* error = NULL;
-	const char* target_triple = LLVMGetTarget(module);
-	LLVMGetTargetFromTriple(target_triple, &target, &error);
-	if (!target) {
-		printf(error);
-		return;
+	if (LLVMTargetMachineEmitToMemoryBuffer(target_machine, module, type, &error, &file)) {
+		printf("%s\n", error);
+		LLVMDisposeMessage(error);
+		return NULL;
 	}
-	char* cpu = "generic";
-	char* features = "";
-	LLVMCodeGenOptLevel level = LLVMCodeGenLevelDefault;
-	LLVMRelocMode reloc = LLVMRelocDefault;
-	LLVMCodeModel code_model = LLVMCodeModelDefault;
-	LLVMTargetMachineRef target_machine = LLVMCreateTargetMachine(target, target_triple, cpu, features, level, reloc, code_model);
+	return file;
+}
 
-	LLVMCodeGenFileType filetype = LLVMObjectFile;
-	error = NULL;
-	LLVMTargetMachineEmitToFile(target_machine, module, output_file, filetype, &error);
-	if (error) {
-		printf(error);
+// Compiles a module to the object and the assembly, as far as they are needed for the emitted outputs.
+// name is the module or object the time is reported for.
+void gen_emit_code(CODEGEN* g, LLVMModuleRef module, char* name, LLVMMemoryBufferRef* object, LLVMMemoryBufferRef* assembly) {
+	double start = stats_begin();
+	bool emit_object = g->emit & (EMIT_FLAG(EMIT_OBJ) | EMIT_FLAG(EMIT_EXE));
+	if (g->emit & EMIT_FLAG(EMIT_ASM)) {
+		// The backend changes the IR it compiles, so the object is compiled from the original
+		LLVMModuleRef copy = emit_object ? LLVMCloneModule(module) : module;
+		*assembly = gen_emit_file(g, copy, LLVMAssemblyFile);
+		if (copy != module) LLVMDisposeModule(copy);
+	}
+	if (emit_object) *object = gen_emit_file(g, module, LLVMObjectFile);
+	stats_end(PHASE_EMIT, name, start, *object ? LLVMGetBufferSize(*object) : 0);
+}
+
+// Called in object order: prints the assembly and keeps the object under name, which it takes ownership of
+void gen_add_code(CODEGEN* g, OBJECT_VEC* objects, char* name, LLVMMemoryBufferRef object, LLVMMemoryBufferRef assembly) {
+	if (assembly) {
+		fwrite(LLVMGetBufferStart(assembly), 1, LLVMGetBufferSize(assembly), g->asm_out);
+		LLVMDisposeMemoryBuffer(assembly);
+	}
+	if (object) objvec_push(objects, (OBJECT_FILE){ name, object });
+	else mem_free(name);
+}
+
+bool gen_write_file(char* path, LLVMMemoryBufferRef buffer) {
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		printf("Can't write '%s'\n", path);
+		return false;
+	}
+	fwrite(LLVMGetBufferStart(buffer), 1, LLVMGetBufferSize(buffer), file);
+	fclose(file);
+	return true;
+}
+
+// Local symbols become hidden globals, so that a partition can refer to the ones defined in another
+void externalize_local(LLVMValueRef value) {
+	LLVMLinkage linkage = LLVMGetLinkage(value);
+	if (linkage != LLVMPrivateLinkage && linkage != LLVMInternalLinkage) return;
+	size_t len = 0;
+	LLVMGetValueName2(value, &len);
+	if (len == 0) LLVMSetValueName2(value, "__unnamed", 9);
+	LLVMSetLinkage(value, LLVMExternalLinkage);
+	LLVMSetVisibility(value, LLVMHiddenVisibility);
+}
+
+// Replaces a global variable by a declaration of the same name
+void delete_initializer(LLVMModuleRef module, LLVMValueRef global) {
+	size_t len = 0;
+	char* name = copy_str((char*)LLVMGetValueName2(global, &len));
+	LLVMValueRef decl = LLVMAddGlobal(module, LLVMGlobalGetValueType(global), "");
+	LLVMSetVisibility(decl, LLVMGetVisibility(global));
+	LLVMReplaceAllUsesWith(global, decl);
+	LLVMDeleteGlobal(global);
+	LLVMSetValueName2(decl, name, len);
+	mem_free(name);
+}
+
+typedef struct PARTITION_TASK_t {
+	CODEGEN* g;
+	LLVMMemoryBufferRef bitcode; // of the linked program
+	uint32_t* function_partitions; // partition of every function definition, in module order
+	OBJECT_FILE* objects;
+	LLVMMemoryBufferRef* assembly;
+} PARTITION_TASK;
+
+// A partition is the linked program with the bodies of the other partitions' functions removed.
+// Global variables and the module level assembly (the entry point) are all in the first partition.
+void gen_partition_task(void* arg, long index) {
+	PARTITION_TASK* task = arg;
+	uint8_t subsystem = mem_enter(MEM_CODEGEN);
+	CODEGEN w = gen_new_worker(task->g);
+	LLVMMemoryBufferRef view = LLVMCreateMemoryBufferWithMemoryRange(LLVMGetBufferStart(task->bitcode), LLVMGetBufferSize(task->bitcode), "partition", false);
+	LLVMModuleRef module = NULL;
+	if (LLVMParseBitcodeInContext2(w.llvm_context, view, &module)) printf("Can't load the bitcode of partition %ld\n", index);
+	else {
+		LLVMSetModuleIdentifier(module, task->objects[index].name, strlen(task->objects[index].name));
+		uint32_t function = 0;
+		for (LLVMValueRef func = LLVMGetFirstFunction(module); func; func = LLVMGetNextFunction(func)) {
+			if (!LLVMIsDeclaration(func) && task->function_partitions[function++] != index) delete_body(func);
+		}
+		for (LLVMValueRef global = LLVMGetFirstGlobal(module), next; global && index; global = next) {
+			next = LLVMGetNextGlobal(global);
+			if (!LLVMIsDeclaration(global)) delete_initializer(module, global);
+		}
+		if (index) LLVMSetModuleInlineAsm2(module, "", 0);
+		gen_emit_code(&w, module, task->objects[index].name, &task->objects[index].buffer, &task->assembly[index]);
+		LLVMDisposeModule(module);
+	}
+	LLVMDisposeMemoryBuffer(view);
+	gen_delete_worker(&w);
+	LLVMContextDispose(w.llvm_context);
+	mem_leave(subsystem);
+}
+
+// Compiles the linked program to out.o, or with more than one partition to out.<n>.o on the thread pool.
+// The partitions' assembly is printed in the same order.
+// Functions are spread over the partitions by their number of instructions in module order,
+// so the objects only depend on the program and the partition count.
+void gen_emit_partitioned(CODEGEN* g, LLVMModuleRef module, OBJECT_VEC* objects) {
+	if (g->num_partitions <= 1) {
+		LLVMMemoryBufferRef object = NULL, assembly = NULL;
+		gen_emit_code(g, module, "out.o", &object, &assembly);
+		gen_add_code(g, objects, copy_str("out.o"), object, assembly);
 		return;
 	}
+
+	for (LLVMValueRef func = LLVMGetFirstFunction(module); func; func = LLVMGetNextFunction(func)) externalize_local(func);
+	for (LLVMValueRef global = LLVMGetFirstGlobal(module); global; global = LLVMGetNextGlobal(global)) externalize_local(global);
+
+	uint32_t num_functions = 0;
+	for (LLVMValueRef func = LLVMGetFirstFunction(module); func; func = LLVMGetNextFunction(func)) num_functions += !LLVMIsDeclaration(func);
+	uint32_t* function_partitions = mem_alloc(max(num_functions, 1) * sizeof(uint32_t));
+	uint64_t* partition_sizes = mem_calloc(g->num_partitions, sizeof(uint64_t));
+	uint32_t function = 0;
+	for (LLVMValueRef func = LLVMGetFirstFunction(module); func; func = LLVMGetNextFunction(func)) {
+		if (LLVMIsDeclaration(func)) continue;
+		uint32_t smallest = 0;
+		for (uint32_t p = 1; p < g->num_partitions; p++) if (partition_sizes[p] < partition_sizes[smallest]) smallest = p;
+		for (LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(func); block; block = LLVMGetNextBasicBlock(block)) {
+			for (LLVMValueRef inst = LLVMGetFirstInstruction(block); inst; inst = LLVMGetNextInstruction(inst)) partition_sizes[smallest]++;
+		}
+		function_partitions[function++] = smallest;
+	}
+
+	PARTITION_TASK task = {
+		g, LLVMWriteBitcodeToMemoryBuffer(module), function_partitions,
+		mem_calloc(g->num_partitions, sizeof(OBJECT_FILE)), mem_calloc(g->num_partitions, sizeof(LLVMMemoryBufferRef))
+	};
+	for (uint32_t p = 0; p < g->num_partitions; p++) {
+		task.objects[p].name = mem_alloc(24);
+		snprintf(task.objects[p].name, 24, "out.%u.o", p);
+	}
+	pool_run(g->pool, gen_partition_task, &task, g->num_partitions);
+
+	for (uint32_t p = 0; p < g->num_partitions; p++) gen_add_code(g, objects, task.objects[p].name, task.objects[p].buffer, task.assembly[p]);
+	mem_free(task.objects);
+	mem_free(task.assembly);
+	LLVMDisposeMemoryBuffer(task.bitcode);
+	mem_free(partition_sizes);
+	mem_free(function_partitions);
 }
 
-void gen_link(CODEGEN* g) {
-	LLVMModuleRef root_module = LLVMModuleCreateWithNameInContext("__root", g->llvm_context);
-	LLVMTypeRef entry_point_arg_types[] = { LLVMInt32Type(), LLVMPointerType(LLVMPointerType(LLVMInt8Type(), 0), 0) };
-	LLVMValueRef entry_point = LLVMAddFunction(root_module, "mainCRTStartup", LLVMFunctionType(LLVMInt32Type(), entry_point_arg_types, 2, false));
-	LLVMPositionBuilderAtEnd(g->llvm_builder, LLVMAppendBasicBlock(entry_point, "entry"));
-	LLVMBuildRet(g->llvm_builder, LLVMBuildCall(g->llvm_builder, LLVMAddFunction(root_module, "__main_init", LLVMFunctionType(LLVMInt32Type(), NULL, 0, false)), NULL, 0, ""));
-
-	//output_module(root_module, "__root.o");
-	for (int i = 0; i < g->module_vec.size; i++) {
-		/*
-		int len = strlen(g->module_name_vec.buffer[i]);
-		char* objfile_name = malloc(len + 3);
-		memcpy(objfile_name, g->module_name_vec.buffer[i], len);
-		objfile_name[len] = '.';
-		objfile_name[len + 1] = 'o';
-		objfile_name[len + 2] = 0;
-		output_module(g->module_vec.buffer[i], objfile_name);
-		free(objfile_name);
-		*/
-		LLVMLinkModules2(root_module, g->module_vec.buffer[i]);
-	}
-	output_module(root_module, "out.o");
+// <module><extension> in a new string
+char* module_file_name(char* module_name, char* extension) {
+	size_t len = strlen(module_name), extension_len = strlen(extension);
+	char* name = mem_alloc(len + extension_len + 1);
+	memcpy(name, module_name, len);
+	memcpy(name + len, extension, extension_len + 1);
+	return name;
+}
+
+typedef struct THIN_BACKEND_TASK_t {
+	CODEGEN* g;
+	OBJECT_FILE* objects;
+	LLVMMemoryBufferRef* assembly;
+} THIN_BACKEND_TASK;
+
+void gen_thin_backend_task(void* arg, long index) {
+	THIN_BACKEND_TASK* task = arg;
+	THIN_LTO* t = &task->g->thin_lto;
+	char* module_name = t->modules.buffer[index].name;
+	uint8_t subsystem = mem_enter(MEM_LTO);
+	CODEGEN w = gen_new_worker(task->g);
+	LLVMModuleRef module = thinlto_load_module(t, (uint32_t)index, w.llvm_context);
+	if (!module) printf("Can't load the bitcode of module '%s'\n", module_name);
+	else {
+		if (!w.passes) {
+			char passes[32];
+			snprintf(passes, sizeof(passes), "thinlto<O%d>", max(w.opt_level, 1));
+			gen_run_passes(&w, module, passes);
+		}
+		gen_emit_code(&w, module, module_name, &task->objects[index].buffer, &task->assembly[index]);
+		LLVMDisposeModule(module);
+	}
+	gen_delete_worker(&w);
+	LLVMContextDispose(w.llvm_context);
+	mem_leave(subsystem);
+}
+
+// Every module is compiled to <module>.o in its own context, with the functions it imports from the others
+void gen_thin_link(CODEGEN* g, OBJECT_VEC* objects) {
+	THIN_LTO* t = &g->thin_lto;
+	double start = stats_begin();
+	thinlto_compute_imports(t);
+	stats_end(PHASE_MERGE, NULL, start, 0);
+	THIN_BACKEND_TASK task = { g, mem_calloc(max(t->modules.size, 1), sizeof(OBJECT_FILE)), mem_calloc(max(t->modules.size, 1), sizeof(LLVMMemoryBufferRef)) };
+	pool_run(g->pool, gen_thin_backend_task, &task, t->modules.size);
+	for (uint32_t i = 0; i < t->modules.size; i++) {
+		gen_add_code(g, objects, module_file_name(t->modules.buffer[i].name, ".o"), task.objects[i].buffer, task.assembly[i]);
+	}
+	mem_free(task.objects);
+	mem_free(task.assembly);
+}
 
+bool gen_target_is_windows() {
+	return strstr(LLVM_DEFAULT_TARGET_TRIPLE, "windows") != NULL;
+}
+
+// lld-link only reads files, so the objects are written next to the executable's working directory first
+bool link_coff(OBJECT_VEC* objects, char* output_path) {
 	DYNAMIC_STRING link_cmd = string_new(16);
-	//string_push_s(&link_cmd, "lld-link __root.o ");
-	string_push_s(&link_cmd, "lld-link out.o ");
-	/*
-	for (int i = 0; i < g->module_vec.size; i++) {
-		string_push_s(&link_cmd, g->module_name_vec.buffer[i]);
-		string_push(&link_cmd, '.');
-		string_push(&link_cmd, 'o');
+	string_push_s(&link_cmd, "lld-link ");
+	for (long i = 0; i < objects->size; i++) {
+		if (!gen_write_file(objects->buffer[i].name, objects->buffer[i].buffer)) {
+			string_delete(&link_cmd);
+			return false;
+		}
+		string_push_s(&link_cmd, objects->buffer[i].name);
 		string_push(&link_cmd, ' ');
 	}
-	*/
-	string_push_s(&link_cmd, "msvcrt.lib /subsystem:console /out:a.exe");
-	system(link_cmd.buffer);
-	//system("lld-link out.o msvcrt.lib /subsystem:console /out:a.exe");
+	string_push_s(&link_cmd, "msvcrt.lib /subsystem:console /out:");
+	string_push_s(&link_cmd, output_path);
+	fflush(stdout);
+	bool linked = system(link_cmd.buffer) == 0;
 	string_delete(&link_cmd);
+	return linked;
+}
+
+// On Linux, _start hands main to libc like crt1.o does: libc initializes itself, calls main and exits with its result
+const char* START_ASM =
+	".globl _start\n"
+	"_start:\n"
+	"xorl %ebp, %ebp\n"
+	"movq %rdx, %r9\n" // rtld_fini
+	"popq %rsi\n" // argc
+	"movq %rsp, %rdx\n" // argv
+	"andq $-16, %rsp\n"
+	"pushq %rax\n"
+	"pushq %rsp\n" // stack_end
+	"xorl %r8d, %r8d\n" // fini
+	"xorl %ecx, %ecx\n" // init
+	"leaq main(%rip), %rdi\n"
+	"callq *__libc_start_main@GOTPCREL(%rip)\n"
+	"hlt\n";
+
+// -o names the last requested output, the others keep their default names
+char* gen_output_path(CODEGEN* g, uint8_t kind, char* default_path) {
+	bool last = g->emit < EMIT_FLAG(kind + 1);
+	return last && g->output_path ? g->output_path : default_path;
+}
+
+// ThinLTO has no linked program, the root module and the summarized modules are written to <module>.bc
+bool gen_write_thin_bitcode(CODEGEN* g, LLVMModuleRef root_module) {
+	if (gen_output_path(g, EMIT_BC, NULL)) printf("Ignoring -o, ThinLTO writes a bitcode file per module\n");
+	bool written = true;
+	if (LLVMWriteBitcodeToFile(root_module, "__root.bc")) {
+		printf("Can't write '__root.bc'\n");
+		written = false;
+	}
+	for (uint32_t i = 0; i < g->thin_lto.modules.size; i++) {
+		MODULE_SUMMARY* m = &g->thin_lto.modules.buffer[i];
+		char* path = module_file_name(m->name, ".bc");
+		written &= gen_write_file(path, m->bitcode);
+		mem_free(path);
+	}
+	return written;
+}
 
-	printf("### TEST ###\n");
-	system("a.exe");
-}
\ No newline at end of file
+bool gen_write_objects(CODEGEN* g, OBJECT_VEC* objects) {
+	char* output_path = gen_output_path(g, EMIT_OBJ, NULL);
+	if (output_path && objects->size == 1) return gen_write_file(output_path, objects->buffer[0].buffer);
+	if (output_path) printf("Ignoring -o, the program is compiled to %ld objects\n", objects->size);
+	bool written = true;
+	for (long i = 0; i < objects->size; i++) written &= gen_write_file(objects->buffer[i].name, objects->buffer[i].buffer);
+	return written;
+}
+
+// Runs the program without a shell, so the path is taken literally. Returns its exit status, 128 + the signal
+// if it was killed, or -1 if it couldn't be started (127 like a shell if the started process can't exec it).
+int run_program(char* path) {
+	fflush(stdout);
+	char* argv[] = { path, NULL };
+#ifdef _WIN32
+	intptr_t status = _spawnv(_P_WAIT, path, (const char* const*)argv);
+	if (status == -1) printf("Can't run '%s'\n", path);
+	return (int)status;
+#else
+	pid_t pid = fork();
+	if (pid == 0) {
+		execv(path, argv);
+		printf("Can't run '%s'\n", path);
+		fflush(stdout);
+		_exit(127);
+	}
+	int status;
+	if (pid < 0 || waitpid(pid, &status, 0) < 0) {
+		printf("Can't run '%s'\n", path);
+		return -1;
+	}
+	if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+	return WEXITSTATUS(status);
+#endif
+}
+
+bool gen_link(CODEGEN* g) {
+	uint8_t subsystem = mem_enter(MEM_CODEGEN);
+	bool windows = gen_target_is_windows();
+	LLVMModuleRef root_module = LLVMModuleCreateWithNameInContext("__root", g->llvm_context);
+	gen_set_target(g, root_module);
+	LLVMTypeRef entry_point_arg_types[] = { gen_type(g, TYPE_I32), LLVMPointerType(gen_type(g, TYPE_STRING), 0) };
+	LLVMValueRef entry_point = LLVMAddFunction(root_module, windows ? "mainCRTStartup" : "main", LLVMFunctionType(gen_type(g, TYPE_I32), entry_point_arg_types, 2, false));
+	LLVMPositionBuilderAtEnd(g->llvm_builder, LLVMAppendBasicBlockInContext(g->llvm_context, entry_point, "entry"));
+	LLVMTypeRef init_func_type = LLVMFunctionType(gen_type(g, TYPE_I32), NULL, 0, false);
+	LLVMBuildRet(g->llvm_builder, LLVMBuildCall2(g->llvm_builder, init_func_type, LLVMAddFunction(root_module, "__main_init", init_func_type), NULL, 0, ""));
+	if (!windows) LLVMSetModuleInlineAsm2(root_module, START_ASM, strlen(START_ASM));
+
+	bool succeeded = true;
+	bool emit_code = g->emit & (EMIT_FLAG(EMIT_ASM) | EMIT_FLAG(EMIT_OBJ) | EMIT_FLAG(EMIT_EXE));
+	OBJECT_VEC objects = objvec_new(4);
+	if (g->lto == LTO_THIN) {
+		if (g->emit & EMIT_FLAG(EMIT_BC)) succeeded &= gen_write_thin_bitcode(g, root_module);
+		if (emit_code) {
+			LLVMMemoryBufferRef root_object = NULL, root_assembly = NULL;
+			gen_emit_code(g, root_module, "__root", &root_object, &root_assembly);
+			gen_add_code(g, &objects, copy_str("__root.o"), root_object, root_assembly);
+			gen_thin_link(g, &objects);
+		}
+	} else {
+		for (int i = 0; i < g->module_vec.size; i++) {
+			double start = stats_begin();
+			char* name = copy_str(module_identifier(g->module_vec.buffer[i]));
+			LLVMLinkModules2(root_module, g->module_vec.buffer[i]);
+			stats_end(PHASE_MERGE, name, start, 0);
+			mem_free(name);
+		}
+		if (g->lto == LTO_FULL) {
+			gen_optimize_linked(g, root_module, entry_point);
+			if (g->llvm_out) {
+				fputs("### LTO ###\n", g->llvm_out);
+				char* ir = LLVMPrintModuleToString(root_module);
+				fputs(ir, g->llvm_out);
+				fputc('\n', g->llvm_out);
+				LLVMDisposeMessage(ir);
+			}
+		}
+		if (g->emit & EMIT_FLAG(EMIT_BC)) {
+			char* path = gen_output_path(g, EMIT_BC, "out.bc");
+			if (LLVMWriteBitcodeToFile(root_module, path)) {
+				printf("Can't write '%s'\n", path);
+				succeeded = false;
+			}
+		}
+		if (emit_code) gen_emit_partitioned(g, root_module, &objects);
+	}
+
+	if (g->emit & EMIT_FLAG(EMIT_OBJ)) succeeded &= gen_write_objects(g, &objects);
+	char* output_path = gen_output_path(g, EMIT_EXE, windows ? "a.exe" : "a.out");
+	bool linked = false;
+	if (g->emit & EMIT_FLAG(EMIT_EXE)) {
+		double start = stats_begin();
+		linked = windows ? link_coff(&objects, output_path) : elf_link(objects.buffer, objects.size, "_start", output_path);
+		uint64_t object_size = 0;
+		for (long i = 0; i < objects.size; i++) object_size += LLVMGetBufferSize(objects.buffer[i].buffer);
+		stats_end(PHASE_LINK, NULL, start, object_size);
+		succeeded &= linked;
+	}
+	for (long i = 0; i < objects.size; i++) {
+		mem_free(objects.buffer[i].name);
+		LLVMDisposeMemoryBuffer(objects.buffer[i].buffer);
+	}
+	objvec_delete(&objects);
+
+	if (linked && g->run) {
+		g->run_status = run_program(output_path);
+		succeeded &= g->run_status >= 0;
+	}
+	mem_leave(subsystem);
+	return succeeded;
+}
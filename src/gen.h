@@ -6,23 +6,47 @@
 #include <stdbool.h>
 
 #include <llvm-c/Core.h>
+#include <llvm-c/TargetMachine.h>
 
 #include "ast.h"
 #include "utils.h"
+#include "thinlto.h"
+#include "thread.h"
+#include "linker.h"
+
+enum LTO_MODE {
+	LTO_NONE,
+	LTO_FULL, // link all modules, then optimize the whole program
+	LTO_THIN // optimize and compile the modules separately after importing from the others (see thinlto.h)
+};
+
+// Outputs the driver can be asked for with --emit, in pipeline order. A stage only runs if it or a later one is emitted.
+enum EMIT_KIND {
+	EMIT_TOKENS,
+	EMIT_AST,
+	EMIT_LLVM, // IR of every module after optimization, and of the linked program with full LTO
+	EMIT_BC, // bitcode of the linked program, of every module with ThinLTO
+	EMIT_ASM, // assembly of every object
+	EMIT_OBJ,
+	EMIT_EXE,
+	NUM_EMIT_KINDS
+};
+
+#define EMIT_FLAG(kind) (1 << (kind))
 
 typedef struct SCOPE_t {
 	struct SCOPE_t* parent;
 
 	LLVMBasicBlockRef break_dest;
 	LLVMBasicBlockRef continue_dest;
-
-	STRING_VEC locals_k;
-	VALUE_VEC locals_v;
 } SCOPE;
 
+// Modules are generated on the driver's thread pool, each by a copy of the CODEGEN with an LLVM context of its own.
+// Afterwards they are moved to the main context as bitcode, or summarized from their own context for ThinLTO.
 typedef struct CODEGEN_t {
 	LLVMContextRef llvm_context;
 	LLVMBuilderRef llvm_builder;
+	LLVMBuilderRef alloca_builder; // positioned in the entry block of the current function
 	STRING_VEC module_name_vec;
 	AST_VEC module_ast_vec;
 	MODULE_VEC module_vec;
@@ -33,12 +57,39 @@ typedef struct CODEGEN_t {
 	LLVMValueRef llvm_func;
 	bool has_branched;
 
-	STRING_VEC globals_k;
-	VALUE_VEC globals_v;
+	LLVMValueRef* binding_values; // storage of every binding of the current module, functions for function bindings
+	LLVMTypeRef* llvm_types; // indexed by TYPE_ID, created on first use
+	uint32_t num_llvm_types;
+
+	uint8_t opt_level; // 0 to 3, selects the default pass pipeline and the backend optimization level
+	char* passes; // custom pass pipeline in LLVM's textual syntax, replaces the default one
+	uint8_t lto; // LTO_MODE, the link time optimizations run at least at -O1
+	uint32_t num_partitions; // the linked program is split into this many objects that are compiled in parallel
+	THIN_LTO thin_lto;
+	LLVMTargetMachineRef target_machine;
+	THREAD_POOL* pool; // set by the driver
+	uint8_t emit; // EMIT_FLAGs of the requested outputs
+	FILE* llvm_out; // buffered writers of the text outputs, set by the driver if they are emitted
+	FILE* asm_out;
+	char* output_path; // replaces the default file name of the last requested output
+	bool run; // execute the program after linking it
+	int run_status; // exit status of the program run by gen_link
 } CODEGEN;
 
+// One module generated on a worker thread
+typedef struct GENERATED_MODULE_t {
+	char* ir; // printed after optimization if it is emitted
+	LLVMMemoryBufferRef bitcode;
+	LLVMContextRef context; // ThinLTO keeps the module in its context until it is summarized
+	LLVMModuleRef module;
+} GENERATED_MODULE;
+
 CODEGEN gen_new();
 void gen_delete(CODEGEN* codegen);
 
 void gen_create_module(CODEGEN* g, AST* ast, char* module_name);
-void gen_link(CODEGEN* g);
\ No newline at end of file
+// Generates and optimizes every module of module_ast_vec in parallel and prints them in order
+void gen_create_modules(CODEGEN* g);
+// Links the modules and writes the requested outputs from bitcode on, returns false if one of them failed.
+// With run it executes the program and sets run_status, a program that can't be started counts as failed.
+bool gen_link(CODEGEN* g);
\ No newline at end of file
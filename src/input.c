@@ -1,26 +1,78 @@
 #include "input.h"
 
-INPUTSTREAM input_new(char* buffer) {
+#include "scan.h"
+
+// The table is filled in chunks so that the worst case of one line per byte only has to be reserved for a chunk
+#define LINE_TABLE_CHUNK_SIZE (64 * 1024)
+
+LINE_TABLE line_table_new(const char* buffer, uint32_t size) {
+	LINE_TABLE table;
+	table.buffer = buffer;
+	table.size = size;
+	table.line_starts = NULL;
+	table.num_lines = 0;
+	return table;
+}
+
+void line_table_delete(LINE_TABLE* table) {
+	mem_free(table->line_starts);
+	table->line_starts = NULL;
+	table->num_lines = 0;
+}
+
+void line_table_build(LINE_TABLE* table) {
+	uint8_t subsystem = mem_enter(MEM_INPUT);
+	uint32_t capacity = LINE_TABLE_CHUNK_SIZE + 1;
+	uint32_t* line_starts = mem_alloc(capacity * sizeof(uint32_t));
+	uint32_t num_lines = 1;
+	line_starts[0] = 0;
+	for (uint32_t chunk = 0; chunk < table->size;) {
+		uint32_t chunk_size = table->size - chunk < LINE_TABLE_CHUNK_SIZE ? table->size - chunk : LINE_TABLE_CHUNK_SIZE;
+		if (capacity - num_lines < chunk_size) {
+			capacity *= 2;
+			line_starts = mem_realloc(line_starts, capacity * sizeof(uint32_t));
+		}
+		const char* start = table->buffer + chunk;
+		num_lines = (uint32_t)(scanner.line_starts(start, start + chunk_size, table->buffer, line_starts + num_lines) - line_starts);
+		chunk += chunk_size;
+	}
+	table->line_starts = line_starts;
+	table->num_lines = num_lines;
+	mem_leave(subsystem);
+}
+
+SOURCE_LOCATION line_table_locate(LINE_TABLE* table, uint32_t offset) {
+	if (!table->line_starts) line_table_build(table);
+	// Last line that starts at or before offset
+	uint32_t lo = 0, hi = table->num_lines;
+	while (hi - lo > 1) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (table->line_starts[mid] <= offset) lo = mid;
+		else hi = mid;
+	}
+	return (SOURCE_LOCATION){ lo + 1, offset - table->line_starts[lo] + 1 };
+}
+
+INPUTSTREAM input_new(const char* buffer, uint32_t size) {
 	INPUTSTREAM i;
 	i.buffer = buffer;
+	i.end = buffer + size;
 	i.ptr = buffer;
-	i.line = 1;
-	i.col = 1;
+	i.lines = line_table_new(buffer, size);
+	i.num_errors = 0;
+	uint8_t subsystem = mem_enter(MEM_INPUT);
+	i.diagnostics = string_new(64);
+	mem_leave(subsystem);
 	return i;
 }
 
 void input_delete(INPUTSTREAM* i) {
-	free(i->buffer);
+	line_table_delete(&i->lines);
+	string_delete(&i->diagnostics);
 }
 
 char input_next(INPUTSTREAM* i) {
-	char c = *i->ptr;
-	i->ptr++;
-	if (c == '\n') {
-		i->line++;
-		i->col = 0;
-	} else i->col++;
-	return c;
+	return *i->ptr++;
 }
 
 char input_peek(INPUTSTREAM* i) {
@@ -32,23 +84,52 @@ char input_peek_n(INPUTSTREAM* i, int offset) {
 }
 
 bool input_eof(INPUTSTREAM* i) {
-	return *i->ptr == 0;
+	return i->ptr >= i->end;
 }
 
-void input_rewind(INPUTSTREAM* i, char* ptr) {
+uint32_t input_offset(INPUTSTREAM* i) {
+	return (uint32_t)(i->ptr - i->buffer);
+}
+
+void input_rewind(INPUTSTREAM* i, const char* ptr) {
+	i->ptr = ptr;
+}
+
+void input_advance(INPUTSTREAM* i, const char* ptr) {
 	i->ptr = ptr;
 }
 
 void input_reset(INPUTSTREAM* i) {
 	input_rewind(i, i->buffer);
-	i->line = 1;
-	i->col = 1;
 }
 
-void input_error(INPUTSTREAM* i, const char* msg, int line, int col, va_list args) {
-	if (line == -1) line = i->line;
-	if (col == -1) col = i->col;
-	printf("(%d,%d) ", line, col);
-	vprintf(msg, args);
-	putchar('\n');
+SOURCE_LOCATION input_locate(INPUTSTREAM* i, uint32_t offset) {
+	return line_table_locate(&i->lines, offset);
+}
+
+void input_error(INPUTSTREAM* i, const char* msg, uint32_t offset, va_list args) {
+	SOURCE_LOCATION loc = input_locate(i, offset);
+	DYNAMIC_STRING* out = &i->diagnostics;
+	va_list count_args;
+	va_copy(count_args, args);
+	int len = snprintf(NULL, 0, "(%u,%u) ", loc.line, loc.col) + vsnprintf(NULL, 0, msg, count_args) + 1;
+	va_end(count_args);
+	if (out->capacity - out->size < len) {
+		uint8_t subsystem = mem_enter(MEM_INPUT);
+		string_resize(out, out->capacity + len);
+		mem_leave(subsystem);
+	}
+	char* end = out->buffer + out->size;
+	end += sprintf(end, "(%u,%u) ", loc.line, loc.col);
+	end += vsprintf(end, msg, args);
+	*end++ = '\n';
+	*end = 0;
+	out->size = (long)(end - out->buffer);
+	i->num_errors++;
+}
+
+void input_flush(INPUTSTREAM* i) {
+	fwrite(i->diagnostics.buffer, 1, i->diagnostics.size, stdout);
+	i->diagnostics.size = 0;
+	i->diagnostics.buffer[0] = 0;
 }
@@ -6,20 +6,54 @@
 #include <stdbool.h>
 #include <stdarg.h>
 
+#include "utils.h"
+
+// Sources are addressed by 32 bit byte offsets, so a single file can be at most 4 GB
+#define MAX_SOURCE_SIZE UINT32_MAX
+
+// 1 based line and column of a byte offset
+typedef struct SOURCE_LOCATION_t {
+	uint32_t line, col;
+} SOURCE_LOCATION;
+
+// Offset of the first byte of every line. Tokens and nodes only store byte offsets,
+// the table is built in one pass on the first lookup, which only diagnostics and debug info need.
+typedef struct LINE_TABLE_t {
+	const char* buffer;
+	uint32_t size;
+	uint32_t* line_starts;
+	uint32_t num_lines;
+} LINE_TABLE;
+
+LINE_TABLE line_table_new(const char* buffer, uint32_t size);
+void line_table_delete(LINE_TABLE* table);
+SOURCE_LOCATION line_table_locate(LINE_TABLE* table, uint32_t offset);
+
+// Reads from a null terminated buffer that is owned by the caller and never written to
 typedef struct INPUTSTREAM_t {
-	char* buffer;
-	char* ptr;
-	int line, col;
+	const char* buffer;
+	const char* end;
+	const char* ptr;
+	LINE_TABLE lines;
+	uint32_t num_errors; // reported by input_error
+	// Messages of input_error, collected until input_flush so that modules processed in parallel report in order
+	DYNAMIC_STRING diagnostics;
 } INPUTSTREAM;
 
-INPUTSTREAM input_new(char* buffer);
+INPUTSTREAM input_new(const char* buffer, uint32_t size);
 void input_delete(INPUTSTREAM* i);
 
 char input_next(INPUTSTREAM* i);
 char input_peek(INPUTSTREAM* i);
 char input_peek_n(INPUTSTREAM* i, int offset);
 bool input_eof(INPUTSTREAM* i);
-void input_rewind(INPUTSTREAM* i, char* ptr);
+uint32_t input_offset(INPUTSTREAM* i);
+void input_rewind(INPUTSTREAM* i, const char* ptr);
+// Moves forward to ptr, the end of a run found by one of the scanners
+void input_advance(INPUTSTREAM* i, const char* ptr);
 void input_reset(INPUTSTREAM* i);
 
-void input_error(INPUTSTREAM* i, const char* msg, int line, int col, va_list args);
+SOURCE_LOCATION input_locate(INPUTSTREAM* i, uint32_t offset);
+void input_error(INPUTSTREAM* i, const char* msg, uint32_t offset, va_list args);
+// Prints the collected diagnostics
+void input_flush(INPUTSTREAM* i);
@@ -0,0 +1,102 @@
+#include "intern.h"
+
+#include <string.h>
+
+#include "alloc.h"
+
+// The top bits of the hash pick the shard, the low bits the slot within it
+INTERN_TABLE intern_shards[NUM_INTERN_SHARDS];
+
+#define ATOM_HEADER_OF(atom) ((ATOM_HEADER*)(atom) - 1)
+
+uint32_t hash_str(const char* str, long len) {
+	uint32_t hash = 2166136261u;
+	for (long i = 0; i < len; i++) {
+		hash ^= (uint8_t)str[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+void intern_init() {
+	uint8_t subsystem = mem_enter(MEM_INTERN);
+	for (int i = 0; i < NUM_INTERN_SHARDS; i++) {
+		INTERN_TABLE* table = &intern_shards[i];
+		table->size = 0;
+		table->capacity = 1024 / NUM_INTERN_SHARDS;
+		table->entries = mem_calloc(table->capacity, sizeof(INTERN_ENTRY));
+		table->strings = arena_new(16 * 1024);
+		mutex_init(&table->lock);
+	}
+	mem_leave(subsystem);
+}
+
+void intern_delete() {
+	for (int i = 0; i < NUM_INTERN_SHARDS; i++) {
+		INTERN_TABLE* table = &intern_shards[i];
+		mem_free(table->entries);
+		arena_delete(&table->strings);
+		mutex_delete(&table->lock);
+		*table = (INTERN_TABLE){ 0 };
+	}
+}
+
+void intern_grow(INTERN_TABLE* table) {
+	INTERN_ENTRY* old_entries = table->entries;
+	long old_capacity = table->capacity;
+	table->capacity *= 2;
+	table->entries = mem_calloc(table->capacity, sizeof(INTERN_ENTRY));
+	for (long i = 0; i < old_capacity; i++) {
+		if (!old_entries[i].atom) continue;
+		long idx = old_entries[i].hash & (table->capacity - 1);
+		while (table->entries[idx].atom) idx = (idx + 1) & (table->capacity - 1);
+		table->entries[idx] = old_entries[i];
+	}
+	mem_free(old_entries);
+}
+
+char* intern(const char* str, long len) {
+	uint32_t hash = hash_str(str, len);
+	INTERN_TABLE* table = &intern_shards[hash >> (32 - INTERN_SHARD_BITS)];
+	mutex_lock(&table->lock);
+	long idx = hash & (table->capacity - 1);
+	while (table->entries[idx].atom) {
+		INTERN_ENTRY* entry = &table->entries[idx];
+		if (entry->hash == hash && ATOM_HEADER_OF(entry->atom)->len == len && memcmp(entry->atom, str, len) == 0) {
+			mutex_unlock(&table->lock);
+			return entry->atom;
+		}
+		idx = (idx + 1) & (table->capacity - 1);
+	}
+
+	uint8_t subsystem = mem_enter(MEM_INTERN);
+	ATOM_HEADER* header = arena_alloc(&table->strings, sizeof(ATOM_HEADER) + len + 1);
+	header->len = (uint32_t)len;
+	header->tag = 0;
+	char* atom = (char*)(header + 1);
+	memcpy(atom, str, len);
+	atom[len] = 0;
+
+	table->entries[idx] = (INTERN_ENTRY){ atom, hash };
+	if (++table->size * 2 > table->capacity) intern_grow(table);
+	mem_leave(subsystem);
+	mutex_unlock(&table->lock);
+
+	return atom;
+}
+
+char* intern_str(const char* str) {
+	return intern(str, strlen(str));
+}
+
+uint32_t intern_len(const char* atom) {
+	return ATOM_HEADER_OF(atom)->len;
+}
+
+uint8_t intern_tag(const char* atom) {
+	return ATOM_HEADER_OF(atom)->tag;
+}
+
+void intern_set_tag(char* atom, uint8_t tag) {
+	ATOM_HEADER_OF(atom)->tag = tag;
+}
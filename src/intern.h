@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arena.h"
+#include "thread.h"
+
+// Every distinct name is stored exactly once, so two atoms are equal iff their pointers are equal.
+// Atoms are null terminated and stay valid until intern_delete.
+// intern may be called from several threads at once (the front end lexes modules in parallel),
+// the table is split into shards by hash that are locked separately so lexers rarely wait for each other.
+
+#define INTERN_SHARD_BITS 4
+#define NUM_INTERN_SHARDS (1 << INTERN_SHARD_BITS)
+
+typedef struct ATOM_HEADER_t {
+	uint32_t len;
+	uint8_t tag;
+} ATOM_HEADER;
+
+typedef struct INTERN_ENTRY_t {
+	char* atom;
+	uint32_t hash;
+} INTERN_ENTRY;
+
+typedef struct INTERN_TABLE_t {
+	INTERN_ENTRY* entries;
+	long size;
+	long capacity;
+	ARENA strings;
+	MUTEX lock;
+} INTERN_TABLE;
+
+void intern_init();
+void intern_delete();
+
+char* intern(const char* str, long len);
+char* intern_str(const char* str);
+
+uint32_t intern_len(const char* atom);
+uint8_t intern_tag(const char* atom);
+// Tags are only set before the front end starts its threads, afterwards they are read only
+void intern_set_tag(char* atom, uint8_t tag);
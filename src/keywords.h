@@ -13,4 +13,31 @@
 #define KEYWORD_FUNC_DECL "decl"
 #define KEYWORD_FUNC_DEF "def"
 
-#define KEYWORD_IMPORT "use"
\ No newline at end of file
+#define KEYWORD_IMPORT "use"
+
+enum KEYWORD_ID {
+	KEYWORD_ID_NONE,
+
+	KEYWORD_ID_TRUE,
+	KEYWORD_ID_FALSE,
+
+	KEYWORD_ID_RETURN,
+	KEYWORD_ID_IF,
+	KEYWORD_ID_ELSE,
+	KEYWORD_ID_LOOP,
+	KEYWORD_ID_WHILE,
+	KEYWORD_ID_BREAK,
+	KEYWORD_ID_CONTINUE,
+	KEYWORD_ID_FUNC_DECL,
+	KEYWORD_ID_FUNC_DEF,
+
+	KEYWORD_ID_IMPORT,
+
+	NUM_KEYWORD_IDS
+};
+
+// Perfect hash over the keywords above, the table in lexer.c is static and a collision fails the build.
+// Identifiers always have a character after them in the source (at least the null terminator), so str[1] can be read for len 1.
+#define KEYWORD_HASH_SIZE 16
+#define KEYWORD_SLOT(len, c0, c1) (((len) + (c0) * 2 + (c1) * 4) & (KEYWORD_HASH_SIZE - 1))
+#define KEYWORD_HASH(str, len) KEYWORD_SLOT(len, (uint8_t)(str)[0], (uint8_t)(str)[1])
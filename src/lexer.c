@@ -1,243 +1,329 @@
 #include "lexer.h"
 
-#include <ctype.h>
 #include <string.h>
 #include <stdarg.h>
 
 #include "utils.h"
 #include "keywords.h"
+#include "intern.h"
+#include "scan.h"
 
-const char* KEYWORDS[] = {
-	KEYWORD_TRUE,
-	KEYWORD_FALSE,
+const char* KEYWORDS[NUM_KEYWORD_IDS] = {
+	[KEYWORD_ID_TRUE] = KEYWORD_TRUE,
+	[KEYWORD_ID_FALSE] = KEYWORD_FALSE,
 
-	KEYWORD_RETURN,
-	KEYWORD_IF,
-	KEYWORD_ELSE,
-	KEYWORD_LOOP,
-	KEYWORD_WHILE,
-	KEYWORD_BREAK,
-	KEYWORD_CONTINUE,
+	[KEYWORD_ID_RETURN] = KEYWORD_RETURN,
+	[KEYWORD_ID_IF] = KEYWORD_IF,
+	[KEYWORD_ID_ELSE] = KEYWORD_ELSE,
+	[KEYWORD_ID_LOOP] = KEYWORD_LOOP,
+	[KEYWORD_ID_WHILE] = KEYWORD_WHILE,
+	[KEYWORD_ID_BREAK] = KEYWORD_BREAK,
+	[KEYWORD_ID_CONTINUE] = KEYWORD_CONTINUE,
 
-	KEYWORD_FUNC_DECL,
-	KEYWORD_FUNC_DEF,
+	[KEYWORD_ID_FUNC_DECL] = KEYWORD_FUNC_DECL,
+	[KEYWORD_ID_FUNC_DEF] = KEYWORD_FUNC_DEF,
 
-	KEYWORD_IMPORT,
+	[KEYWORD_ID_IMPORT] = KEYWORD_IMPORT,
+};
+
+DEF_DYNAMIC_VECTOR(TOKEN, TOKEN_VEC, tokvec)
+
+// The first character of a token selects how it is read, the operator characters have a class each
+enum CHAR_CLASS {
+	CC_INVALID,
+	CC_SEPARATOR,
+	CC_LETTER,
+	CC_DIGIT,
+	CC_DOT,
+	CC_PUNC,
+	CC_QUOTE,
+	CC_DOUBLE_QUOTE,
+
+	CC_PLUS,
+	CC_MINUS,
+	CC_STAR,
+	CC_SLASH,
+	CC_PERCENT,
+	CC_EQUALS,
+	CC_AMP,
+	CC_PIPE,
+	CC_LESS,
+	CC_GREATER,
+	CC_BANG,
+
+	NUM_CHAR_CLASSES
+};
 
-	""
+uint8_t CHAR_CLASSES[256];
+
+// Operator DFA, the states are the operators read so far. OP_NONE as the next state ends the token.
+const uint8_t OP_TRANSITIONS[NUM_OPS][NUM_CHAR_CLASSES] = {
+	[OP_NONE] = {
+		[CC_PLUS] = OP_ADD, [CC_MINUS] = OP_SUB, [CC_STAR] = OP_MUL, [CC_SLASH] = OP_DIV, [CC_PERCENT] = OP_MOD,
+		[CC_EQUALS] = OP_ASSIGN, [CC_AMP] = OP_BIT_AND, [CC_PIPE] = OP_BIT_OR, [CC_LESS] = OP_LT, [CC_GREATER] = OP_GT, [CC_BANG] = OP_NOT,
+	},
+	[OP_ADD] = { [CC_EQUALS] = OP_ADD_ASSIGN, [CC_PLUS] = OP_INC },
+	[OP_SUB] = { [CC_EQUALS] = OP_SUB_ASSIGN, [CC_MINUS] = OP_DEC },
+	[OP_MUL] = { [CC_EQUALS] = OP_MUL_ASSIGN },
+	[OP_DIV] = { [CC_EQUALS] = OP_DIV_ASSIGN },
+	[OP_MOD] = { [CC_EQUALS] = OP_MOD_ASSIGN },
+	[OP_ASSIGN] = { [CC_EQUALS] = OP_EQ },
+	[OP_NOT] = { [CC_EQUALS] = OP_NE },
+	[OP_LT] = { [CC_EQUALS] = OP_LE },
+	[OP_GT] = { [CC_EQUALS] = OP_GE },
+	[OP_BIT_AND] = { [CC_AMP] = OP_AND },
+	[OP_BIT_OR] = { [CC_PIPE] = OP_OR },
 };
 
+// Keywords with their first two characters, which a constant expression can't read from the string
+#define KEYWORD_LIST(X) \
+	X(TRUE, 't', 'r') X(FALSE, 'f', 'a') \
+	X(RETURN, 'r', 'e') X(IF, 'i', 'f') X(ELSE, 'e', 'l') X(LOOP, 'l', 'o') X(WHILE, 'w', 'h') X(BREAK, 'b', 'r') X(CONTINUE, 'c', 'o') \
+	X(FUNC_DECL, 'd', 'e') X(FUNC_DEF, 'd', 'e') \
+	X(IMPORT, 'u', 's')
+
+#define KEYWORD_SLOT_OF(name, c0, c1) KEYWORD_SLOT(sizeof(KEYWORD_##name) - 1, c0, c1)
+#define KEYWORD_TABLE_ENTRY(name, c0, c1) [KEYWORD_SLOT_OF(name, c0, c1)] = KEYWORD_ID_##name,
+#define KEYWORD_LENGTH_ENTRY(name, c0, c1) [KEYWORD_ID_##name] = sizeof(KEYWORD_##name) - 1,
+#define KEYWORD_SLOT_SUM(name, c0, c1) + (1u << KEYWORD_SLOT_OF(name, c0, c1))
+#define KEYWORD_SLOT_UNION(name, c0, c1) | (1u << KEYWORD_SLOT_OF(name, c0, c1))
+
+const uint8_t KEYWORD_TABLE[KEYWORD_HASH_SIZE] = { KEYWORD_LIST(KEYWORD_TABLE_ENTRY) };
+const uint8_t KEYWORD_LENGTHS[NUM_KEYWORD_IDS] = { KEYWORD_LIST(KEYWORD_LENGTH_ENTRY) };
+
+// The slot bits only add up to their union if no two keywords share a slot
+_Static_assert((0 KEYWORD_LIST(KEYWORD_SLOT_SUM)) == (0 KEYWORD_LIST(KEYWORD_SLOT_UNION)), "Keyword hash collision, KEYWORD_HASH in keywords.h has to be adjusted");
+
+void lexer_init() {
+	for (int c = 'a'; c <= 'z'; c++) CHAR_CLASSES[c] = CC_LETTER;
+	for (int c = 'A'; c <= 'Z'; c++) CHAR_CLASSES[c] = CC_LETTER;
+	for (int c = '0'; c <= '9'; c++) CHAR_CLASSES[c] = CC_DIGIT;
+	CHAR_CLASSES['_'] = CC_LETTER;
+	CHAR_CLASSES['\n'] = CC_SEPARATOR;
+	CHAR_CLASSES[';'] = CC_SEPARATOR;
+	CHAR_CLASSES['.'] = CC_DOT;
+	for (const char* c = ",(){}[]"; *c; c++) CHAR_CLASSES[(uint8_t)*c] = CC_PUNC;
+	CHAR_CLASSES['\''] = CC_QUOTE;
+	CHAR_CLASSES['"'] = CC_DOUBLE_QUOTE;
+	CHAR_CLASSES['+'] = CC_PLUS;
+	CHAR_CLASSES['-'] = CC_MINUS;
+	CHAR_CLASSES['*'] = CC_STAR;
+	CHAR_CLASSES['/'] = CC_SLASH;
+	CHAR_CLASSES['%'] = CC_PERCENT;
+	CHAR_CLASSES['='] = CC_EQUALS;
+	CHAR_CLASSES['&'] = CC_AMP;
+	CHAR_CLASSES['|'] = CC_PIPE;
+	CHAR_CLASSES['<'] = CC_LESS;
+	CHAR_CLASSES['>'] = CC_GREATER;
+	CHAR_CLASSES['!'] = CC_BANG;
+}
+
 LEXER lexer_new(INPUTSTREAM* input) {
 	LEXER l;
 
 	l.input = input;
 	//l.current = TOKEN_NULL;
 	//l.last = TOKEN_NULL;
-	l.line = 1;
-	l.col = 1;
+	l.offset = 0;
 
-	l.token_data = strvec_new(64);
+	uint8_t subsystem = mem_enter(MEM_LEXER);
+	l.token_data = strvec_new(4);
+	l.tokens = tokvec_new(256);
+	mem_leave(subsystem);
 
 	return l;
 }
 
 void lexer_delete(LEXER* l) {
 	for (int i = 0; i < l->token_data.size; i++) {
-		free(l->token_data.buffer[i]);
+		mem_free(l->token_data.buffer[i]);
 	}
 	strvec_delete(&l->token_data);
+	tokvec_delete(&l->tokens);
 }
 
-bool is_whitespace(char c) {
-	return c == ' ' || c == '\t' || c == '\r';
+uint8_t char_class(char c) {
+	return CHAR_CLASSES[(uint8_t)c];
 }
 
-bool is_identifier(char c) {
-	return isdigit(c) || isalpha(c) || c == '_';
+uint8_t find_keyword(const char* str, long len) {
+	uint8_t id = KEYWORD_TABLE[KEYWORD_HASH(str, len)];
+	return id && KEYWORD_LENGTHS[id] == len && memcmp(KEYWORDS[id], str, len) == 0 ? id : KEYWORD_ID_NONE;
 }
 
-bool is_keyword(char* str) {
-	for (int i = 0; KEYWORDS[i][0] != 0; i++) {
-		if (strcmp(str, KEYWORDS[i]) == 0) return true;
+char* decode_escaped(LEXER* l, const char* str, long len, long* decoded_len) {
+	char* result = mem_alloc(len + 1);
+	long n = 0;
+	for (long i = 0; i < len; i++) {
+		if (str[i] != '\\' || i == len - 1) {
+			result[n++] = str[i];
+			continue;
+		}
+		char c = str[++i];
+		switch (c) {
+		case 'n': result[n++] = '\n'; break;
+		case 't': result[n++] = '\t'; break;
+		case 'r': result[n++] = '\r'; break;
+		case '0': result[n++] = '\0'; break;
+		default: lexer_error(l, "Unknown escape character \\%c", c); break;
+		}
 	}
-	return false;
-}
-
-bool is_num(char c, char c2) {
-	return isdigit(c) || c == '-' && isdigit(c2) || c == '.' && isdigit(c2);
-}
-
-bool is_punc(char c) {
-	return c == '.' || c == ',' || c == ';' || c == '(' || c == ')' || c == '{' || c == '}' || c == '[' || c == ']';
-}
-
-bool is_op(char c) {
-	return c == '+' || c == '-' || c == '*' || c == '/' || c == '%' || c == '=' || c == '&' || c == '|' || c == '<' || c == '>' || c == '!';
-}
-
-bool is_digit(char c) {
-	return isdigit(c) || c == '-' || c == '.';
-}
-
-bool not_newline(char c) {
-	return c != '\n';
-}
-
-bool not_block_comment_end(char c, char c2) {
-	return c != '*' || c2 != '/';
+	result[n] = 0;
+	strvec_push(&l->token_data, result);
+	*decoded_len = n;
+	return result;
 }
 
-char* read_while(LEXER* l, bool(*parser)(char)) {
-	DYNAMIC_STRING result = string_new(10);
-	while (!input_eof(l->input) && parser(input_peek(l->input))) {
-		string_push(&result, input_next(l->input));
+// Returns a view into the input buffer, only allocates if escape sequences have to be decoded
+TOKEN read_escaped(LEXER* l, uint8_t type, char end) {
+	input_next(l->input);
+	const char* start = l->input->ptr;
+	bool has_escape = false;
+	while (!input_eof(l->input) && input_peek(l->input) != end) {
+		if (input_next(l->input) == '\\') {
+			has_escape = true;
+			if (!input_eof(l->input)) input_next(l->input);
+		}
 	}
-	strvec_push(&l->token_data, result.buffer);
-	return result.buffer;
-}
+	long len = (long)(l->input->ptr - start);
+	if (!input_eof(l->input)) input_next(l->input);
 
-char* read_while2(LEXER* l, bool(*parser)(char, char)) {
-	DYNAMIC_STRING result = string_new(10);
-	while (!input_eof(l->input) && parser(input_peek(l->input), input_peek_n(l->input, 1))) {
-		string_push(&result, input_next(l->input));
-	}
-	strvec_push(&l->token_data, result.buffer);
-	return result.buffer;
-}
-
-char* read_escaped(LEXER* l, char end) {
-	DYNAMIC_STRING result = string_new(100);
-	bool esc = false;
-	while (!input_eof(l->input)) {
-		char c = input_next(l->input);
-		if (esc) {
-			esc = false;
-			char escaped = 0;
-			switch (c) {
-			case 'n': escaped = '\n'; break;
-			case 't': escaped = '\t'; break;
-			case 'r': escaped = '\r'; break;
-			case '0': escaped = '\0'; break;
-			default: lexer_error(l, "Unknown escape character \\%c", c); continue;
-			}
-			string_push(&result, escaped);
-		} else if (c == '\\') esc = true;
-		else if (c == end) break;
-		else string_push(&result, c);
-	}
-	strvec_push(&l->token_data, result.buffer);
-	return result.buffer;
+	if (!has_escape) return (TOKEN) { .type = type, .value = start, .len = len };
+	long decoded_len = 0;
+	char* decoded = decode_escaped(l, start, len, &decoded_len);
+	return (TOKEN) { .type = type, .value = decoded, .len = decoded_len };
 }
 
 TOKEN read_number(LEXER* l) {
-	char* str = read_while(l, is_digit);
-	bool fpoint = false;
-	for (int i = 0; str[i] != 0; i++) {
-		if (str[i] == '.') {
-			fpoint = true;
-			break;
-		}
-	}
-	return (TOKEN) { fpoint ? TOKEN_TYPE_FLOAT : TOKEN_TYPE_INT, str };
+	const char* str = l->input->ptr;
+	const char* end = str;
+	uint8_t cc;
+	while ((cc = char_class(*end)) == CC_DIGIT || cc == CC_MINUS || cc == CC_DOT) end++;
+	input_advance(l->input, end);
+	long len = (long)(end - str);
+	bool fpoint = memchr(str, '.', len) != NULL;
+	return (TOKEN) { .type = fpoint ? TOKEN_TYPE_FLOAT : TOKEN_TYPE_INT, .value = str, .len = len };
 }
 
 TOKEN read_char(LEXER* l) {
-	input_next(l->input);
-	return (TOKEN) { TOKEN_TYPE_CHAR, read_escaped(l, '\'') };
+	return read_escaped(l, TOKEN_TYPE_CHAR, '\'');
 }
 
 TOKEN read_string(LEXER* l) {
-	input_next(l->input);
-	return (TOKEN) { TOKEN_TYPE_STRING, read_escaped(l, '"') };
+	return read_escaped(l, TOKEN_TYPE_STRING, '"');
 }
 
 TOKEN read_identifier(LEXER* l) {
-	char* value = read_while(l, is_identifier);
-	return (TOKEN) { is_keyword(value) ? TOKEN_TYPE_KEYWORD : TOKEN_TYPE_IDENTIFIER, value };
+	const char* value = l->input->ptr;
+	input_advance(l->input, scanner.identifier(value, l->input->end));
+	long len = (long)(l->input->ptr - value);
+	uint8_t keyword = find_keyword(value, len);
+	if (keyword) {
+		return (TOKEN) { .type = TOKEN_TYPE_KEYWORD, .value = value, .len = len, .keyword = keyword };
+	}
+	return (TOKEN) { .type = TOKEN_TYPE_IDENTIFIER, .value = intern(value, len), .len = len };
+}
+
+// Longest match through OP_TRANSITIONS, the null terminator has no transitions so the input can't be overrun
+TOKEN read_op(LEXER* l) {
+	const char* value = l->input->ptr;
+	const char* end = value;
+	uint8_t op = OP_NONE;
+	uint8_t next;
+	while ((next = OP_TRANSITIONS[op][char_class(*end)]) != OP_NONE) {
+		op = next;
+		end++;
+	}
+	input_advance(l->input, end);
+	return (TOKEN) { .type = TOKEN_TYPE_OP, .value = value, .len = (long)(end - value), .op = op };
 }
 
 void skip_line_comment(LEXER* l) {
 	input_next(l->input);
 	input_next(l->input);
-	read_while(l, not_newline);
+	input_advance(l->input, scanner.line_end(l->input->ptr, l->input->end));
 	if (!input_eof(l->input)) input_next(l->input);
 }
 
 void skip_block_comment(LEXER* l) {
 	input_next(l->input);
 	input_next(l->input);
-	read_while2(l, not_block_comment_end);
-	input_next(l->input);
-	input_next(l->input);
+	input_advance(l->input, scanner.block_comment_end(l->input->ptr, l->input->end));
+	if (!input_eof(l->input)) input_next(l->input);
+	if (!input_eof(l->input)) input_next(l->input);
 }
 
-TOKEN read_next(LEXER* l) {
-	read_while(l, is_whitespace);
-	if (input_eof(l->input)) return TOKEN_NULL;
+void skip_ignored(LEXER* l) {
+	while (true) {
+		input_advance(l->input, scanner.whitespace(l->input->ptr, l->input->end));
+		if (input_eof(l->input)) return;
 
-	char next = input_peek(l->input);
-	char next2 = input_peek_n(l->input, 1);
+		char next = input_peek(l->input);
+		char next2 = input_peek_n(l->input, 1);
 
-	if (next == '/' && next2 == '/') {
-		skip_line_comment(l);
-		return read_next(l);
-	} else if (next == '/' && next2 == '*') {
-		skip_block_comment(l);
-		return read_next(l);
+		if (next == '/' && next2 == '/') skip_line_comment(l);
+		else if (next == '/' && next2 == '*') skip_block_comment(l);
+		else return;
 	}
+}
 
-	if (next == '\n' || next == ';') {
-		char* value = malloc(2);
-		value[0] = input_next(l->input);
-		value[1] = 0;
-		strvec_push(&l->token_data, value);
-		return (TOKEN) { TOKEN_TYPE_SEPARATOR, value };
-	}
-	if (next == '"') return read_string(l);
-	if (next == '\'') return read_char(l);
-	if (is_num(next, next2)) return read_number(l);
-	if (is_identifier(next)) return read_identifier(l);
-	if (is_punc(next)) {
-		char* value = malloc(2);
-		value[0] = input_next(l->input);
-		value[1] = 0;
-		strvec_push(&l->token_data, value);
-		return (TOKEN) { TOKEN_TYPE_PUNC, value };
+TOKEN read_next(LEXER* l) {
+	if (input_eof(l->input)) return TOKEN_NULL;
+
+	const char* value = l->input->ptr;
+	uint8_t cc = char_class(value[0]);
+	uint8_t cc2 = char_class(value[1]);
+
+	switch (cc) {
+	case CC_SEPARATOR:
+		input_next(l->input);
+		return (TOKEN) { .type = TOKEN_TYPE_SEPARATOR, .value = value, .len = 1 };
+	case CC_DOUBLE_QUOTE: return read_string(l);
+	case CC_QUOTE: return read_char(l);
+	case CC_DIGIT: return read_number(l);
+	case CC_LETTER: return read_identifier(l);
+	case CC_DOT:
+		if (cc2 == CC_DIGIT) return read_number(l);
+		// fallthrough
+	case CC_PUNC:
+		input_next(l->input);
+		return (TOKEN) { .type = TOKEN_TYPE_PUNC, .value = value, .len = 1 };
+	case CC_MINUS:
+		if (cc2 == CC_DIGIT) return read_number(l);
+		return read_op(l);
+	case CC_PLUS: case CC_STAR: case CC_SLASH: case CC_PERCENT: case CC_EQUALS:
+	case CC_AMP: case CC_PIPE: case CC_LESS: case CC_GREATER: case CC_BANG:
+		return read_op(l);
 	}
-	if (is_op(next)) return (TOKEN) { TOKEN_TYPE_OP, read_while(l, is_op) };
 
-	lexer_error(l, "Can't handle character '%c'", next);
+	lexer_error(l, "Can't handle character '%c'", value[0]);
 	return TOKEN_NULL;
 }
 
-TOKEN lexer_next(LEXER* l) {
-	/*
-	TOKEN tok = l->current;
-	l->last = tok;
-	l->current = TOKEN_NULL;
-	l->line = l->input->line;
-	l->col = l->input->col;
-	*/
-	//return tok.type != TOKEN_TYPE_NULL ? tok : read_next(l);
-	l->line = l->input->line;
-	l->col = l->input->col;
-	return read_next(l);
-}
+TOKEN_VEC* lexer_tokenize(LEXER* l) {
+	uint8_t subsystem = mem_enter(MEM_LEXER);
+	l->tokens.size = 0;
+	while (true) {
+		skip_ignored(l);
+		l->offset = input_offset(l->input);
 
-TOKEN lexer_peek(LEXER* l) {
-	char* ptr = l->input->ptr;
-	TOKEN tok = read_next(l);
-	input_rewind(l->input, ptr);
-	return tok;
+		TOKEN tok = read_next(l);
+		tok.offset = l->offset;
+		tokvec_push(&l->tokens, tok);
+
+		if (tok.type == TOKEN_TYPE_NULL) break;
+	}
+	mem_leave(subsystem);
+	return &l->tokens;
 }
 
-bool lexer_eof(LEXER* l) {
-	return lexer_peek(l).type == TOKEN_TYPE_NULL;
+bool token_equals(TOKEN* tok, const char* str) {
+	return strncmp(tok->value, str, tok->len) == 0 && str[tok->len] == 0;
 }
 
 void lexer_error(LEXER* l, const char* msg, ...) {
 	va_list args;
 	va_start(args, msg);
-	input_error(l->input, msg, l->line, l->col, args);
+	input_error(l->input, msg, l->offset, args);
 	va_end(args);
 }
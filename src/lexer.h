@@ -1,46 +1,67 @@
-#pragma once
-
-#include <stdlib.h>
-#include <stdio.h>
-#include <stdint.h>
-#include <stdbool.h>
-
-#include "input.h"
-#include "utils.h"
-
-#define TOKEN_NULL (TOKEN) {0}
-
-enum TOKEN_TYPE {
-	TOKEN_TYPE_NULL,
-	TOKEN_TYPE_SEPARATOR,
-	TOKEN_TYPE_INT,
-	TOKEN_TYPE_CHAR,
-	TOKEN_TYPE_FLOAT,
-	TOKEN_TYPE_STRING,
-	TOKEN_TYPE_IDENTIFIER,
-	TOKEN_TYPE_KEYWORD,
-	TOKEN_TYPE_PUNC,
-	TOKEN_TYPE_OP
-};
-
-typedef struct TOKEN_t {
-	uint8_t type;
-	char* value;
-} TOKEN;
-
-typedef struct LEXER_t {
-	INPUTSTREAM* input;
-	//TOKEN current, last;
-	long line, col;
-
-	STRING_VEC token_data;
-} LEXER;
-
-LEXER lexer_new(INPUTSTREAM* input);
-void lexer_delete(LEXER* lexer);
-
-TOKEN lexer_next(LEXER* l);
-TOKEN lexer_peek(LEXER* l);
-bool lexer_eof(LEXER* l);
-
-void lexer_error(LEXER* l, const char* msg, ...);
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "input.h"
+#include "utils.h"
+#include "operators.h"
+
+#define TOKEN_NULL (TOKEN) {0}
+
+enum TOKEN_TYPE {
+	TOKEN_TYPE_NULL,
+	TOKEN_TYPE_SEPARATOR,
+	TOKEN_TYPE_INT,
+	TOKEN_TYPE_CHAR,
+	TOKEN_TYPE_FLOAT,
+	TOKEN_TYPE_STRING,
+	TOKEN_TYPE_IDENTIFIER,
+	TOKEN_TYPE_KEYWORD,
+	TOKEN_TYPE_PUNC,
+	TOKEN_TYPE_OP,
+
+	NUM_TOKEN_TYPES
+};
+
+// value is a view into the input buffer (len chars, not null terminated),
+// except for char and string literals with escape sequences, which are decoded into token_data,
+// and identifiers, which are interned atoms (see intern.h). Keywords stay views into the input,
+// so compare their keyword field and not their value pointer.
+// Operator and keyword tokens are classified once by the lexer, op holds the OP_TYPE and keyword the KEYWORD_ID.
+// offset is the byte offset of the token in the input, line and column are looked up from it when needed.
+typedef struct TOKEN_t {
+	uint8_t type;
+	const char* value;
+	long len;
+	uint32_t offset;
+	uint8_t op;
+	uint8_t keyword;
+} TOKEN;
+
+DECL_DYNAMIC_VECTOR(TOKEN, TOKEN_VEC, tokvec)
+
+typedef struct LEXER_t {
+	INPUTSTREAM* input;
+	uint32_t offset; // start of the current token, for errors
+
+	STRING_VEC token_data;
+	TOKEN_VEC tokens;
+} LEXER;
+
+extern const char* KEYWORDS[];
+
+// Builds the character class table, the keyword table is static
+void lexer_init();
+
+LEXER lexer_new(INPUTSTREAM* input);
+void lexer_delete(LEXER* lexer);
+
+// Lexes the whole input once, the resulting array is terminated by a TOKEN_TYPE_NULL token
+TOKEN_VEC* lexer_tokenize(LEXER* l);
+
+bool token_equals(TOKEN* tok, const char* str);
+
+void lexer_error(LEXER* l, const char* msg, ...);
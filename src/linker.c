@@ -0,0 +1,618 @@
+#include "linker.h"
+
+#include <string.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "file.h"
+#include "intern.h"
+#include "symtab.h"
+
+DEF_DYNAMIC_VECTOR(OBJECT_FILE, OBJECT_VEC, objvec)
+
+// ELF64 structures, declared here so that the linker also builds on hosts without <elf.h>
+
+typedef struct ELF_HEADER_t {
+	uint8_t ident[16];
+	uint16_t type;
+	uint16_t machine;
+	uint32_t version;
+	uint64_t entry;
+	uint64_t phoff;
+	uint64_t shoff;
+	uint32_t flags;
+	uint16_t ehsize;
+	uint16_t phentsize;
+	uint16_t phnum;
+	uint16_t shentsize;
+	uint16_t shnum;
+	uint16_t shstrndx;
+} ELF_HEADER;
+
+typedef struct ELF_SECTION_t {
+	uint32_t name;
+	uint32_t type;
+	uint64_t flags;
+	uint64_t addr;
+	uint64_t offset;
+	uint64_t size;
+	uint32_t link;
+	uint32_t info;
+	uint64_t addralign;
+	uint64_t entsize;
+} ELF_SECTION;
+
+typedef struct ELF_SYMBOL_t {
+	uint32_t name;
+	uint8_t info;
+	uint8_t other;
+	uint16_t shndx;
+	uint64_t value;
+	uint64_t size;
+} ELF_SYMBOL;
+
+typedef struct ELF_RELA_t {
+	uint64_t offset;
+	uint64_t info;
+	int64_t addend;
+} ELF_RELA;
+
+typedef struct ELF_SEGMENT_t {
+	uint32_t type;
+	uint32_t flags;
+	uint64_t offset;
+	uint64_t vaddr;
+	uint64_t paddr;
+	uint64_t filesz;
+	uint64_t memsz;
+	uint64_t align;
+} ELF_SEGMENT;
+
+typedef struct ELF_DYNAMIC_t {
+	int64_t tag;
+	uint64_t value;
+} ELF_DYNAMIC;
+
+enum ELF_CONSTANTS {
+	ET_REL = 1,
+	ET_EXEC = 2,
+	ET_DYN = 3,
+	EM_X86_64 = 62,
+
+	SHT_PROGBITS = 1,
+	SHT_SYMTAB = 2,
+	SHT_RELA = 4,
+	SHT_NOTE = 7,
+	SHT_NOBITS = 8,
+	SHT_DYNSYM = 11,
+	SHT_X86_64_UNWIND = 0x70000001,
+	SHF_WRITE = 1,
+	SHF_ALLOC = 2,
+	SHF_EXECINSTR = 4,
+	SHF_TLS = 0x400,
+	SHN_UNDEF = 0,
+	SHN_ABS = 0xfff1,
+	SHN_COMMON = 0xfff2,
+
+	STB_LOCAL = 0,
+	STB_GLOBAL = 1,
+	STB_WEAK = 2,
+	STT_FUNC = 2,
+
+	PT_LOAD = 1,
+	PT_DYNAMIC = 2,
+	PT_INTERP = 3,
+	PT_PHDR = 6,
+	PT_GNU_STACK = 0x6474e551,
+	PF_X = 1,
+	PF_W = 2,
+	PF_R = 4,
+
+	DT_NULL = 0,
+	DT_NEEDED = 1,
+	DT_HASH = 4,
+	DT_STRTAB = 5,
+	DT_SYMTAB = 6,
+	DT_RELA = 7,
+	DT_RELASZ = 8,
+	DT_RELAENT = 9,
+	DT_STRSZ = 10,
+	DT_SYMENT = 11,
+	DT_DEBUG = 21,
+	DT_FLAGS = 30,
+	DF_BIND_NOW = 8,
+
+	R_X86_64_NONE = 0,
+	R_X86_64_64 = 1,
+	R_X86_64_PC32 = 2,
+	R_X86_64_PLT32 = 4,
+	R_X86_64_GLOB_DAT = 6,
+	R_X86_64_GOTPCREL = 9,
+	R_X86_64_32 = 10,
+	R_X86_64_32S = 11,
+	R_X86_64_PC64 = 24,
+	R_X86_64_GOTPCRELX = 41,
+	R_X86_64_REX_GOTPCRELX = 42,
+};
+
+#define NUM_SEGMENTS 7
+#define PLT_ENTRY_SIZE 8
+
+// Output sections, every input section is appended to the one matching its flags
+enum OUTPUT_KIND {
+	OUTPUT_RODATA,
+	OUTPUT_TEXT,
+	OUTPUT_DATA,
+	OUTPUT_BSS,
+
+	NUM_OUTPUT_KINDS,
+	OUTPUT_NONE = 0xff
+};
+
+typedef struct INPUT_OBJECT_t {
+	const char* name;
+	const uint8_t* data;
+	ELF_SECTION* sections;
+	uint32_t num_sections;
+	ELF_SYMBOL* symbols;
+	uint32_t num_symbols;
+	const char* strings; // names of the symbols
+
+	uint8_t* section_kinds; // OUTPUT_KIND of every section
+	uint64_t* section_addresses; // offset in the output section until the layout is done
+	uint32_t* symbol_ids; // 1 + index in LINKER.symbols of every global symbol
+} INPUT_OBJECT;
+
+typedef struct LINK_SYMBOL_t {
+	char* name; // atom
+	uint32_t object; // of the definition
+	uint32_t symbol;
+	bool defined;
+	bool weak; // defined weak, or only referenced weakly if undefined
+	uint32_t import; // 1 + index in the dynamic symbol table for symbols imported from libc
+	uint32_t got; // 1 + GOT slot
+	uint64_t address;
+} LINK_SYMBOL;
+
+DECL_DYNAMIC_VECTOR(LINK_SYMBOL, LINK_SYMBOL_VEC, lsymvec)
+DEF_DYNAMIC_VECTOR(LINK_SYMBOL, LINK_SYMBOL_VEC, lsymvec)
+
+typedef struct LINKER_t {
+	INPUT_OBJECT* objects;
+	long num_objects;
+	LINK_SYMBOL_VEC symbols;
+	SYMBOL_TABLE index; // name -> 1 + index in symbols
+	uint32_t num_imports;
+	uint32_t num_got;
+
+	uint64_t output_sizes[NUM_OUTPUT_KINDS];
+	uint64_t output_aligns[NUM_OUTPUT_KINDS];
+	uint64_t output_addresses[NUM_OUTPUT_KINDS];
+	uint64_t plt_address;
+	uint64_t got_address;
+} LINKER;
+
+uint64_t align_up(uint64_t value, uint64_t align) {
+	return align > 1 ? (value + align - 1) & ~(align - 1) : value;
+}
+
+bool read_object(INPUT_OBJECT* obj, OBJECT_FILE* file) {
+	obj->name = file->name;
+	obj->data = (const uint8_t*)LLVMGetBufferStart(file->buffer);
+	size_t size = LLVMGetBufferSize(file->buffer);
+	ELF_HEADER* header = (ELF_HEADER*)obj->data;
+	if (size < sizeof(ELF_HEADER) || memcmp(header->ident, "\x7f" "ELF", 4) != 0 || header->ident[4] != 2 || header->ident[5] != 1
+		|| header->type != ET_REL || header->machine != EM_X86_64 || header->shoff + (uint64_t)header->shnum * sizeof(ELF_SECTION) > size) {
+		printf("%s: not an x86-64 ELF object\n", obj->name);
+		return false;
+	}
+	obj->sections = (ELF_SECTION*)(obj->data + header->shoff);
+	obj->num_sections = header->shnum;
+	obj->section_kinds = mem_alloc(max(obj->num_sections, 1));
+	obj->section_addresses = mem_calloc(max(obj->num_sections, 1), sizeof(uint64_t));
+	obj->symbols = NULL;
+	obj->num_symbols = 0;
+	obj->strings = NULL;
+	for (uint32_t i = 0; i < obj->num_sections; i++) {
+		ELF_SECTION* section = &obj->sections[i];
+		obj->section_kinds[i] = OUTPUT_NONE;
+		if (section->type == SHT_SYMTAB) {
+			obj->symbols = (ELF_SYMBOL*)(obj->data + section->offset);
+			obj->num_symbols = (uint32_t)(section->size / sizeof(ELF_SYMBOL));
+			obj->strings = (const char*)obj->data + obj->sections[section->link].offset;
+		}
+		if (!(section->flags & SHF_ALLOC)) continue;
+		if (section->flags & SHF_TLS || (section->type != SHT_PROGBITS && section->type != SHT_NOBITS && section->type != SHT_NOTE && section->type != SHT_X86_64_UNWIND)) {
+			printf("%s: section type %u is not supported\n", obj->name, section->type);
+			return false;
+		}
+		if (section->type == SHT_NOBITS) obj->section_kinds[i] = OUTPUT_BSS;
+		else if (section->flags & SHF_EXECINSTR) obj->section_kinds[i] = OUTPUT_TEXT;
+		else if (section->flags & SHF_WRITE) obj->section_kinds[i] = OUTPUT_DATA;
+		else obj->section_kinds[i] = OUTPUT_RODATA;
+	}
+	obj->symbol_ids = mem_calloc(max(obj->num_symbols, 1), sizeof(uint32_t));
+	return true;
+}
+
+// Enters the global symbols of an object into the symbol table, a strong definition replaces a weak one
+bool add_symbols(LINKER* l, uint32_t object) {
+	INPUT_OBJECT* obj = &l->objects[object];
+	for (uint32_t i = 1; i < obj->num_symbols; i++) {
+		ELF_SYMBOL* sym = &obj->symbols[i];
+		uint8_t binding = sym->info >> 4;
+		if (binding == STB_LOCAL) continue;
+		if (sym->shndx == SHN_COMMON) {
+			printf("%s: common symbol '%s' is not supported\n", obj->name, obj->strings + sym->name);
+			return false;
+		}
+		char* name = intern_str(obj->strings + sym->name);
+		uint32_t id = symtab_get(&l->index, name);
+		if (!id) {
+			lsymvec_push(&l->symbols, (LINK_SYMBOL){ name, 0, 0, false, true, 0, 0, 0 });
+			id = (uint32_t)l->symbols.size;
+			symtab_put(&l->index, name, id);
+		}
+		obj->symbol_ids[i] = id;
+		LINK_SYMBOL* symbol = &l->symbols.buffer[id - 1];
+		bool weak = binding == STB_WEAK;
+		if (sym->shndx == SHN_UNDEF) {
+			if (!symbol->defined) symbol->weak &= weak;
+			continue;
+		}
+		if (symbol->defined && !symbol->weak && !weak) {
+			printf("Symbol '%s' is defined in %s and %s\n", name, l->objects[symbol->object].name, obj->name);
+			return false;
+		}
+		if (!symbol->defined || (symbol->weak && !weak)) {
+			symbol->defined = true;
+			symbol->weak = weak;
+			symbol->object = object;
+			symbol->symbol = i;
+		}
+	}
+	return true;
+}
+
+// Places every allocated input section at an offset in its output section
+void assign_offsets(LINKER* l) {
+	for (int k = 0; k < NUM_OUTPUT_KINDS; k++) {
+		l->output_sizes[k] = 0;
+		l->output_aligns[k] = 1;
+	}
+	for (long o = 0; o < l->num_objects; o++) {
+		INPUT_OBJECT* obj = &l->objects[o];
+		for (uint32_t i = 0; i < obj->num_sections; i++) {
+			uint8_t kind = obj->section_kinds[i];
+			if (kind == OUTPUT_NONE) continue;
+			uint64_t align = max(obj->sections[i].addralign, 1);
+			l->output_sizes[kind] = align_up(l->output_sizes[kind], align);
+			l->output_aligns[kind] = max(l->output_aligns[kind], align);
+			obj->section_addresses[i] = l->output_sizes[kind];
+			l->output_sizes[kind] += obj->sections[i].size;
+		}
+	}
+}
+
+bool is_got_relocation(uint32_t type) {
+	return type == R_X86_64_GOTPCREL || type == R_X86_64_GOTPCRELX || type == R_X86_64_REX_GOTPCRELX;
+}
+
+// Undefined symbols are imported, they and the symbols that code loads from the GOT get a GOT slot
+bool assign_got_slots(LINKER* l) {
+	for (long i = 0; i < l->symbols.size; i++) {
+		LINK_SYMBOL* symbol = &l->symbols.buffer[i];
+		if (symbol->defined) continue;
+		symbol->import = ++l->num_imports;
+		symbol->got = ++l->num_got;
+	}
+	for (long o = 0; o < l->num_objects; o++) {
+		INPUT_OBJECT* obj = &l->objects[o];
+		for (uint32_t s = 0; s < obj->num_sections; s++) {
+			ELF_SECTION* section = &obj->sections[s];
+			if (section->type != SHT_RELA || obj->section_kinds[section->info] == OUTPUT_NONE) continue;
+			ELF_RELA* relas = (ELF_RELA*)(obj->data + section->offset);
+			for (uint64_t r = 0; r < section->size / sizeof(ELF_RELA); r++) {
+				if (!is_got_relocation((uint32_t)relas[r].info)) continue;
+				uint32_t id = obj->symbol_ids[relas[r].info >> 32];
+				if (!id) {
+					printf("%s: GOT relocation against a local symbol is not supported\n", obj->name);
+					return false;
+				}
+				if (!l->symbols.buffer[id - 1].got) l->symbols.buffer[id - 1].got = ++l->num_got;
+			}
+		}
+	}
+	return true;
+}
+
+// Address of a symbol as defined by obj
+uint64_t defined_address(INPUT_OBJECT* obj, uint32_t index) {
+	ELF_SYMBOL* sym = &obj->symbols[index];
+	if (sym->shndx == SHN_UNDEF) return 0;
+	if (sym->shndx == SHN_ABS) return sym->value;
+	return obj->section_addresses[sym->shndx] + sym->value;
+}
+
+// Whether libc's dynamic symbol table defines name
+bool libc_defines(SOURCE_FILE* libc, ELF_SECTION* dynsym, char* name) {
+	ELF_SYMBOL* symbols = (ELF_SYMBOL*)(libc->data + dynsym->offset);
+	ELF_SECTION* sections = (ELF_SECTION*)(libc->data + ((ELF_HEADER*)libc->data)->shoff);
+	const char* strings = libc->data + sections[dynsym->link].offset;
+	for (uint64_t i = 1; i < dynsym->size / sizeof(ELF_SYMBOL); i++) {
+		if (symbols[i].shndx != SHN_UNDEF && strcmp(strings + symbols[i].name, name) == 0) return true;
+	}
+	return false;
+}
+
+// Reports the imports libc does not define, weak ones may stay undefined
+bool check_imports(LINKER* l) {
+	static const char* LIBC_PATHS[] = LINKER_LIBC_PATHS;
+	SOURCE_FILE libc;
+	size_t path = 0;
+	while (path < sizeof(LIBC_PATHS) / sizeof(char*) && !load_file(LIBC_PATHS[path], &libc)) path++;
+	if (path == sizeof(LIBC_PATHS) / sizeof(char*)) return true; // not a glibc system, the dynamic linker checks when the program starts
+
+	ELF_HEADER* header = (ELF_HEADER*)libc.data;
+	ELF_SECTION* dynsym = NULL;
+	if (libc.size >= sizeof(ELF_HEADER) && header->type == ET_DYN && header->shoff + (uint64_t)header->shnum * sizeof(ELF_SECTION) <= libc.size) {
+		ELF_SECTION* sections = (ELF_SECTION*)(libc.data + header->shoff);
+		for (uint32_t i = 0; i < header->shnum && !dynsym; i++) if (sections[i].type == SHT_DYNSYM) dynsym = &sections[i];
+	}
+	bool ok = true;
+	for (long i = 0; i < l->symbols.size && dynsym; i++) {
+		LINK_SYMBOL* symbol = &l->symbols.buffer[i];
+		if (symbol->defined || symbol->weak || libc_defines(&libc, dynsym, symbol->name)) continue;
+		printf("Undefined symbol '%s'\n", symbol->name);
+		ok = false;
+	}
+	unload_file(&libc);
+	return ok;
+}
+
+// Address a reference from obj resolves to
+uint64_t symbol_address(LINKER* l, INPUT_OBJECT* obj, uint32_t index) {
+	if (obj->symbol_ids[index]) return l->symbols.buffer[obj->symbol_ids[index] - 1].address;
+	return defined_address(obj, index);
+}
+
+bool apply_relocations(LINKER* l, uint8_t* image) {
+	for (long o = 0; o < l->num_objects; o++) {
+		INPUT_OBJECT* obj = &l->objects[o];
+		for (uint32_t s = 0; s < obj->num_sections; s++) {
+			ELF_SECTION* section = &obj->sections[s];
+			if (section->type != SHT_RELA || obj->section_kinds[section->info] == OUTPUT_NONE) continue;
+			uint64_t target = obj->section_addresses[section->info];
+			ELF_RELA* relas = (ELF_RELA*)(obj->data + section->offset);
+			for (uint64_t r = 0; r < section->size / sizeof(ELF_RELA); r++) {
+				ELF_RELA* rela = &relas[r];
+				uint32_t type = (uint32_t)rela->info;
+				uint32_t index = (uint32_t)(rela->info >> 32);
+				uint64_t place = target + rela->offset;
+				uint8_t* dest = image + (place - LINKER_BASE_ADDRESS);
+				uint64_t value = symbol_address(l, obj, index) + rela->addend;
+				if (is_got_relocation(type)) {
+					value = l->got_address + (l->symbols.buffer[obj->symbol_ids[index] - 1].got - 1) * 8 + rela->addend;
+				}
+				switch (type) {
+				case R_X86_64_NONE: continue;
+				case R_X86_64_64: memcpy(dest, &value, 8); continue;
+				case R_X86_64_PC64: value -= place; memcpy(dest, &value, 8); continue;
+				case R_X86_64_PC32:
+				case R_X86_64_PLT32:
+				case R_X86_64_GOTPCREL:
+				case R_X86_64_GOTPCRELX:
+				case R_X86_64_REX_GOTPCRELX:
+					value -= place;
+					// The result is a signed 32 bit value as well
+					/* fallthrough */
+				case R_X86_64_32S:
+					if ((int64_t)value != (int32_t)value) break;
+					memcpy(dest, &value, 4);
+					continue;
+				case R_X86_64_32:
+					if (value > UINT32_MAX) break;
+					memcpy(dest, &value, 4);
+					continue;
+				default:
+					printf("%s: relocation type %u is not supported\n", obj->name, type);
+					return false;
+				}
+				printf("%s: relocation type %u against '%s' is out of range\n", obj->name, type, obj->strings + obj->symbols[index].name);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool write_executable(const char* output_path, uint8_t* image, uint64_t size) {
+	FILE* file = fopen(output_path, "wb");
+	if (!file) {
+		printf("Can't write '%s'\n", output_path);
+		return false;
+	}
+	bool written = fwrite(image, 1, size, file) == size;
+	written &= fclose(file) == 0;
+	if (!written) printf("Can't write '%s'\n", output_path);
+#ifndef _WIN32
+	chmod(output_path, 0755);
+#endif
+	return written;
+}
+
+void push_bytes(DYNAMIC_STRING* str, const void* data, long size) {
+	if (str->capacity - str->size < size) string_resize(str, str->capacity * 2 + size);
+	memcpy(str->buffer + str->size, data, size);
+	str->size += size;
+}
+
+bool elf_link(OBJECT_FILE* objects, long num_objects, const char* entry, const char* output_path) {
+	uint8_t subsystem = mem_enter(MEM_LINKER);
+	LINKER l;
+	l.objects = mem_calloc(max(num_objects, 1), sizeof(INPUT_OBJECT));
+	l.num_objects = 0;
+	l.symbols = lsymvec_new(64);
+	l.index = symtab_new(128);
+	l.num_imports = 0;
+	l.num_got = 0;
+	uint8_t* image = NULL;
+	DYNAMIC_STRING dynstr = string_new(64);
+	bool ok = true;
+
+	for (long i = 0; i < num_objects && ok; i++) {
+		ok = read_object(&l.objects[i], &objects[i]);
+		l.num_objects = i + 1;
+		if (ok) ok = add_symbols(&l, (uint32_t)i);
+	}
+	if (ok) ok = check_imports(&l) && assign_got_slots(&l);
+	if (!ok) goto done;
+	assign_offsets(&l);
+
+	// Dynamic string and symbol tables: libc, then the imported names
+	string_push(&dynstr, 0);
+	uint64_t libc_name = dynstr.size;
+	string_push_s(&dynstr, LINKER_LIBC);
+	string_push(&dynstr, 0);
+	uint32_t num_dynsyms = 1 + l.num_imports;
+	ELF_SYMBOL* dynsyms = mem_calloc(num_dynsyms, sizeof(ELF_SYMBOL));
+	for (long i = 0; i < l.symbols.size; i++) {
+		LINK_SYMBOL* symbol = &l.symbols.buffer[i];
+		if (!symbol->import) continue;
+		dynsyms[symbol->import] = (ELF_SYMBOL){ (uint32_t)dynstr.size, (uint8_t)((symbol->weak ? STB_WEAK : STB_GLOBAL) << 4 | STT_FUNC), 0, SHN_UNDEF, 0, 0 };
+		push_bytes(&dynstr, symbol->name, intern_len(symbol->name) + 1);
+	}
+
+	// Read only segment: headers, dynamic linking tables, read only data
+	uint64_t interp_offset = sizeof(ELF_HEADER) + NUM_SEGMENTS * sizeof(ELF_SEGMENT);
+	uint64_t hash_offset = align_up(interp_offset + sizeof(LINKER_INTERPRETER), 8);
+	uint64_t hash_size = (2 + 1 + num_dynsyms) * sizeof(uint32_t);
+	uint64_t dynsym_offset = align_up(hash_offset + hash_size, 8);
+	uint64_t dynstr_offset = dynsym_offset + num_dynsyms * sizeof(ELF_SYMBOL);
+	uint64_t rela_offset = align_up(dynstr_offset + dynstr.size, 8);
+	uint64_t rela_size = l.num_imports * sizeof(ELF_RELA);
+	uint64_t rodata_offset = align_up(rela_offset + rela_size, l.output_aligns[OUTPUT_RODATA]);
+	uint64_t rodata_end = rodata_offset + l.output_sizes[OUTPUT_RODATA];
+	// Executable segment: code, PLT stubs
+	uint64_t text_offset = align_up(rodata_end, LINKER_PAGE_SIZE);
+	uint64_t plt_offset = align_up(text_offset + l.output_sizes[OUTPUT_TEXT], 16);
+	uint64_t text_end = plt_offset + l.num_imports * PLT_ENTRY_SIZE;
+	// Writable segment: dynamic section, GOT, data, zero initialized data
+	ELF_DYNAMIC dynamic[] = {
+		{ DT_NEEDED, libc_name },
+		{ DT_HASH, LINKER_BASE_ADDRESS + hash_offset },
+		{ DT_STRTAB, LINKER_BASE_ADDRESS + dynstr_offset },
+		{ DT_SYMTAB, LINKER_BASE_ADDRESS + dynsym_offset },
+		{ DT_STRSZ, dynstr.size },
+		{ DT_SYMENT, sizeof(ELF_SYMBOL) },
+		{ DT_RELA, LINKER_BASE_ADDRESS + rela_offset },
+		{ DT_RELASZ, rela_size },
+		{ DT_RELAENT, sizeof(ELF_RELA) },
+		{ DT_FLAGS, DF_BIND_NOW },
+		{ DT_DEBUG, 0 },
+		{ DT_NULL, 0 },
+	};
+	uint64_t dynamic_offset = align_up(text_end, LINKER_PAGE_SIZE);
+	uint64_t got_offset = dynamic_offset + sizeof(dynamic);
+	uint64_t data_offset = align_up(got_offset + l.num_got * 8, l.output_aligns[OUTPUT_DATA]);
+	uint64_t data_end = data_offset + l.output_sizes[OUTPUT_DATA];
+	uint64_t bss_offset = align_up(data_end, l.output_aligns[OUTPUT_BSS]);
+	uint64_t bss_end = bss_offset + l.output_sizes[OUTPUT_BSS];
+
+	uint64_t output_offsets[NUM_OUTPUT_KINDS] = { rodata_offset, text_offset, data_offset, bss_offset };
+	for (int k = 0; k < NUM_OUTPUT_KINDS; k++) l.output_addresses[k] = LINKER_BASE_ADDRESS + output_offsets[k];
+	l.plt_address = LINKER_BASE_ADDRESS + plt_offset;
+	l.got_address = LINKER_BASE_ADDRESS + got_offset;
+
+	for (long o = 0; o < l.num_objects; o++) {
+		INPUT_OBJECT* obj = &l.objects[o];
+		for (uint32_t i = 0; i < obj->num_sections; i++) {
+			if (obj->section_kinds[i] != OUTPUT_NONE) obj->section_addresses[i] += l.output_addresses[obj->section_kinds[i]];
+		}
+	}
+	// Imported functions are called and addressed through their PLT stub
+	for (long i = 0; i < l.symbols.size; i++) {
+		LINK_SYMBOL* symbol = &l.symbols.buffer[i];
+		if (symbol->import) symbol->address = l.plt_address + (symbol->import - 1) * PLT_ENTRY_SIZE;
+		else symbol->address = defined_address(&l.objects[symbol->object], symbol->symbol);
+	}
+	uint32_t entry_id = symtab_get(&l.index, intern_str(entry));
+	if (!entry_id || !l.symbols.buffer[entry_id - 1].defined) {
+		printf("Entry point '%s' is not defined\n", entry);
+		mem_free(dynsyms);
+		ok = false;
+		goto done;
+	}
+
+	image = mem_calloc(data_end, 1);
+	ELF_HEADER header = { { 0x7f, 'E', 'L', 'F', 2, 1, 1 }, ET_EXEC, EM_X86_64, 1, l.symbols.buffer[entry_id - 1].address,
+		sizeof(ELF_HEADER), 0, 0, sizeof(ELF_HEADER), sizeof(ELF_SEGMENT), NUM_SEGMENTS, sizeof(ELF_SECTION), 0, 0 };
+	ELF_SEGMENT segments[NUM_SEGMENTS] = {
+		{ PT_PHDR, PF_R, sizeof(ELF_HEADER), LINKER_BASE_ADDRESS + sizeof(ELF_HEADER), 0, NUM_SEGMENTS * sizeof(ELF_SEGMENT), NUM_SEGMENTS * sizeof(ELF_SEGMENT), 8 },
+		{ PT_INTERP, PF_R, interp_offset, LINKER_BASE_ADDRESS + interp_offset, 0, sizeof(LINKER_INTERPRETER), sizeof(LINKER_INTERPRETER), 1 },
+		{ PT_LOAD, PF_R, 0, LINKER_BASE_ADDRESS, 0, rodata_end, rodata_end, LINKER_PAGE_SIZE },
+		{ PT_LOAD, PF_R | PF_X, text_offset, LINKER_BASE_ADDRESS + text_offset, 0, text_end - text_offset, text_end - text_offset, LINKER_PAGE_SIZE },
+		{ PT_LOAD, PF_R | PF_W, dynamic_offset, LINKER_BASE_ADDRESS + dynamic_offset, 0, data_end - dynamic_offset, bss_end - dynamic_offset, LINKER_PAGE_SIZE },
+		{ PT_DYNAMIC, PF_R | PF_W, dynamic_offset, LINKER_BASE_ADDRESS + dynamic_offset, 0, sizeof(dynamic), sizeof(dynamic), 8 },
+		{ PT_GNU_STACK, PF_R | PF_W, 0, 0, 0, 0, 0, 16 },
+	};
+	for (int i = 0; i < NUM_SEGMENTS; i++) segments[i].paddr = segments[i].vaddr;
+	memcpy(image, &header, sizeof(header));
+	memcpy(image + sizeof(header), segments, sizeof(segments));
+	memcpy(image + interp_offset, LINKER_INTERPRETER, sizeof(LINKER_INTERPRETER));
+
+	// One hash chain through all dynamic symbols, nothing looks symbols up in the executable
+	uint32_t* hash = (uint32_t*)(image + hash_offset);
+	hash[0] = 1;
+	hash[1] = num_dynsyms;
+	hash[2] = num_dynsyms - 1;
+	for (uint32_t i = 1; i < num_dynsyms; i++) hash[3 + i] = i - 1;
+	memcpy(image + dynsym_offset, dynsyms, num_dynsyms * sizeof(ELF_SYMBOL));
+	mem_free(dynsyms);
+	memcpy(image + dynstr_offset, dynstr.buffer, dynstr.size);
+	memcpy(image + dynamic_offset, dynamic, sizeof(dynamic));
+
+	for (long i = 0; i < l.symbols.size; i++) {
+		LINK_SYMBOL* symbol = &l.symbols.buffer[i];
+		if (!symbol->got) continue;
+		uint64_t slot = l.got_address + (symbol->got - 1) * 8;
+		if (symbol->import) {
+			// ld.so fills the slot, the stub jumps through it: jmp *slot(%rip), 2 byte nop
+			ELF_RELA rela = { slot, (uint64_t)symbol->import << 32 | R_X86_64_GLOB_DAT, 0 };
+			memcpy(image + rela_offset + (symbol->import - 1) * sizeof(ELF_RELA), &rela, sizeof(rela));
+			uint64_t stub = symbol->address;
+			int32_t displacement = (int32_t)(slot - (stub + 6));
+			uint8_t* code = image + (stub - LINKER_BASE_ADDRESS);
+			code[0] = 0xff;
+			code[1] = 0x25;
+			memcpy(code + 2, &displacement, 4);
+			code[6] = 0x66;
+			code[7] = 0x90;
+		} else memcpy(image + (slot - LINKER_BASE_ADDRESS), &symbol->address, 8);
+	}
+
+	for (long o = 0; o < l.num_objects; o++) {
+		INPUT_OBJECT* obj = &l.objects[o];
+		for (uint32_t i = 0; i < obj->num_sections; i++) {
+			uint8_t kind = obj->section_kinds[i];
+			if (kind == OUTPUT_NONE || kind == OUTPUT_BSS) continue;
+			memcpy(image + (obj->section_addresses[i] - LINKER_BASE_ADDRESS), obj->data + obj->sections[i].offset, obj->sections[i].size);
+		}
+	}
+	ok = apply_relocations(&l, image) && write_executable(output_path, image, data_end);
+
+done:
+	for (long i = 0; i < l.num_objects; i++) {
+		mem_free(l.objects[i].section_kinds);
+		mem_free(l.objects[i].section_addresses);
+		mem_free(l.objects[i].symbol_ids);
+	}
+	mem_free(l.objects);
+	mem_free(image);
+	string_delete(&dynstr);
+	lsymvec_delete(&l.symbols);
+	symtab_delete(&l.index);
+	mem_leave(subsystem);
+	return ok;
+}
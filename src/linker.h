@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <llvm-c/Core.h>
+
+#include "utils.h"
+
+// Built-in linker for x86-64 Linux: links the ELF relocatable objects LLVM emits into memory into a dynamically
+// linked, non position independent executable. Symbols no object defines are imported from libc through the GOT,
+// calls to them go through PLT stubs. Sections are only merged by their access rights (read only, executable,
+// writable, zero initialized), which is all the code generator produces; COMDAT groups, TLS and copy relocations
+// are not supported.
+
+#define LINKER_BASE_ADDRESS 0x400000
+#define LINKER_PAGE_SIZE 0x1000
+#define LINKER_INTERPRETER "/lib64/ld-linux-x86-64.so.2"
+#define LINKER_LIBC "libc.so.6"
+// Where the imports are looked up, so that undefined symbols are reported when linking instead of when the program starts
+#define LINKER_LIBC_PATHS { "/lib/x86_64-linux-gnu/libc.so.6", "/usr/lib/x86_64-linux-gnu/libc.so.6", "/lib64/libc.so.6", "/usr/lib64/libc.so.6" }
+
+typedef struct OBJECT_FILE_t {
+	char* name; // for diagnostics and for linkers that need files
+	LLVMMemoryBufferRef buffer;
+} OBJECT_FILE;
+
+DECL_DYNAMIC_VECTOR(OBJECT_FILE, OBJECT_VEC, objvec)
+
+// Writes the executable to output_path with entry as its entry point, prints the reason and returns false on errors
+bool elf_link(OBJECT_FILE* objects, long num_objects, const char* entry, const char* output_path);
@@ -0,0 +1,34 @@
+#include "operators.h"
+
+const OPERATOR OPERATORS[NUM_OPS] = {
+	[OP_NONE] = { "", -1, OP_ASSOC_LEFT, OP_NONE, false, false },
+
+	[OP_ASSIGN] = { "=", 1, OP_ASSOC_RIGHT, OP_NONE, true, false },
+	[OP_ADD_ASSIGN] = { "+=", 1, OP_ASSOC_RIGHT, OP_ADD, true, false },
+	[OP_SUB_ASSIGN] = { "-=", 1, OP_ASSOC_RIGHT, OP_SUB, true, false },
+	[OP_MUL_ASSIGN] = { "*=", 1, OP_ASSOC_RIGHT, OP_MUL, true, false },
+	[OP_DIV_ASSIGN] = { "/=", 1, OP_ASSOC_RIGHT, OP_DIV, true, false },
+	[OP_MOD_ASSIGN] = { "%=", 1, OP_ASSOC_RIGHT, OP_MOD, true, false },
+
+	[OP_OR] = { "||", 2, OP_ASSOC_LEFT, OP_NONE, false, false },
+	[OP_AND] = { "&&", 3, OP_ASSOC_LEFT, OP_NONE, false, false },
+
+	[OP_LT] = { "<", 7, OP_ASSOC_LEFT, OP_NONE, false, false },
+	[OP_GT] = { ">", 7, OP_ASSOC_LEFT, OP_NONE, false, false },
+	[OP_LE] = { "<=", 7, OP_ASSOC_LEFT, OP_NONE, false, false },
+	[OP_GE] = { ">=", 7, OP_ASSOC_LEFT, OP_NONE, false, false },
+	[OP_EQ] = { "==", 7, OP_ASSOC_LEFT, OP_NONE, false, false },
+	[OP_NE] = { "!=", 7, OP_ASSOC_LEFT, OP_NONE, false, false },
+
+	[OP_ADD] = { "+", 10, OP_ASSOC_LEFT, OP_NONE, false, true },
+	[OP_SUB] = { "-", 10, OP_ASSOC_LEFT, OP_NONE, false, true },
+	[OP_MUL] = { "*", 20, OP_ASSOC_LEFT, OP_NONE, false, true },
+	[OP_DIV] = { "/", 20, OP_ASSOC_LEFT, OP_NONE, false, false },
+	[OP_MOD] = { "%", 20, OP_ASSOC_LEFT, OP_NONE, false, false },
+
+	[OP_INC] = { "++", -1, OP_ASSOC_LEFT, OP_NONE, false, true },
+	[OP_DEC] = { "--", -1, OP_ASSOC_LEFT, OP_NONE, false, true },
+	[OP_NOT] = { "!", -1, OP_ASSOC_LEFT, OP_NONE, false, false },
+	[OP_BIT_AND] = { "&", -1, OP_ASSOC_LEFT, OP_NONE, false, false },
+	[OP_BIT_OR] = { "|", -1, OP_ASSOC_LEFT, OP_NONE, false, false },
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum OP_TYPE {
+	OP_NONE,
+
+	OP_ASSIGN,
+	OP_ADD_ASSIGN,
+	OP_SUB_ASSIGN,
+	OP_MUL_ASSIGN,
+	OP_DIV_ASSIGN,
+	OP_MOD_ASSIGN,
+
+	OP_OR,
+	OP_AND,
+
+	OP_LT,
+	OP_GT,
+	OP_LE,
+	OP_GE,
+	OP_EQ,
+	OP_NE,
+
+	OP_ADD,
+	OP_SUB,
+	OP_MUL,
+	OP_DIV,
+	OP_MOD,
+
+	OP_INC,
+	OP_DEC,
+	OP_NOT,
+	OP_BIT_AND,
+	OP_BIT_OR,
+
+	NUM_OPS
+};
+
+enum OP_ASSOC {
+	OP_ASSOC_LEFT,
+	OP_ASSOC_RIGHT
+};
+
+typedef struct OPERATOR_t {
+	const char* str;
+	int8_t precedence; // -1 if the operator can't be used as a binary operator
+	uint8_t assoc;
+	uint8_t assign_op; // binary operator applied by a compound assignment
+	bool assign;
+	bool prefix;
+} OPERATOR;
+
+extern const OPERATOR OPERATORS[NUM_OPS];
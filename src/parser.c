@@ -1,45 +1,82 @@
 #include "parser.h"
 
 #include <string.h>
+#include <stdarg.h>
 
 #include "utils.h"
 #include "keywords.h"
+#include "intern.h"
+#include "operators.h"
+#include "stack.h"
 
-const char* OP_MAP_K[] = { "=", "+=", "-=", "*=", "/=", "%=", "||", "&&", "<", ">", "<=", ">=", "==", "!=", "+", "-", "*", "/", "%" };
-const int OP_MAP_V[] = { 1, 1, 1, 1, 1, 1, 2, 3, 7, 7, 7, 7, 7, 7, 10, 10, 20, 20, 20 };
-const int NUM_OPS = 19;
+DEF_DYNAMIC_VECTOR(OPERATOR_FRAME, OPERATOR_FRAME_VEC, opfvec)
 
-PARSER parser_new(LEXER* lexer) {
+PARSER parser_new(LEXER* lexer, ARENA* arena) {
 	PARSER p;
 	p.input = lexer;
+	p.arena = arena;
+	uint8_t subsystem = mem_enter(MEM_PARSER);
+	p.node_stack = nodevec_new(64);
+	p.op_stack = opfvec_new(32);
+	p.arg_stack = vdvec_new(8);
+	mem_leave(subsystem);
+	if (lexer->tokens.size == 0) lexer_tokenize(lexer);
+	p.tokens = lexer->tokens.buffer;
+	p.pos = 0;
 	return p;
 }
 
 void parser_delete(PARSER* parser) {
+	nodevec_delete(&parser->node_stack);
+	opfvec_delete(&parser->op_stack);
+	vdvec_delete(&parser->arg_stack);
+}
+
+void parser_error(PARSER* p, const char* msg, ...) {
+	TOKEN tok = p->tokens[p->pos];
+	va_list args;
+	va_start(args, msg);
+	input_error(p->input->input, msg, tok.offset, args);
+	va_end(args);
+}
+
+TOKEN parser_peek(PARSER* p) {
+	return p->tokens[p->pos];
+}
+
+TOKEN parser_next(PARSER* p) {
+	TOKEN tok = p->tokens[p->pos];
+	if (tok.type != TOKEN_TYPE_NULL) p->pos++;
+	return tok;
+}
+
+bool parser_eof(PARSER* p) {
+	return p->tokens[p->pos].type == TOKEN_TYPE_NULL;
 }
 
 void skip_separator(PARSER* p) {
-	if (lexer_peek(p->input).type == TOKEN_TYPE_SEPARATOR) lexer_next(p->input);
-	else lexer_error(p->input, "SEPARATOR expected");
+	if (parser_peek(p).type == TOKEN_TYPE_SEPARATOR) parser_next(p);
+	else parser_error(p, "SEPARATOR expected");
 }
 
 void skip_all_separators(PARSER* p) {
-	while (!lexer_eof(p->input) && lexer_peek(p->input).type == TOKEN_TYPE_SEPARATOR) {
-		skip_separator(p);
-	}
+	while (p->tokens[p->pos].type == TOKEN_TYPE_SEPARATOR) p->pos++;
 }
 
 TOKEN peek_non_separator(PARSER* p) {
-	char* ptr = p->input->input->ptr;
-	skip_all_separators(p);
-	TOKEN tok = lexer_peek(p->input);
-	input_rewind(p->input->input, ptr);
-	return tok;
+	long pos = p->pos;
+	while (p->tokens[pos].type == TOKEN_TYPE_SEPARATOR) pos++;
+	return p->tokens[pos];
+}
+
+// Nodes are located at the first token they are parsed from
+uint32_t next_offset(PARSER* p) {
+	return peek_non_separator(p).offset;
 }
 
-bool next_is_keyword(PARSER* p, const char* kw) {
+bool next_is_keyword(PARSER* p, uint8_t kw) {
 	TOKEN tok = peek_non_separator(p);
-	return tok.type != TOKEN_TYPE_NULL && tok.type == TOKEN_TYPE_KEYWORD && (kw[0] == 0 || strcmp(kw, tok.value) == 0);
+	return tok.type != TOKEN_TYPE_NULL && tok.type == TOKEN_TYPE_KEYWORD && (kw == KEYWORD_ID_NONE || tok.keyword == kw);
 }
 
 bool next_is_punc(PARSER* p, const char c) {
@@ -47,183 +84,173 @@ bool next_is_punc(PARSER* p, const char c) {
 	return tok.type != TOKEN_TYPE_NULL && tok.type == TOKEN_TYPE_PUNC && (c == 0 || tok.value[0] == c);
 }
 
-bool next_is_op(PARSER* p, const char* c) {
+bool next_is_op(PARSER* p, uint8_t op) {
 	TOKEN tok = peek_non_separator(p);
-	return tok.type != TOKEN_TYPE_NULL && tok.type == TOKEN_TYPE_OP && (c[0] == 0 || strcmp(tok.value, c) == 0);
+	return tok.type != TOKEN_TYPE_NULL && tok.type == TOKEN_TYPE_OP && (op == OP_NONE || tok.op == op);
 }
 
-void skip_keyword(PARSER* p, const char* kw) {
+void skip_keyword(PARSER* p, uint8_t kw) {
 	skip_all_separators(p);
-	if (next_is_keyword(p, kw)) lexer_next(p->input);
-	else lexer_error(p->input, "Keyword '%s' expected", kw);
+	if (next_is_keyword(p, kw)) parser_next(p);
+	else parser_error(p, "Keyword '%s' expected", KEYWORDS[kw]);
 }
 
 void skip_punc(PARSER* p, char c) {
 	skip_all_separators(p);
-	if (next_is_punc(p, c)) lexer_next(p->input);
-	else lexer_error(p->input, "TOKEN '%c' expected", c);
+	if (next_is_punc(p, c)) parser_next(p);
+	else parser_error(p, "TOKEN '%c' expected", c);
 }
 
-void skip_op(PARSER* p, const char* op) {
+void skip_op(PARSER* p, uint8_t op) {
 	skip_all_separators(p);
-	if (next_is_op(p, op)) lexer_next(p->input);
-	else lexer_error(p->input, "TOKEN '%s' expected", op);
+	if (next_is_op(p, op)) parser_next(p);
+	else parser_error(p, "TOKEN '%s' expected", OPERATORS[op].str);
 }
 
-int get_op_precedence(const char* op) {
-	for (int i = 0; i < NUM_OPS; i++) {
-		if (strcmp(OP_MAP_K[i], op) == 0) return OP_MAP_V[i];
-	}
-	return -1;
+// Identifier tokens are already interned by the lexer
+char* token_atom(TOKEN* tok) {
+	if (tok->type == TOKEN_TYPE_IDENTIFIER) return (char*)tok->value;
+	return intern(tok->value, tok->len);
 }
 
-AST parse_ast(PARSER* p);
-EXPRESSION parse_expr(PARSER* p);
-EXPRESSION parse_atom(PARSER* p);
-EXPRESSION parse_call(PARSER* p, EXPRESSION func);
+// Number tokens are not null terminated, so they are copied to a local buffer before conversion
+int64_t token_to_int(TOKEN* tok, int base) {
+	char buffer[64];
+	long len = min(tok->len, (long)sizeof(buffer) - 1);
+	memcpy(buffer, tok->value, len);
+	buffer[len] = 0;
+	return strtol(buffer, NULL, base);
+}
 
-EXPR_VEC delimited_expr(PARSER* p, char start, char end, char separator, EXPRESSION(*parser)(PARSER*)) {
-	EXPR_VEC result = evec_new(2);
+double token_to_float(TOKEN* tok) {
+	char buffer[64];
+	long len = min(tok->len, (long)sizeof(buffer) - 1);
+	memcpy(buffer, tok->value, len);
+	buffer[len] = 0;
+	return strtod(buffer, NULL);
+}
+
+NODE_LIST parse_block(PARSER* p);
+NODE parse_expr(PARSER* p);
+NODE parse_call(PARSER* p, NODE func);
+
+// Lists are collected on the parser's scratch stack and then moved into the AST in one piece
+NODE_LIST pop_node_list(PARSER* p, long start) {
+	NODE_LIST list = ast_add_list(&p->ast, p->node_stack.buffer + start, (uint32_t)(p->node_stack.size - start));
+	p->node_stack.size = start;
+	return list;
+}
+
+NODE_LIST delimited_expr(PARSER* p, char start, char end, char separator, NODE(*parser)(PARSER*)) {
+	long stack_start = p->node_stack.size;
 	bool first = true;
 	if (start) skip_punc(p, start);
-	while (!lexer_eof(p->input)) {
+	while (!parser_eof(p)) {
 		if (next_is_punc(p, end)) break;
 		if (first) first = false;
 		else skip_punc(p, separator);
 		if (next_is_punc(p, end)) break;
-		evec_push(&result, parser(p));
+		NODE e = parser(p);
+		nodevec_push(&p->node_stack, e);
 	}
 	skip_punc(p, end);
-	return result;
-}
-
-EXPRESSION maybe_unary(PARSER* p, EXPRESSION e) {
-	if (next_is_punc(p, '(')) return maybe_unary(p, parse_call(p, e));
-	if (next_is_op(p, "++") || next_is_op(p, "--")) {
-		char* op = copy_str(lexer_next(p->input).value);
-		EXPRESSION* expr = malloc(sizeof(EXPRESSION));
-		*expr = e;
-		return maybe_unary(p, (EXPRESSION) { EXPR_TYPE_UNARY_OP, .assign = { op, true, expr } });
-	}
-	return e;
-}
-
-EXPRESSION maybe_binary(PARSER* p, EXPRESSION e, int prec) {
-	if (next_is_op(p, "")) {
-		TOKEN token = lexer_peek(p->input);
-		int token_prec = get_op_precedence(token.value);
-		if (token_prec > prec) {
-			lexer_next(p->input);
-			EXPRESSION* left = malloc(sizeof(EXPRESSION));
-			EXPRESSION* right = malloc(sizeof(EXPRESSION));
-			*left = e;
-			*right = maybe_binary(p, maybe_unary(p, parse_atom(p)), token_prec);
-			if (strcmp(token.value, "=") == 0
-				|| strlen(token.value) == 2 && (token.value[0] == '+' || token.value[0] == '-' || token.value[0] == '*' || token.value[0] == '/' || token.value[0] == '%') && token.value[1] == '=') {
-				return maybe_unary(p, maybe_binary(p, (EXPRESSION) { EXPR_TYPE_ASSIGN, .assign = { copy_str(token.value), left, right } }, prec));
-			} else {
-				return maybe_unary(p, maybe_binary(p, (EXPRESSION) { EXPR_TYPE_BINARY_OP, .binary_op = (BINARY_OP){ copy_str(token.value), left, right } }, prec));
-			}
-		}
-	}
-	return e;
+	return pop_node_list(p, stack_start);
 }
 
-EXPRESSION parse_compound_expr(PARSER* p) {
+NODE parse_compound_expr(PARSER* p) {
+	uint32_t offset = next_offset(p);
 	skip_punc(p, '(');
-	EXPRESSION* expr = malloc(sizeof(EXPRESSION));
-	*expr = parse_expr(p);
+	NODE expr = parse_expr(p);
 	skip_punc(p, ')');
-	return (EXPRESSION) { EXPR_TYPE_COMPOUND_EXPR, .compound_expr = { expr } };
+	return ast_compound_expr(&p->ast, expr, offset);
 }
 
-EXPRESSION parse_compound(PARSER* p) {
+NODE parse_compound(PARSER* p) {
+	uint32_t offset = next_offset(p);
 	skip_punc(p, '{');
-	AST* ast = malloc(sizeof(AST));
-	*ast = parse_ast(p);
+	NODE_LIST block = parse_block(p);
 	skip_punc(p, '}');
-	return (EXPRESSION) { EXPR_TYPE_COMPOUND, .compound = { ast } };
-}
-
-EXPRESSION parse_return(PARSER* p) {
-	skip_keyword(p, KEYWORD_RETURN);
-	EXPRESSION* value = malloc(sizeof(EXPRESSION));
-	*value = parse_expr(p);
-	return (EXPRESSION) { EXPR_TYPE_RETURN, .ret_statement = { value } };
-}
-
-EXPRESSION parse_if(PARSER* p) {
-	skip_keyword(p, KEYWORD_IF);
-	EXPRESSION* condition = malloc(sizeof(EXPRESSION));
-	*condition = parse_expr(p);
-	EXPRESSION* then_block = malloc(sizeof(EXPRESSION));
-	*then_block = parse_expr(p);
-	EXPRESSION* else_block = NULL;
-	if (next_is_keyword(p, KEYWORD_ELSE)) {
-		skip_keyword(p, KEYWORD_ELSE);
-		else_block = malloc(sizeof(EXPRESSION));
-		*else_block = parse_expr(p);
+	return ast_compound(&p->ast, block, offset);
+}
+
+NODE parse_return(PARSER* p) {
+	uint32_t offset = next_offset(p);
+	skip_keyword(p, KEYWORD_ID_RETURN);
+	NODE value = parse_expr(p);
+	return ast_return(&p->ast, value, offset);
+}
+
+NODE parse_if(PARSER* p) {
+	uint32_t offset = next_offset(p);
+	skip_keyword(p, KEYWORD_ID_IF);
+	NODE condition = parse_expr(p);
+	NODE then_block = parse_expr(p);
+	NODE else_block = NODE_NULL;
+	if (next_is_keyword(p, KEYWORD_ID_ELSE)) {
+		skip_keyword(p, KEYWORD_ID_ELSE);
+		else_block = parse_expr(p);
 	}
-	return (EXPRESSION) { EXPR_TYPE_IF_STATEMENT, .if_statement = { condition, then_block, else_block } };
+	return ast_if_statement(&p->ast, (IF){ condition, then_block, else_block }, offset);
 }
 
-EXPRESSION parse_loop(PARSER* p) {
-	skip_keyword(p, KEYWORD_LOOP);
-	EXPRESSION* body = malloc(sizeof(EXPRESSION));
-	*body = parse_expr(p);
-	return (EXPRESSION) { EXPR_TYPE_LOOP, .loop = { NULL, body } };
+NODE parse_loop(PARSER* p) {
+	uint32_t offset = next_offset(p);
+	skip_keyword(p, KEYWORD_ID_LOOP);
+	NODE body = parse_expr(p);
+	return ast_loop(&p->ast, (LOOP){ NODE_NULL, body }, offset);
 }
 
-EXPRESSION parse_while(PARSER* p) {
-	skip_keyword(p, KEYWORD_WHILE);
-	EXPRESSION* condition = malloc(sizeof(EXPRESSION));
-	*condition = parse_expr(p);
-	EXPRESSION* body = malloc(sizeof(EXPRESSION));
-	*body = parse_expr(p);
-	return (EXPRESSION) { EXPR_TYPE_LOOP, .loop = { condition, body } };
+NODE parse_while(PARSER* p) {
+	uint32_t offset = next_offset(p);
+	skip_keyword(p, KEYWORD_ID_WHILE);
+	NODE condition = parse_expr(p);
+	NODE body = parse_expr(p);
+	return ast_loop(&p->ast, (LOOP){ condition, body }, offset);
 }
 
-EXPRESSION parse_break(PARSER* p) {
-	skip_keyword(p, KEYWORD_BREAK);
+NODE parse_break(PARSER* p) {
+	uint32_t offset = next_offset(p);
+	skip_keyword(p, KEYWORD_ID_BREAK);
 	uint8_t idx = 0;
 	if (next_is_punc(p, '(')) {
 		skip_punc(p, '(');
-		TOKEN index_token = lexer_next(p->input);
-		if (index_token.type != TOKEN_TYPE_INT) lexer_error(p->input, "Break index must be of type integer");
-		else idx = (uint8_t)strtol(index_token.value, NULL, 0);
+		TOKEN index_token = parser_next(p);
+		if (index_token.type != TOKEN_TYPE_INT) parser_error(p, "Break index must be of type integer");
+		else idx = (uint8_t)token_to_int(&index_token, 0);
 		skip_punc(p, ')');
 	}
-	return (EXPRESSION) { EXPR_TYPE_BREAK, .break_statement = { idx } };
+	return ast_break(&p->ast, idx, offset);
 }
 
-EXPRESSION parse_continue(PARSER* p) {
-	skip_keyword(p, KEYWORD_CONTINUE);
+NODE parse_continue(PARSER* p) {
+	uint32_t offset = next_offset(p);
+	skip_keyword(p, KEYWORD_ID_CONTINUE);
 	uint8_t idx = 0;
 	if (next_is_punc(p, '(')) {
 		skip_punc(p, '(');
-		TOKEN index_token = lexer_next(p->input);
-		if (index_token.type != TOKEN_TYPE_INT) lexer_error(p->input, "Continue index must be of type integer");
-		else idx = (uint8_t)strtol(index_token.value, NULL, 0);
+		TOKEN index_token = parser_next(p);
+		if (index_token.type != TOKEN_TYPE_INT) parser_error(p, "Continue index must be of type integer");
+		else idx = (uint8_t)token_to_int(&index_token, 0);
 		skip_punc(p, ')');
 	}
-	return (EXPRESSION) { EXPR_TYPE_CONTINUE, .continue_statement = { idx } };
+	return ast_continue(&p->ast, idx, offset);
 }
 
-EXPRESSION parse_call(PARSER* p, EXPRESSION func) {
-	EXPR_VEC arglist = delimited_expr(p, '(', ')', ',', parse_expr);
-	EXPRESSION* funcptr = malloc(sizeof(EXPRESSION));
-	*funcptr = func;
-	return (EXPRESSION) { EXPR_TYPE_FUNC_CALL, .func_call = (FUNC_CALL){ funcptr, arglist.buffer, (uint8_t)arglist.size } };
+NODE parse_call(PARSER* p, NODE func) {
+	uint32_t offset = next_offset(p);
+	NODE_LIST args = delimited_expr(p, '(', ')', ',', parse_expr);
+	return ast_func_call(&p->ast, (FUNC_CALL){ func, args }, offset);
 }
 
 TYPE parse_type(PARSER* p) {
 	char* name = NULL;
 	bool cpy = false;
-	if (next_is_op(p, "*")) {
+	if (next_is_op(p, OP_MUL)) {
 		cpy = true;
-		skip_op(p, "*");
+		skip_op(p, OP_MUL);
 	}
-	name = copy_str(lexer_next(p->input).value);
+	TOKEN name_token = parser_next(p);
+	name = token_atom(&name_token);
 
 	return (TYPE) { name, cpy };
 }
@@ -231,268 +258,242 @@ TYPE parse_type(PARSER* p) {
 VAR_DECL parse_arg(PARSER* p) {
 	TYPE type = parse_type(p);
 	char* name = NULL;
-	if (lexer_peek(p->input).type == TOKEN_TYPE_IDENTIFIER) name = copy_str(lexer_next(p->input).value);
+	if (parser_peek(p).type == TOKEN_TYPE_IDENTIFIER) {
+		TOKEN name_token = parser_next(p);
+		name = token_atom(&name_token);
+	}
 	return (VAR_DECL) { type, name };
 }
 
-VAR_DECL_VEC parse_arg_list(PARSER* p) {
-	VAR_DECL_VEC vec = vdvec_new(2);
+VAR_DECL* parse_arg_list(PARSER* p, int* num_args) {
+	p->arg_stack.size = 0;
 	while (!next_is_punc(p, ')')) {
 		if (next_is_punc(p, ',')) skip_punc(p, ',');
 		VAR_DECL arg = parse_arg(p);
-		vdvec_push(&vec, arg);
+		vdvec_push(&p->arg_stack, arg);
 	}
-	return vec;
+	*num_args = p->arg_stack.size;
+	return arena_copy(p->arena, p->arg_stack.buffer, p->arg_stack.size * sizeof(VAR_DECL));
 }
 
-EXPRESSION parse_func_decl(PARSER* p) {
-	skip_keyword(p, KEYWORD_FUNC_DECL);
-	char* funcname = copy_str(lexer_next(p->input).value);
+NODE parse_func_decl(PARSER* p) {
+	uint32_t offset = next_offset(p);
+	skip_keyword(p, KEYWORD_ID_FUNC_DECL);
+	TOKEN name_token = parser_next(p);
+	char* funcname = token_atom(&name_token);
 	skip_punc(p, '(');
-	VAR_DECL_VEC argvec = parse_arg_list(p);
-	VAR_DECL* args = argvec.buffer;
-	int num_args = argvec.size;
+	int num_args = 0;
+	VAR_DECL* args = parse_arg_list(p, &num_args);
 	skip_punc(p, ')');
-	return (EXPRESSION) { EXPR_TYPE_FUNC_DECL, .func_decl = (FUNC_DECL){ funcname, args, num_args } };
+	return ast_func_decl(&p->ast, (FUNC_DECL){ funcname, args, num_args }, offset);
 }
 
-EXPRESSION parse_func_def(PARSER* p) {
-	skip_keyword(p, KEYWORD_FUNC_DEF);
-	char* funcname = copy_str(lexer_next(p->input).value);
+NODE parse_func_def(PARSER* p) {
+	uint32_t offset = next_offset(p);
+	skip_keyword(p, KEYWORD_ID_FUNC_DEF);
+	TOKEN name_token = parser_next(p);
+	char* funcname = token_atom(&name_token);
 	skip_punc(p, '(');
-	VAR_DECL_VEC argvec = parse_arg_list(p);
-	VAR_DECL* args = argvec.buffer;
-	int num_args = argvec.size;
+	int num_args = 0;
+	VAR_DECL* args = parse_arg_list(p, &num_args);
 	skip_punc(p, ')');
-	EXPRESSION* body = malloc(sizeof(EXPRESSION));
-	*body = parse_expr(p);
-	return (EXPRESSION) { EXPR_TYPE_FUNC_DEF, .func_def = (FUNC_DEF){ (FUNC_DECL) { funcname, args, num_args }, body } };
-}
-
-EXPRESSION parse_import(PARSER* p) {
-	skip_keyword(p, KEYWORD_IMPORT);
-	char* module_name = copy_str(lexer_next(p->input).value);
-	return (EXPRESSION) { EXPR_TYPE_IMPORT, .import = (IMPORT){ module_name } };
+	NODE body = parse_expr(p);
+	return ast_func_def(&p->ast, (FUNC_DEF){ (FUNC_DECL) { funcname, args, num_args }, body }, offset);
 }
 
-EXPRESSION parse_atom(PARSER* p) {
-	skip_all_separators(p);
-
-	if (next_is_keyword(p, KEYWORD_TRUE) || next_is_keyword(p, KEYWORD_FALSE)) return (EXPRESSION) { EXPR_TYPE_BOOL_LITERAL, .bool_literal = { strcmp(lexer_next(p->input).value, KEYWORD_FALSE) } };
-	if (next_is_punc(p, '(')) return parse_compound_expr(p);
-	if (next_is_op(p, "*") || next_is_op(p, "-") || next_is_op(p, "+") || next_is_op(p, "++") || next_is_op(p, "--")) {
-		char* op = copy_str(lexer_next(p->input).value);
-		EXPRESSION* expr = malloc(sizeof(EXPRESSION));
-		*expr = maybe_unary(p, parse_atom(p));
-		return (EXPRESSION) { EXPR_TYPE_UNARY_OP, .unary_op = (UNARY_OP){ op, false, expr } };
-	}
-	if (next_is_punc(p, '{')) return parse_compound(p);
-	if (next_is_keyword(p, KEYWORD_RETURN)) return parse_return(p);
-	if (next_is_keyword(p, KEYWORD_IF)) return parse_if(p);
-	if (next_is_keyword(p, KEYWORD_LOOP)) return parse_loop(p);
-	if (next_is_keyword(p, KEYWORD_WHILE)) return parse_while(p);
-	if (next_is_keyword(p, KEYWORD_BREAK)) return parse_break(p);
-	if (next_is_keyword(p, KEYWORD_CONTINUE)) return parse_continue(p);
-
-	if (next_is_keyword(p, KEYWORD_FUNC_DECL)) return parse_func_decl(p);
-	if (next_is_keyword(p, KEYWORD_FUNC_DEF)) return parse_func_def(p);
-
-	if (next_is_keyword(p, KEYWORD_IMPORT)) return parse_import(p);
-
-	TOKEN tok = lexer_next(p->input);
-	switch (tok.type) {
-	case TOKEN_TYPE_INT: return (EXPRESSION) { EXPR_TYPE_INT_LITERAL, .int_literal = { strtol(tok.value, NULL, 10) } };
-	case TOKEN_TYPE_CHAR: return (EXPRESSION) { EXPR_TYPE_CHAR_LITERAL, .char_literal = { tok.value[0] } };
-	case TOKEN_TYPE_FLOAT: return (EXPRESSION) { EXPR_TYPE_FLOAT_LITERAL, .float_literal = { strtod(tok.value, NULL) } };
-	case TOKEN_TYPE_STRING: return (EXPRESSION) { EXPR_TYPE_STRING_LITERAL, .string_literal = { copy_str(tok.value) } };
-	case TOKEN_TYPE_IDENTIFIER: return (EXPRESSION) { EXPR_TYPE_IDENTIFIER, .identifier = { copy_str(tok.value) } };
-	default: return (EXPRESSION) { 0 };
-	}
+NODE parse_import(PARSER* p) {
+	uint32_t offset = next_offset(p);
+	skip_keyword(p, KEYWORD_ID_IMPORT);
+	TOKEN name_token = parser_next(p);
+	char* module_name = token_atom(&name_token);
+	return ast_import(&p->ast, module_name, offset);
 }
 
-EXPRESSION parse_expr(PARSER* p) {
-	EXPRESSION atom = parse_atom(p);
-	if (atom.type != TOKEN_TYPE_NULL) return maybe_binary(p, maybe_unary(p, atom), 0);
-	return (EXPRESSION) { 0 };
-	//return parse_expr(p); //return (EXPRESSION) { 0 }; //return parse_expr(p); // TODO error
+NODE parse_int_literal(PARSER* p) {
+	TOKEN tok = parser_next(p);
+	return ast_int_literal(&p->ast, token_to_int(&tok, 10), tok.offset);
 }
 
-AST parse_ast(PARSER* p) {
-	EXPR_VEC expressions = evec_new(10);
-	skip_all_separators(p);
-	while (!lexer_eof(p->input) && !next_is_punc(p, '}')) {
-		evec_push(&expressions, parse_expr(p));
-		if (!lexer_eof(p->input)/* && p->input->last.type != TOKEN_TYPE_SEPARATOR*/) skip_separator(p);
-	}
-	return (AST) { expressions.buffer, expressions.size };
+NODE parse_char_literal(PARSER* p) {
+	TOKEN tok = parser_next(p);
+	return ast_char_literal(&p->ast, tok.len ? tok.value[0] : 0, tok.offset);
 }
 
-void delete_expr(EXPRESSION* expr);
-void delete_ast(AST* ast);
-
-void delete_int_literal(INT* i) {
+NODE parse_float_literal(PARSER* p) {
+	TOKEN tok = parser_next(p);
+	return ast_float_literal(&p->ast, token_to_float(&tok), tok.offset);
 }
 
-void delete_char_literal(CHAR* ch) {
+NODE parse_string_literal(PARSER* p) {
+	TOKEN tok = parser_next(p);
+	return ast_string_literal(&p->ast, arena_strn(p->arena, tok.value, tok.len), tok.offset);
 }
 
-void delete_bool_literal(BOOL* b) {
+NODE parse_identifier(PARSER* p) {
+	TOKEN tok = parser_next(p);
+	return ast_identifier(&p->ast, token_atom(&tok), tok.offset);
 }
 
-void delete_float_literal(FLOAT* f) {
+NODE parse_bool_literal(PARSER* p) {
+	TOKEN tok = parser_next(p);
+	return ast_bool_literal(&p->ast, tok.keyword != KEYWORD_ID_FALSE, tok.offset);
 }
 
-void delete_string_literal(STRING* str) {
-	free(str->value);
-	str->value = NULL;
+// Tokens that can't start an expression are skipped and produce no node
+NODE parse_unexpected(PARSER* p) {
+	parser_next(p);
+	return NODE_NULL;
 }
 
-void delete_identifier(IDENTIFIER* i) {
-	free(i->name);
-	i->name = NULL;
-}
-
-void delete_assign(ASSIGN* assign) {
-	free(assign->op);
-	assign->op = NULL;
-
-	delete_expr(assign->left);
-	free(assign->left);
-	assign->left = NULL;
-
-	delete_expr(assign->right);
-	free(assign->right);
-	assign->right = NULL;
+NODE parse_punc(PARSER* p) {
+	switch (parser_peek(p).value[0]) {
+	case '(': return parse_compound_expr(p);
+	case '{': return parse_compound(p);
+	default: return parse_unexpected(p);
+	}
 }
 
-void delete_binary_op(BINARY_OP* binary_op) {
-	free(binary_op->op);
-	binary_op->op = NULL;
+typedef NODE(*PREFIX_PARSER)(PARSER*);
 
-	delete_expr(binary_op->left);
-	free(binary_op->left);
-	binary_op->left = NULL;
+const PREFIX_PARSER KEYWORD_PARSERS[NUM_KEYWORD_IDS] = {
+	[KEYWORD_ID_TRUE] = parse_bool_literal,
+	[KEYWORD_ID_FALSE] = parse_bool_literal,
 
-	delete_expr(binary_op->right);
-	free(binary_op->right);
-	binary_op->right = NULL;
-}
+	[KEYWORD_ID_RETURN] = parse_return,
+	[KEYWORD_ID_IF] = parse_if,
+	[KEYWORD_ID_LOOP] = parse_loop,
+	[KEYWORD_ID_WHILE] = parse_while,
+	[KEYWORD_ID_BREAK] = parse_break,
+	[KEYWORD_ID_CONTINUE] = parse_continue,
 
-void delete_unary_op(UNARY_OP* unary_op) {
-	free(unary_op->op);
-	unary_op->op = NULL;
+	[KEYWORD_ID_FUNC_DECL] = parse_func_decl,
+	[KEYWORD_ID_FUNC_DEF] = parse_func_def,
 
-	delete_expr(unary_op->expr);
-	free(unary_op->expr);
-	unary_op->expr = NULL;
-}
+	[KEYWORD_ID_IMPORT] = parse_import,
+};
 
-void delete_compound(COMPOUND* compound) {
-	delete_ast(compound->ast);
+NODE parse_keyword(PARSER* p) {
+	PREFIX_PARSER parser = KEYWORD_PARSERS[parser_peek(p).keyword];
+	return parser ? parser(p) : parse_unexpected(p);
 }
 
-void delete_return(RETURN* ret_statement) {
-	delete_expr(ret_statement->value);
-	free(ret_statement->value);
-	ret_statement->value = NULL;
-}
+const PREFIX_PARSER TOKEN_PARSERS[NUM_TOKEN_TYPES] = {
+	[TOKEN_TYPE_INT] = parse_int_literal,
+	[TOKEN_TYPE_CHAR] = parse_char_literal,
+	[TOKEN_TYPE_FLOAT] = parse_float_literal,
+	[TOKEN_TYPE_STRING] = parse_string_literal,
+	[TOKEN_TYPE_IDENTIFIER] = parse_identifier,
+	[TOKEN_TYPE_KEYWORD] = parse_keyword,
+	[TOKEN_TYPE_PUNC] = parse_punc,
+	[TOKEN_TYPE_OP] = parse_unexpected,
+};
 
-void delete_if_statement(IF* if_statement) {
-	delete_expr(if_statement->condition);
-	free(if_statement->condition);
-	if_statement->condition = NULL;
-	delete_expr(if_statement->then_block);
-	free(if_statement->then_block);
-	if_statement->then_block = NULL;
-	if (if_statement->else_block) {
-		delete_expr(if_statement->else_block);
-		free(if_statement->else_block);
-		if_statement->else_block = NULL;
+// Every token is classified once, by its type and then by its keyword id or punctuation character.
+// Prefix operators are handled by parse_binary.
+NODE parse_prefix(PARSER* p) {
+	skip_all_separators(p);
+	PREFIX_PARSER parser = TOKEN_PARSERS[parser_peek(p).type];
+	return parser ? parser(p) : parse_unexpected(p);
+}
+
+// Calls and postfix increment/decrement. A call may start on the next line, postfix operators have to follow directly.
+NODE parse_postfix(PARSER* p, NODE e) {
+	while (true) {
+		TOKEN tok = parser_peek(p);
+		if (tok.type == TOKEN_TYPE_OP && (tok.op == OP_INC || tok.op == OP_DEC)) {
+			parser_next(p);
+			e = ast_unary_op(&p->ast, (UNARY_OP){ tok.op, true, e }, tok.offset);
+		} else if (next_is_punc(p, '(')) {
+			e = parse_call(p, e);
+		} else return e;
 	}
 }
 
-void delete_loop(LOOP* loop) {
-	if (loop->condition) {
-		delete_expr(loop->condition);
-		free(loop->condition);
-		loop->condition = NULL;
-	}
-	delete_expr(loop->body);
-	free(loop->body);
-	loop->body = NULL;
+bool next_is_prefix_op(PARSER* p) {
+	TOKEN tok = parser_peek(p);
+	return tok.type == TOKEN_TYPE_OP && OPERATORS[tok.op].prefix;
 }
 
-void delete_break(BREAK* break_statement) {
+NODE reduce_operator(PARSER* p, NODE operand) {
+	OPERATOR_FRAME frame = p->op_stack.buffer[--p->op_stack.size];
+	NODE node;
+	if (frame.prefix) node = ast_unary_op(&p->ast, (UNARY_OP){ frame.op, false, operand }, frame.offset);
+	else if (OPERATORS[frame.op].assign) node = ast_assign(&p->ast, (ASSIGN){ frame.op, frame.left, operand }, frame.offset);
+	else node = ast_binary_op(&p->ast, (BINARY_OP){ frame.op, frame.left, operand }, frame.offset);
+	return parse_postfix(p, node);
 }
 
-void delete_continue(CONTINUE* continue_statement) {
-}
+// Pratt parser with an explicit operator stack, so operator chains of any length and associativity don't recurse.
+// A binary operator binds while its precedence is higher than the right binding power of the operator below it,
+// right associative operators bind their right hand side one level lower, so a = b = c is a = (b = c).
+NODE parse_binary(PARSER* p) {
+	long base = p->op_stack.size;
+	while (true) {
+		skip_all_separators(p);
+		while (next_is_prefix_op(p)) {
+			TOKEN op_token = parser_next(p);
+			opfvec_push(&p->op_stack, (OPERATOR_FRAME){ op_token.op, true, 0, op_token.offset, NODE_NULL });
+			skip_all_separators(p);
+		}
 
-void delete_func_call(FUNC_CALL* func_call) {
-	delete_expr(func_call->callee);
-	free(func_call->callee);
-	func_call->callee = NULL;
-	for (int i = 0; i < func_call->num_args; i++) {
-		delete_expr(&func_call->args[i]);
-	}
-}
+		NODE operand = parse_prefix(p);
+		bool has_frame = p->op_stack.size > base;
+		if (operand == NODE_NULL && !has_frame) return NODE_NULL;
+		if (operand == NODE_NULL && !p->op_stack.buffer[p->op_stack.size - 1].prefix) {
+			// A missing right hand side ends that operand, the operator is completed with a null node
+			operand = reduce_operator(p, NODE_NULL);
+		} else {
+			operand = parse_postfix(p, operand);
+			while (p->op_stack.size > base && p->op_stack.buffer[p->op_stack.size - 1].prefix) operand = reduce_operator(p, operand);
+		}
 
-void delete_type(TYPE* type) {
-	free(type->name);
-	type->name = NULL;
-}
+		TOKEN token = parser_peek(p);
+		int prec = token.type == TOKEN_TYPE_OP ? OPERATORS[token.op].precedence : -1;
+		while (p->op_stack.size > base && p->op_stack.buffer[p->op_stack.size - 1].right_prec >= prec) operand = reduce_operator(p, operand);
+		if (prec <= 0) return operand;
 
-void delete_var_decl(VAR_DECL* var_decl) {
-	free(var_decl->name);
-	var_decl->name = NULL;
+		parser_next(p);
+		const OPERATOR* op = &OPERATORS[token.op];
+		int8_t right_prec = op->assoc == OP_ASSOC_RIGHT ? op->precedence - 1 : op->precedence;
+		opfvec_push(&p->op_stack, (OPERATOR_FRAME){ token.op, false, right_prec, token.offset, operand });
+	}
 }
 
-void delete_func_decl(FUNC_DECL* func_decl) {
-	free(func_decl->funcname);
-	func_decl->funcname = NULL;
-	free(func_decl->args);
-	func_decl->args = NULL;
-}
+typedef struct PARSE_EXPR_CALL_t {
+	PARSER* parser;
+	NODE result;
+} PARSE_EXPR_CALL;
 
-void delete_func_def(FUNC_DEF* func_def) {
-	delete_func_decl(&func_def->decl);
-	delete_expr(func_def->body);
+void parse_expr_continuation(void* arg) {
+	PARSE_EXPR_CALL* call = arg;
+	call->result = parse_binary(call->parser);
 }
 
-void delete_import(IMPORT* import) {
-	free(import->module_name);
-	import->module_name = NULL;
+// Nested blocks and parentheses recurse through here, deep nesting continues on a new stack segment
+NODE parse_expr(PARSER* p) {
+	if (stack_low()) {
+		PARSE_EXPR_CALL call = { p, NODE_NULL };
+		stack_grow_call(parse_expr_continuation, &call);
+		return call.result;
+	}
+	return parse_binary(p);
 }
 
-void delete_expr(EXPRESSION* expr) {
-	switch (expr->type) {
-	case EXPR_TYPE_INT_LITERAL: delete_int_literal(&expr->int_literal); break;
-	case EXPR_TYPE_CHAR_LITERAL: delete_char_literal(&expr->char_literal); break;
-	case EXPR_TYPE_BOOL_LITERAL: delete_bool_literal(&expr->bool_literal); break;
-	case EXPR_TYPE_FLOAT_LITERAL: delete_float_literal(&expr->float_literal); break;
-	case EXPR_TYPE_STRING_LITERAL: delete_string_literal(&expr->string_literal); break;
-	case EXPR_TYPE_IDENTIFIER: delete_identifier(&expr->identifier); break;
-	case EXPR_TYPE_ASSIGN: delete_assign(&expr->assign); break;
-	case EXPR_TYPE_BINARY_OP: delete_binary_op(&expr->binary_op); break;
-	case EXPR_TYPE_UNARY_OP: delete_unary_op(&expr->unary_op); break;
-	case EXPR_TYPE_COMPOUND: delete_compound(&expr->compound); break;
-	case EXPR_TYPE_RETURN: delete_return(&expr->ret_statement); break;
-	case EXPR_TYPE_IF_STATEMENT: delete_if_statement(&expr->if_statement); break;
-	case EXPR_TYPE_LOOP: delete_loop(&expr->loop); break;
-	case EXPR_TYPE_BREAK: delete_break(&expr->break_statement); break;
-	case EXPR_TYPE_CONTINUE: delete_continue(&expr->continue_statement); break;
-
-	case EXPR_TYPE_FUNC_CALL: delete_func_call(&expr->func_call); break;
-	case EXPR_TYPE_FUNC_DECL: delete_func_decl(&expr->func_decl); break;
-
-	case EXPR_TYPE_IMPORT: delete_import(&expr->import); break;
-
-	default:  break;
+NODE_LIST parse_block(PARSER* p) {
+	long stack_start = p->node_stack.size;
+	skip_all_separators(p);
+	while (!parser_eof(p) && !next_is_punc(p, '}')) {
+		NODE e = parse_expr(p);
+		nodevec_push(&p->node_stack, e);
+		if (!parser_eof(p)/* && p->input->last.type != TOKEN_TYPE_SEPARATOR*/) skip_separator(p);
 	}
+	return pop_node_list(p, stack_start);
 }
 
-void delete_ast(AST* ast) {
-	for (int i = 0; i < ast->num_expressions; i++) {
-		delete_expr(&ast->expressions[i]);
-	}
+AST parse_ast(PARSER* p) {
+	uint8_t subsystem = mem_enter(MEM_PARSER);
+	p->ast = ast_new();
+	p->ast.root = parse_block(p);
+	mem_leave(subsystem);
+	return p->ast;
 }
\ No newline at end of file
@@ -7,13 +7,33 @@
 
 #include "lexer.h"
 #include "ast.h"
+#include "arena.h"
+
+// Operator waiting for its right operand (binary) or its operand (prefix) while an expression is parsed
+typedef struct OPERATOR_FRAME_t {
+	uint8_t op;
+	bool prefix;
+	int8_t right_prec;
+	uint32_t offset;
+	NODE left;
+} OPERATOR_FRAME;
+
+DECL_DYNAMIC_VECTOR(OPERATOR_FRAME, OPERATOR_FRAME_VEC, opfvec)
 
 typedef struct PARSER_t {
 	LEXER* input;
+	TOKEN* tokens;
+	long pos;
+
+	AST ast;
+	// Owns the string literals and parameter lists of the module
+	ARENA* arena;
+	NODE_VEC node_stack;
+	OPERATOR_FRAME_VEC op_stack;
+	VAR_DECL_VEC arg_stack;
 } PARSER;
 
-PARSER parser_new(LEXER* lexer);
+PARSER parser_new(LEXER* lexer, ARENA* arena);
 void parser_delete(PARSER* parser);
 
-AST parse_ast(PARSER* p);
-void delete_ast(AST* ast);
\ No newline at end of file
+AST parse_ast(PARSER* p);
\ No newline at end of file
@@ -1,183 +1,211 @@
 #include "printer.h"
 
-AST_PRINTER printer_new() {
+#include "operators.h"
+#include "stack.h"
+
+AST_PRINTER printer_new(FILE* out) {
 	AST_PRINTER p;
+	p.out = out;
 	p.indentation = 0;
+	p.ast = NULL;
 	return p;
 }
 
 void printer_delete(AST_PRINTER* printer) {
+	(void)printer;
 }
 
-void print_ast(AST_PRINTER* p, AST* ast);
-void print_expr(AST_PRINTER* p, EXPRESSION* expr);
+void print_block(AST_PRINTER* p, NODE_LIST block);
+void print_expr(AST_PRINTER* p, NODE expr);
 
 void indent(AST_PRINTER* p) {
-	for (int i = 0; i < p->indentation * 2; i++) putchar(' ');
+	for (int i = 0; i < p->indentation * 2; i++) fputc(' ', p->out);
 }
 
-void print_int_literal(AST_PRINTER* p, INT* i) {
-	printf("%d", (int)i->value);
+void print_int_literal(AST_PRINTER* p, int64_t value) {
+	fprintf(p->out, "%d", (int)value);
 }
 
-void print_char_literal(AST_PRINTER* p, CHAR* i) {
-	putchar('\'');
-	putchar(i->value);
-	putchar('\'');
+void print_char_literal(AST_PRINTER* p, uint8_t value) {
+	fputc('\'', p->out);
+	fputc(value, p->out);
+	fputc('\'', p->out);
 }
 
-void print_bool_literal(AST_PRINTER* p, BOOL* b) {
-	printf(b->value ? "true" : "false");
+void print_bool_literal(AST_PRINTER* p, bool value) {
+	fputs(value ? "true" : "false", p->out);
 }
 
-void print_float_literal(AST_PRINTER* p, FLOAT* f) {
-	printf("%f", f->value);
+void print_float_literal(AST_PRINTER* p, double value) {
+	fprintf(p->out, "%f", value);
 }
 
-void print_string_literal(AST_PRINTER* p, STRING* str) {
-	putchar('"');
-	printf(str->value);
-	putchar('"');
+void print_string_literal(AST_PRINTER* p, char* value) {
+	fputc('"', p->out);
+	fputs(value, p->out);
+	fputc('"', p->out);
 }
 
-void print_identifier(AST_PRINTER* p, IDENTIFIER* identifier) {
-	printf(identifier->name);
+void print_identifier(AST_PRINTER* p, char* name) {
+	fputs(name, p->out);
 }
 
-void print_compound_expr(AST_PRINTER* p, COMPOUND_EXPR* compound_expr) {
-	putchar('(');
-	print_expr(p, compound_expr->expr);
-	putchar(')');
+void print_compound_expr(AST_PRINTER* p, NODE expr) {
+	fputc('(', p->out);
+	print_expr(p, expr);
+	fputc(')', p->out);
 }
 
 void print_func_call(AST_PRINTER* p, FUNC_CALL* func_call) {
 	print_expr(p, func_call->callee);
-	putchar('(');
-	for (int i = 0; i < func_call->num_args; i++) {
-		print_expr(p, &func_call->args[i]);
-		if (i < func_call->num_args - 1) printf(", ");
+	fputc('(', p->out);
+	for (uint32_t i = 0; i < func_call->args.size; i++) {
+		print_expr(p, AST_LIST_NODE(p->ast, func_call->args, i));
+		if (i < func_call->args.size - 1) fputs(", ", p->out);
 	}
-	putchar(')');
+	fputc(')', p->out);
 }
 
 void print_assign(AST_PRINTER* p, ASSIGN* assign) {
 	print_expr(p, assign->left);
-	printf(" %s ", assign->op);
+	fprintf(p->out, " %s ", OPERATORS[assign->op].str);
 	print_expr(p, assign->right);
 }
 
 void print_binary_op(AST_PRINTER* p, BINARY_OP* binary) {
 	print_expr(p, binary->left);
-	printf(" %s ", binary->op);
+	fprintf(p->out, " %s ", OPERATORS[binary->op].str);
 	print_expr(p, binary->right);
 }
 
 void print_unary_op(AST_PRINTER* p, UNARY_OP* unary) {
-	if (!unary->position) printf(unary->op);
+	if (!unary->position) fprintf(p->out, "%s", OPERATORS[unary->op].str);
 	print_expr(p, unary->expr);
-	if (unary->position) printf(unary->op);
+	if (unary->position) fprintf(p->out, "%s", OPERATORS[unary->op].str);
 }
 
-void print_compound(AST_PRINTER* p, COMPOUND* compound) {
-	printf("{\n");
+void print_compound(AST_PRINTER* p, NODE_LIST block) {
+	fputs("{\n", p->out);
 	p->indentation++;
-	print_ast(p, compound->ast);
+	print_block(p, block);
 	p->indentation--;
 	indent(p);
-	putchar('}');
+	fputc('}', p->out);
 }
 
 void print_if_statement(AST_PRINTER* p, IF* if_statement) {
-	printf("if ");
+	fputs("if ", p->out);
 	print_expr(p, if_statement->condition);
-	putchar(' ');
+	fputc(' ', p->out);
 	print_expr(p, if_statement->then_block);
 	if (if_statement->else_block) {
-		printf(" else ");
+		fputs(" else ", p->out);
 		print_expr(p, if_statement->else_block);
 	}
 }
 
 void print_loop(AST_PRINTER* p, LOOP* loop) {
-	printf("loop ");
+	fputs("loop ", p->out);
 	if (loop->condition) {
 		print_expr(p, loop->condition);
-		putchar(' ');
+		fputc(' ', p->out);
 	}
 	print_expr(p, loop->body);
 }
 
-void print_break(AST_PRINTER* p, BREAK* break_statement) {
-	printf("break");
+void print_break(AST_PRINTER* p, uint8_t idx) {
+	(void)idx;
+	fputs("break", p->out);
 }
 
-void print_continue(AST_PRINTER* p, CONTINUE* continue_statement) {
-	printf("continue");
+void print_continue(AST_PRINTER* p, uint8_t idx) {
+	(void)idx;
+	fputs("continue", p->out);
 }
 
-void print_type(TYPE t) {
-	if (t.cpy) putchar('*');
-	printf(t.name);
+void print_type(AST_PRINTER* p, TYPE t) {
+	if (t.cpy) fputc('*', p->out);
+	fputs(t.name, p->out);
 }
 
 void print_arg_list(AST_PRINTER* p, VAR_DECL* args, int num_args) {
 	for (int i = 0; i < num_args; i++) {
-		print_type(args[i].type);
-		if (args[i].name) printf(" %s", args[i].name);
-		if (i < num_args - 1) printf(", ");
+		print_type(p, args[i].type);
+		if (args[i].name) fprintf(p->out, " %s", args[i].name);
+		if (i < num_args - 1) fputs(", ", p->out);
 	}
 }
 
 void print_func_decl(AST_PRINTER* p, FUNC_DECL* func_decl) {
-	printf("decl %s(", func_decl->funcname);
+	fprintf(p->out, "decl %s(", func_decl->funcname);
 	print_arg_list(p, func_decl->args, func_decl->num_args);
-	putchar(')');
+	fputc(')', p->out);
 }
 
 void print_func_def(AST_PRINTER* p, FUNC_DEF* func_def) {
-	printf("def %s(", func_def->decl.funcname);
+	fprintf(p->out, "def %s(", func_def->decl.funcname);
 	print_arg_list(p, func_def->decl.args, func_def->decl.num_args);
-	printf(") ");
+	fputs(") ", p->out);
 	print_expr(p, func_def->body);
 }
 
-void print_import(AST_PRINTER* p, IMPORT* import) {
-	printf("import %s", import->module_name);
+void print_import(AST_PRINTER* p, char* module_name) {
+	fprintf(p->out, "import %s", module_name);
 }
 
-void print_expr(AST_PRINTER* p, EXPRESSION* expr) {
-	switch (expr->type) {
-	case EXPR_TYPE_INT_LITERAL: print_int_literal(p, &expr->int_literal); break;
-	case EXPR_TYPE_CHAR_LITERAL: print_char_literal(p, &expr->char_literal); break;
-	case EXPR_TYPE_BOOL_LITERAL: print_bool_literal(p, &expr->bool_literal); break;
-	case EXPR_TYPE_FLOAT_LITERAL: print_float_literal(p, &expr->float_literal); break;
-	case EXPR_TYPE_STRING_LITERAL: print_string_literal(p, &expr->string_literal); break;
-	case EXPR_TYPE_IDENTIFIER: print_identifier(p, &expr->identifier); break;
-	case EXPR_TYPE_COMPOUND_EXPR: print_compound_expr(p, &expr->compound_expr); break;
-
-	case EXPR_TYPE_FUNC_CALL: print_func_call(p, &expr->func_call); break;
-	case EXPR_TYPE_ASSIGN: print_assign(p, &expr->assign); break;
-	case EXPR_TYPE_BINARY_OP: print_binary_op(p, &expr->binary_op); break;
-	case EXPR_TYPE_UNARY_OP: print_unary_op(p, &expr->unary_op); break;
-	case EXPR_TYPE_COMPOUND: print_compound(p, &expr->compound); break;
-	case EXPR_TYPE_IF_STATEMENT: print_if_statement(p, &expr->if_statement); break;
-	case EXPR_TYPE_LOOP: print_loop(p, &expr->loop); break;
-	case EXPR_TYPE_BREAK: print_break(p, &expr->break_statement); break;
-	case EXPR_TYPE_CONTINUE: print_continue(p, &expr->continue_statement); break;
+typedef struct PRINT_EXPR_CALL_t {
+	AST_PRINTER* p;
+	NODE expr;
+} PRINT_EXPR_CALL;
 
-	case EXPR_TYPE_FUNC_DECL: print_func_decl(p, &expr->func_decl); break;
-	case EXPR_TYPE_FUNC_DEF: print_func_def(p, &expr->func_def); break;
+void print_expr_continuation(void* arg) {
+	PRINT_EXPR_CALL* call = arg;
+	print_expr(call->p, call->expr);
+}
 
-	case EXPR_TYPE_IMPORT: print_import(p, &expr->import); break;
+void print_expr(AST_PRINTER* p, NODE expr) {
+	if (stack_low()) {
+		stack_grow_call(print_expr_continuation, &(PRINT_EXPR_CALL){ p, expr });
+		return;
+	}
+	AST* ast = p->ast;
+	switch (AST_TYPE(ast, expr)) {
+	case EXPR_TYPE_INT_LITERAL: print_int_literal(p, AST_INT(ast, expr)); break;
+	case EXPR_TYPE_CHAR_LITERAL: print_char_literal(p, (uint8_t)AST_PAYLOAD(ast, expr)); break;
+	case EXPR_TYPE_BOOL_LITERAL: print_bool_literal(p, AST_PAYLOAD(ast, expr)); break;
+	case EXPR_TYPE_FLOAT_LITERAL: print_float_literal(p, AST_FLOAT(ast, expr)); break;
+	case EXPR_TYPE_STRING_LITERAL: print_string_literal(p, AST_STRING(ast, expr)); break;
+	case EXPR_TYPE_IDENTIFIER: print_identifier(p, AST_NAME(ast, expr)); break;
+	case EXPR_TYPE_COMPOUND_EXPR: print_compound_expr(p, AST_CHILD(ast, expr)); break;
+
+	case EXPR_TYPE_FUNC_CALL: print_func_call(p, AST_FUNC_CALL(ast, expr)); break;
+	case EXPR_TYPE_ASSIGN: print_assign(p, AST_ASSIGN(ast, expr)); break;
+	case EXPR_TYPE_BINARY_OP: print_binary_op(p, AST_BINARY_OP(ast, expr)); break;
+	case EXPR_TYPE_UNARY_OP: print_unary_op(p, AST_UNARY_OP(ast, expr)); break;
+	case EXPR_TYPE_COMPOUND: print_compound(p, AST_BLOCK(ast, expr)); break;
+	case EXPR_TYPE_IF_STATEMENT: print_if_statement(p, AST_IF(ast, expr)); break;
+	case EXPR_TYPE_LOOP: print_loop(p, AST_LOOP(ast, expr)); break;
+	case EXPR_TYPE_BREAK: print_break(p, (uint8_t)AST_PAYLOAD(ast, expr)); break;
+	case EXPR_TYPE_CONTINUE: print_continue(p, (uint8_t)AST_PAYLOAD(ast, expr)); break;
+
+	case EXPR_TYPE_FUNC_DECL: print_func_decl(p, AST_FUNC_DECL(ast, expr)); break;
+	case EXPR_TYPE_FUNC_DEF: print_func_def(p, AST_FUNC_DEF(ast, expr)); break;
+
+	case EXPR_TYPE_IMPORT: print_import(p, AST_NAME(ast, expr)); break;
 
 	default: break;
 	}
 }
 
-void print_ast(AST_PRINTER* p, AST* ast) {
-	for (int i = 0; i < ast->num_expressions; i++) {
+void print_block(AST_PRINTER* p, NODE_LIST block) {
+	for (uint32_t i = 0; i < block.size; i++) {
 		indent(p);
-		print_expr(p, &ast->expressions[i]);
-		putchar('\n');
+		print_expr(p, AST_LIST_NODE(p->ast, block, i));
+		fputc('\n', p->out);
 	}
-}
\ No newline at end of file
+}
+
+void print_ast(AST_PRINTER* p, AST* ast) {
+	p->ast = ast;
+	print_block(p, ast->root);
+}
@@ -1,14 +1,17 @@
 #pragma once
 
+#include <stdio.h>
 #include <stdint.h>
 
 #include "ast.h"
 
 typedef struct AST_PRINTER_t {
+	FILE* out;
 	uint8_t indentation;
+	AST* ast;
 } AST_PRINTER;
 
-AST_PRINTER printer_new();
+AST_PRINTER printer_new(FILE* out);
 void printer_delete(AST_PRINTER* printer);
 
 void print_ast(AST_PRINTER* p, AST* ast);
\ No newline at end of file
@@ -0,0 +1,436 @@
+#include "resolve.h"
+
+#include <string.h>
+#include <stdarg.h>
+
+#include "operators.h"
+#include "stack.h"
+
+RESOLVER resolver_new(AST* ast, INPUTSTREAM* input) {
+	RESOLVER r;
+	r.ast = ast;
+	r.input = input;
+	r.num_errors = 0;
+	uint8_t subsystem = mem_enter(MEM_RESOLVER);
+	r.locals = symtab_new(64);
+	r.local_undo = symvec_new(64);
+	r.globals = symtab_new(64);
+	mem_leave(subsystem);
+	r.function = 0;
+	r.loop_depth = 0;
+	return r;
+}
+
+void resolver_delete(RESOLVER* r) {
+	symtab_delete(&r->locals);
+	symvec_delete(&r->local_undo);
+	symtab_delete(&r->globals);
+}
+
+void resolve_error(RESOLVER* r, NODE node, const char* msg, ...) {
+	va_list args;
+	va_start(args, msg);
+	input_error(r->input, msg, AST_OFFSET(r->ast, node), args);
+	va_end(args);
+	r->num_errors++;
+}
+
+uint32_t add_binding(RESOLVER* r, BINDING binding) {
+	bindvec_push(&r->ast->bindings, binding);
+	return (uint32_t)r->ast->bindings.size - 1;
+}
+
+void define_local(RESOLVER* r, char* name, uint32_t binding) {
+	uint32_t previous = symtab_put(&r->locals, name, binding);
+	symvec_push(&r->local_undo, (SYMBOL){ name, previous });
+}
+
+void scope_end(RESOLVER* r, long undo_start) {
+	while (r->local_undo.size > undo_start) {
+		SYMBOL undo = r->local_undo.buffer[--r->local_undo.size];
+		symtab_put(&r->locals, undo.name, undo.value);
+	}
+}
+
+// Locals of an enclosing function are not visible inside a function body
+uint32_t find_binding(RESOLVER* r, char* name) {
+	uint32_t binding = symtab_get(&r->locals, name);
+	if (binding && AST_BINDING(r->ast, binding)->owner == r->function) return binding;
+	return symtab_get(&r->globals, name);
+}
+
+TYPE_ID resolve_expr(RESOLVER* r, NODE node);
+
+// Variables that are written through their name or whose address is taken need a stack slot
+void mark_stored(RESOLVER* r, NODE node) {
+	AST* ast = r->ast;
+	while (AST_TYPE(ast, node) == EXPR_TYPE_COMPOUND_EXPR) node = AST_CHILD(ast, node);
+	if (AST_TYPE(ast, node) == EXPR_TYPE_IDENTIFIER && AST_BINDING_ID(ast, node)) AST_BINDING(ast, AST_BINDING_ID(ast, node))->needs_storage = true;
+}
+
+// Records that node is used as a value of type target
+void convert(RESOLVER* r, NODE node, TYPE_ID target) {
+	if (node == NODE_NULL) return; // already reported by the parser
+	AST* ast = r->ast;
+	TYPE_ID type = AST_VALUE_TYPE(ast, node);
+	uint8_t conversion = type_conversion(type, target);
+	if (conversion == CONV_INVALID) {
+		if (type == TYPE_VOID) resolve_error(r, node, "Expression has no value, %s expected", type_name(target));
+		else resolve_error(r, node, "Can't convert %s to %s", type_name(type), type_name(target));
+		return;
+	}
+	AST_TARGET_TYPE(ast, node) = target;
+	AST_CONVERSION(ast, node) = conversion;
+	if (conversion == CONV_ADDRESS) mark_stored(r, node);
+}
+
+// Expressions that already caused an error are not checked any further, to avoid follow-up errors
+TYPE_ID resolve_operand(RESOLVER* r, NODE node, TYPE_ID target) {
+	uint32_t num_errors = r->num_errors;
+	resolve_expr(r, node);
+	if (r->num_errors == num_errors) convert(r, node, target);
+	return target;
+}
+
+bool is_assignable(RESOLVER* r, NODE node) {
+	AST* ast = r->ast;
+	switch (AST_TYPE(ast, node)) {
+	case EXPR_TYPE_IDENTIFIER: return AST_BINDING_ID(ast, node) && AST_BINDING(ast, AST_BINDING_ID(ast, node))->kind != BINDING_FUNCTION;
+	case EXPR_TYPE_COMPOUND_EXPR: return is_assignable(r, AST_CHILD(ast, node));
+	case EXPR_TYPE_UNARY_OP: return AST_UNARY_OP(ast, node)->op == OP_MUL && !AST_UNARY_OP(ast, node)->position;
+	default: return false;
+	}
+}
+
+bool is_storable(TYPE_ID type) {
+	return type_is_numeric(type) || TYPE_KIND_OF(type) == TYPE_KIND_POINTER;
+}
+
+// Type both operands of a binary operator are converted to, TYPE_VOID if they have none
+TYPE_ID common_type(TYPE_ID a, TYPE_ID b) {
+	if (!type_is_numeric(a) || !type_is_numeric(b)) return TYPE_VOID;
+	TYPE_INFO* ia = TYPE_INFO_OF(a);
+	TYPE_INFO* ib = TYPE_INFO_OF(b);
+	if (ia->kind == TYPE_KIND_FLOAT && ib->kind != TYPE_KIND_FLOAT) return a;
+	if (ib->kind == TYPE_KIND_FLOAT && ia->kind != TYPE_KIND_FLOAT) return b;
+	return ia->bits >= ib->bits ? a : b;
+}
+
+bool is_comparison(uint8_t op) {
+	switch (op) {
+	case OP_LT: case OP_GT: case OP_LE: case OP_GE: case OP_EQ: case OP_NE: return true;
+	default: return false;
+	}
+}
+
+bool op_applies_to(uint8_t op, TYPE_ID type) {
+	uint8_t kind = TYPE_KIND_OF(type);
+	switch (op) {
+	case OP_AND: case OP_OR: return kind == TYPE_KIND_BOOL || kind == TYPE_KIND_INT;
+	default: return type_is_numeric(type);
+	}
+}
+
+TYPE_ID resolve_identifier(RESOLVER* r, NODE node) {
+	char* name = AST_NAME(r->ast, node);
+	uint32_t binding = find_binding(r, name);
+	if (!binding) {
+		resolve_error(r, node, "Unknown identifier '%s'", name);
+		return TYPE_VOID;
+	}
+	AST_BINDING_ID(r->ast, node) = binding;
+	return AST_BINDING(r->ast, binding)->type;
+}
+
+TYPE_ID resolve_assign(RESOLVER* r, NODE node, ASSIGN* assign) {
+	AST* ast = r->ast;
+	// Assigning to a name that is not bound yet defines a new local
+	if (assign->op == OP_ASSIGN && AST_TYPE(ast, assign->left) == EXPR_TYPE_IDENTIFIER && !find_binding(r, AST_NAME(ast, assign->left))) {
+		uint32_t num_errors = r->num_errors;
+		TYPE_ID type = resolve_expr(r, assign->right);
+		if (assign->right && r->num_errors == num_errors && !is_storable(type)) {
+			if (type == TYPE_VOID) resolve_error(r, assign->right, "Expression has no value");
+			else resolve_error(r, assign->right, "Can't store a value of type %s", type_name(type));
+		}
+		char* name = AST_NAME(ast, assign->left);
+		uint32_t binding = add_binding(r, (BINDING){ .name = name, .type = type, .kind = BINDING_LOCAL, .owner = r->function });
+		define_local(r, name, binding);
+		AST_BINDING_ID(ast, node) = binding;
+		AST_BINDING_ID(ast, assign->left) = binding;
+		AST_VALUE_TYPE(ast, assign->left) = type;
+		AST_TARGET_TYPE(ast, assign->left) = type;
+		return type;
+	}
+
+	uint32_t num_errors = r->num_errors;
+	TYPE_ID type = resolve_expr(r, assign->left);
+	if (r->num_errors != num_errors) {
+		resolve_expr(r, assign->right);
+		return TYPE_VOID;
+	}
+	if (!is_assignable(r, assign->left)) resolve_error(r, assign->left, "Can't assign to this expression");
+	mark_stored(r, assign->left);
+	// Compound assignments operate in the type of the variable
+	if (assign->op != OP_ASSIGN && !op_applies_to(OPERATORS[assign->op].assign_op, type)) {
+		resolve_error(r, node, "Operator '%s' can't be applied to %s", OPERATORS[assign->op].str, type_name(type));
+	}
+	resolve_operand(r, assign->right, type);
+	return type;
+}
+
+TYPE_ID resolve_binary_op(RESOLVER* r, NODE node, BINARY_OP* binary_op) {
+	uint32_t num_errors = r->num_errors;
+	TYPE_ID left = resolve_expr(r, binary_op->left);
+	TYPE_ID right = resolve_expr(r, binary_op->right);
+	if (!binary_op->left || !binary_op->right || r->num_errors != num_errors) return TYPE_VOID;
+	TYPE_ID type = common_type(left, right);
+	if (type == TYPE_VOID || !op_applies_to(binary_op->op, type)) {
+		resolve_error(r, node, "Operator '%s' can't be applied to %s and %s", OPERATORS[binary_op->op].str, type_name(left), type_name(right));
+		return TYPE_VOID;
+	}
+	convert(r, binary_op->left, type);
+	convert(r, binary_op->right, type);
+	return is_comparison(binary_op->op) ? TYPE_BOOL : type;
+}
+
+TYPE_ID resolve_unary_op(RESOLVER* r, NODE node, UNARY_OP* unary_op) {
+	uint32_t num_errors = r->num_errors;
+	TYPE_ID type = resolve_expr(r, unary_op->expr);
+	if (!unary_op->expr || r->num_errors != num_errors) return TYPE_VOID;
+	uint8_t kind = TYPE_KIND_OF(type);
+	if (unary_op->position && unary_op->op != OP_INC && unary_op->op != OP_DEC) {
+		resolve_error(r, node, "Operator '%s' can't be used as a postfix", OPERATORS[unary_op->op].str);
+		return TYPE_VOID;
+	}
+	switch (unary_op->op) {
+	case OP_MUL:
+		if (kind == TYPE_KIND_POINTER) return TYPE_INFO_OF(type)->element;
+		resolve_error(r, node, "Can't dereference a value of type %s", type_name(type));
+		return TYPE_VOID;
+	case OP_INC:
+	case OP_DEC:
+		if (kind == TYPE_KIND_INT && is_assignable(r, unary_op->expr)) {
+			mark_stored(r, unary_op->expr);
+			return type;
+		}
+		resolve_error(r, node, "Operator '%s' needs an integer variable", OPERATORS[unary_op->op].str);
+		return TYPE_VOID;
+	case OP_ADD:
+	case OP_SUB:
+		if (kind == TYPE_KIND_INT || kind == TYPE_KIND_FLOAT) return type;
+		resolve_error(r, node, "Operator '%s' can't be applied to %s", OPERATORS[unary_op->op].str, type_name(type));
+		return TYPE_VOID;
+	default:
+		resolve_error(r, node, "Operator '%s' can't be used as a prefix", OPERATORS[unary_op->op].str);
+		return TYPE_VOID;
+	}
+}
+
+TYPE_ID resolve_block(RESOLVER* r, NODE_LIST block) {
+	long undo_start = r->local_undo.size;
+	TYPE_ID type = TYPE_VOID;
+	for (uint32_t i = 0; i < block.size; i++) type = resolve_expr(r, AST_LIST_NODE(r->ast, block, i));
+	scope_end(r, undo_start);
+	return type;
+}
+
+TYPE_ID resolve_return(RESOLVER* r, NODE value) {
+	TYPE_ID return_type = r->function ? TYPE_INFO_OF(AST_BINDING(r->ast, r->function)->type)->element : TYPE_I32;
+	if (value) resolve_operand(r, value, return_type);
+	return TYPE_VOID;
+}
+
+// Branches and loop bodies are scopes even without braces, so every variable is defined before all of its uses
+TYPE_ID resolve_scoped(RESOLVER* r, NODE node) {
+	long undo_start = r->local_undo.size;
+	TYPE_ID type = resolve_expr(r, node);
+	scope_end(r, undo_start);
+	return type;
+}
+
+// An if only has a value if both branches have one of the same type
+TYPE_ID resolve_if_statement(RESOLVER* r, IF* if_statement) {
+	resolve_operand(r, if_statement->condition, TYPE_BOOL);
+	TYPE_ID then_type = resolve_scoped(r, if_statement->then_block);
+	if (!if_statement->else_block) return TYPE_VOID;
+	TYPE_ID else_type = resolve_scoped(r, if_statement->else_block);
+	return then_type == else_type ? then_type : TYPE_VOID;
+}
+
+TYPE_ID resolve_loop(RESOLVER* r, LOOP* loop) {
+	if (loop->condition) resolve_operand(r, loop->condition, TYPE_BOOL);
+	r->loop_depth++;
+	resolve_scoped(r, loop->body);
+	r->loop_depth--;
+	return TYPE_VOID;
+}
+
+TYPE_ID resolve_jump(RESOLVER* r, NODE node, uint8_t idx, const char* keyword) {
+	if (r->loop_depth == 0) resolve_error(r, node, "'%s' outside of a loop", keyword);
+	else if (idx >= r->loop_depth) resolve_error(r, node, "'%s(%d)' exceeds the loop depth of %d", keyword, idx, r->loop_depth);
+	return TYPE_VOID;
+}
+
+TYPE_ID resolve_func_call(RESOLVER* r, NODE node, FUNC_CALL* func_call) {
+	AST* ast = r->ast;
+	// A call of a type name is a conversion, the callee gets no type and codegen only converts the argument
+	if (AST_TYPE(ast, func_call->callee) == EXPR_TYPE_IDENTIFIER) {
+		TYPE_ID cast_type = type_from_name(AST_NAME(ast, func_call->callee));
+		if (cast_type != TYPE_VOID) {
+			if (func_call->args.size != 1) {
+				resolve_error(r, node, "Conversion to %s takes one argument", type_name(cast_type));
+				return TYPE_VOID;
+			}
+			return resolve_operand(r, AST_LIST_NODE(ast, func_call->args, 0), cast_type);
+		}
+	}
+
+	uint32_t num_errors = r->num_errors;
+	TYPE_ID type = resolve_expr(r, func_call->callee);
+	for (uint32_t i = 0; i < func_call->args.size; i++) resolve_expr(r, AST_LIST_NODE(ast, func_call->args, i));
+	if (!func_call->callee || r->num_errors != num_errors) return TYPE_VOID;
+	TYPE_INFO* func_type = TYPE_INFO_OF(type);
+	if (func_type->kind != TYPE_KIND_FUNCTION) {
+		resolve_error(r, node, "Expression of type %s is not callable", type_name(type));
+		return TYPE_VOID;
+	}
+	if (func_call->args.size != func_type->num_params) {
+		resolve_error(r, node, "Function of type %s takes %d arguments, %d given", type_name(type), func_type->num_params, func_call->args.size);
+		return func_type->element;
+	}
+	for (uint32_t i = 0; i < func_call->args.size; i++) convert(r, AST_LIST_NODE(ast, func_call->args, i), func_type->params[i]);
+	return func_type->element;
+}
+
+// Declarations of the same function in one module share a binding
+uint32_t declare_function(RESOLVER* r, NODE node, FUNC_DECL* func_decl) {
+	TYPE_ID params[256];
+	for (int i = 0; i < func_decl->num_args; i++) {
+		TYPE* type = &func_decl->args[i].type;
+		TYPE_ID param = type->name ? type_from_name(type->name) : TYPE_VOID;
+		if (param == TYPE_VOID) {
+			resolve_error(r, node, "Unknown type '%s'", type->name ? type->name : "");
+			param = TYPE_I64;
+		}
+		params[i] = type->cpy ? param : type_pointer(param);
+	}
+	TYPE_ID type = type_function(TYPE_I32, params, func_decl->num_args);
+
+	uint32_t binding = symtab_get(&r->globals, func_decl->funcname);
+	if (binding) {
+		if (AST_BINDING(r->ast, binding)->type != type) {
+			resolve_error(r, node, "'%s' was declared as %s before", func_decl->funcname, type_name(AST_BINDING(r->ast, binding)->type));
+		}
+	} else {
+		binding = add_binding(r, (BINDING){ .name = func_decl->funcname, .type = type, .kind = BINDING_FUNCTION });
+		symtab_put(&r->globals, func_decl->funcname, binding);
+	}
+	AST_BINDING_ID(r->ast, node) = binding;
+	return binding;
+}
+
+TYPE_ID resolve_func_decl(RESOLVER* r, NODE node, FUNC_DECL* func_decl) {
+	return AST_BINDING(r->ast, declare_function(r, node, func_decl))->type;
+}
+
+TYPE_ID resolve_func_def(RESOLVER* r, NODE node, FUNC_DEF* func_def) {
+	uint32_t binding = declare_function(r, node, &func_def->decl);
+	if (AST_BINDING(r->ast, binding)->first_param) {
+		resolve_error(r, node, "'%s' is already defined", func_def->decl.funcname);
+		return AST_BINDING(r->ast, binding)->type;
+	}
+	TYPE_ID type = AST_BINDING(r->ast, binding)->type;
+
+	uint32_t parent_function = r->function;
+	uint8_t parent_loop_depth = r->loop_depth;
+	r->function = binding;
+	r->loop_depth = 0;
+	long undo_start = r->local_undo.size;
+
+	// Parameters are bound to the type of their value, by reference parameters are pointers only in the function type
+	AST_BINDING(r->ast, binding)->first_param = (uint32_t)r->ast->bindings.size;
+	for (int i = 0; i < func_def->decl.num_args; i++) {
+		TYPE_ID param = TYPE_INFO_OF(type)->params[i];
+		bool by_reference = TYPE_KIND_OF(param) == TYPE_KIND_POINTER;
+		if (by_reference) param = TYPE_INFO_OF(param)->element;
+		char* name = func_def->decl.args[i].name;
+		uint32_t param_binding = add_binding(r, (BINDING){ .name = name, .type = param, .kind = BINDING_PARAM, .owner = binding, .needs_storage = by_reference });
+		if (name) define_local(r, name, param_binding);
+	}
+	resolve_expr(r, func_def->body);
+
+	scope_end(r, undo_start);
+	r->function = parent_function;
+	r->loop_depth = parent_loop_depth;
+	return type;
+}
+
+TYPE_ID resolve_node(RESOLVER* r, NODE node) {
+	AST* ast = r->ast;
+	switch (AST_TYPE(ast, node)) {
+	case EXPR_TYPE_INT_LITERAL: return TYPE_I64;
+	case EXPR_TYPE_CHAR_LITERAL: return TYPE_I8;
+	case EXPR_TYPE_BOOL_LITERAL: return TYPE_BOOL;
+	case EXPR_TYPE_FLOAT_LITERAL: return TYPE_F64;
+	case EXPR_TYPE_STRING_LITERAL: return TYPE_STRING;
+	case EXPR_TYPE_IDENTIFIER: return resolve_identifier(r, node);
+	case EXPR_TYPE_COMPOUND_EXPR: return resolve_expr(r, AST_CHILD(ast, node));
+
+	case EXPR_TYPE_ASSIGN: return resolve_assign(r, node, AST_ASSIGN(ast, node));
+	case EXPR_TYPE_BINARY_OP: return resolve_binary_op(r, node, AST_BINARY_OP(ast, node));
+	case EXPR_TYPE_UNARY_OP: return resolve_unary_op(r, node, AST_UNARY_OP(ast, node));
+	case EXPR_TYPE_COMPOUND: return resolve_block(r, AST_BLOCK(ast, node));
+	case EXPR_TYPE_RETURN: return resolve_return(r, AST_CHILD(ast, node));
+	case EXPR_TYPE_IF_STATEMENT: return resolve_if_statement(r, AST_IF(ast, node));
+	case EXPR_TYPE_LOOP: return resolve_loop(r, AST_LOOP(ast, node));
+	case EXPR_TYPE_BREAK: return resolve_jump(r, node, (uint8_t)AST_PAYLOAD(ast, node), "break");
+	case EXPR_TYPE_CONTINUE: return resolve_jump(r, node, (uint8_t)AST_PAYLOAD(ast, node), "continue");
+	case EXPR_TYPE_FUNC_CALL: return resolve_func_call(r, node, AST_FUNC_CALL(ast, node));
+
+	case EXPR_TYPE_FUNC_DECL: return resolve_func_decl(r, node, AST_FUNC_DECL(ast, node));
+	case EXPR_TYPE_FUNC_DEF: return resolve_func_def(r, node, AST_FUNC_DEF(ast, node));
+
+	default: return TYPE_VOID;
+	}
+}
+
+typedef struct RESOLVE_EXPR_CALL_t {
+	RESOLVER* r;
+	NODE node;
+	TYPE_ID result;
+} RESOLVE_EXPR_CALL;
+
+void resolve_expr_continuation(void* arg) {
+	RESOLVE_EXPR_CALL* call = arg;
+	call->result = resolve_expr(call->r, call->node);
+}
+
+// Until a user converts it, a node is used as a value of its own type
+TYPE_ID resolve_expr(RESOLVER* r, NODE node) {
+	if (stack_low()) {
+		RESOLVE_EXPR_CALL call = { r, node, TYPE_VOID };
+		stack_grow_call(resolve_expr_continuation, &call);
+		return call.result;
+	}
+	if (node == NODE_NULL) return TYPE_VOID;
+	TYPE_ID type = resolve_node(r, node);
+	AST_VALUE_TYPE(r->ast, node) = type;
+	AST_TARGET_TYPE(r->ast, node) = type;
+	AST_CONVERSION(r->ast, node) = CONV_NONE;
+	return type;
+}
+
+bool resolve_module(RESOLVER* r) {
+	AST* ast = r->ast;
+	uint8_t subsystem = mem_enter(MEM_RESOLVER);
+	ast->value_types = mem_calloc(ast->num_nodes, sizeof(TYPE_ID));
+	ast->target_types = mem_calloc(ast->num_nodes, sizeof(TYPE_ID));
+	ast->conversions = mem_calloc(ast->num_nodes, sizeof(uint8_t));
+	ast->node_bindings = mem_calloc(ast->num_nodes, sizeof(uint32_t));
+	ast->bindings = bindvec_new(64);
+	add_binding(r, (BINDING){ 0 });
+
+	resolve_block(r, ast->root);
+	mem_leave(subsystem);
+	return r->num_errors == 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ast.h"
+#include "input.h"
+#include "symtab.h"
+
+// Resolution pass between parsing and codegen. It binds every identifier to its declaration, computes the type
+// of every node and the conversions between them and reports all errors, so codegen only lowers a checked AST.
+
+typedef struct RESOLVER_t {
+	AST* ast;
+	INPUTSTREAM* input; // for error locations
+	uint32_t num_errors;
+
+	// Innermost binding of every local name, shadowed bindings are restored from local_undo when their scope ends
+	SYMBOL_TABLE locals;
+	SYMBOL_VEC local_undo;
+	SYMBOL_TABLE globals;
+
+	uint32_t function; // binding of the function whose body is resolved, 0 at module level
+	uint8_t loop_depth;
+} RESOLVER;
+
+RESOLVER resolver_new(AST* ast, INPUTSTREAM* input);
+void resolver_delete(RESOLVER* r);
+
+// Annotates the AST, returns false if there were errors
+bool resolve_module(RESOLVER* r);
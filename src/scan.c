@@ -0,0 +1,207 @@
+#include "scan.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+int ctz32(uint32_t x) {
+	unsigned long i;
+	_BitScanForward(&i, x);
+	return (int)i;
+}
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define ctz32(x) __builtin_ctz(x)
+#endif
+
+SCANNER scanner;
+
+const char* SCAN_LEVEL_NAMES[NUM_SCAN_LEVELS] = {
+	[SCAN_SCALAR] = "scalar",
+	[SCAN_SSE2] = "sse2",
+	[SCAN_AVX2] = "avx2",
+};
+
+bool is_identifier_char(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+const char* scan_identifier_scalar(const char* p, const char* end) {
+	while (p < end && is_identifier_char(*p)) p++;
+	return p;
+}
+
+const char* scan_whitespace_scalar(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+	return p;
+}
+
+const char* scan_line_end_scalar(const char* p, const char* end) {
+	while (p < end && *p != '\n') p++;
+	return p;
+}
+
+const char* scan_block_comment_end_scalar(const char* p, const char* end) {
+	while (p + 1 < end && (p[0] != '*' || p[1] != '/')) p++;
+	return p + 1 < end ? p : end;
+}
+
+uint32_t* line_starts_scalar(const char* p, const char* end, const char* base, uint32_t* out) {
+	for (; p < end; p++) {
+		if (*p == '\n') *out++ = (uint32_t)(p + 1 - base);
+	}
+	return out;
+}
+
+// memchr is already vectorized by the C library
+const char* scan_line_end_memchr(const char* p, const char* end) {
+	const char* nl = memchr(p, '\n', end - p);
+	return nl ? nl : end;
+}
+
+#ifdef SCAN_X86
+
+// Signed byte compares work for the ASCII ranges because bytes >= 0x80 compare as negative
+#define SSE2_IN_RANGE(v, lo, hi) _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((lo) - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8((hi) + 1)))
+
+const char* scan_identifier_sse2(const char* p, const char* end) {
+	for (; p + 16 <= end; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		__m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		__m128i match = _mm_or_si128(_mm_or_si128(SSE2_IN_RANGE(lower, 'a', 'z'), SSE2_IN_RANGE(v, '0', '9')), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+		uint32_t mask = ~(uint32_t)_mm_movemask_epi8(match) & 0xFFFF;
+		if (mask) return p + ctz32(mask);
+	}
+	return scan_identifier_scalar(p, end);
+}
+
+const char* scan_whitespace_sse2(const char* p, const char* end) {
+	for (; p + 16 <= end; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		__m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+		uint32_t mask = ~(uint32_t)_mm_movemask_epi8(match) & 0xFFFF;
+		if (mask) return p + ctz32(mask);
+	}
+	return scan_whitespace_scalar(p, end);
+}
+
+const char* scan_block_comment_end_sse2(const char* p, const char* end) {
+	for (; p + 17 <= end; p += 16) {
+		__m128i star = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi8('*'));
+		__m128i slash = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 1)), _mm_set1_epi8('/'));
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(star, slash));
+		if (mask) return p + ctz32(mask);
+	}
+	return scan_block_comment_end_scalar(p, end);
+}
+
+uint32_t* line_starts_sse2(const char* p, const char* end, const char* base, uint32_t* out) {
+	for (; p + 16 <= end; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+		uint32_t offset = (uint32_t)(p + 1 - base);
+		for (; mask; mask &= mask - 1) *out++ = offset + ctz32(mask);
+	}
+	return line_starts_scalar(p, end, base, out);
+}
+
+// The AVX2 scanners clear the upper register halves before returning to SSE or scalar code,
+// otherwise every following legacy SSE instruction pays for the AVX/SSE state transition
+#define AVX2_IN_RANGE(v, lo, hi) _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((lo) - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8((hi) + 1), v))
+
+TARGET_AVX2 const char* scan_identifier_avx2(const char* p, const char* end) {
+	for (; p + 32 <= end; p += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		__m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+		__m256i match = _mm256_or_si256(_mm256_or_si256(AVX2_IN_RANGE(lower, 'a', 'z'), AVX2_IN_RANGE(v, '0', '9')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+		uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(match);
+		if (mask) {
+			_mm256_zeroupper();
+			return p + ctz32(mask);
+		}
+	}
+	_mm256_zeroupper();
+	return scan_identifier_sse2(p, end);
+}
+
+TARGET_AVX2 const char* scan_whitespace_avx2(const char* p, const char* end) {
+	for (; p + 32 <= end; p += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		__m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+		uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(match);
+		if (mask) {
+			_mm256_zeroupper();
+			return p + ctz32(mask);
+		}
+	}
+	_mm256_zeroupper();
+	return scan_whitespace_sse2(p, end);
+}
+
+TARGET_AVX2 const char* scan_block_comment_end_avx2(const char* p, const char* end) {
+	for (; p + 33 <= end; p += 32) {
+		__m256i star = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), _mm256_set1_epi8('*'));
+		__m256i slash = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 1)), _mm256_set1_epi8('/'));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(star, slash));
+		if (mask) {
+			_mm256_zeroupper();
+			return p + ctz32(mask);
+		}
+	}
+	_mm256_zeroupper();
+	return scan_block_comment_end_sse2(p, end);
+}
+
+TARGET_AVX2 uint32_t* line_starts_avx2(const char* p, const char* end, const char* base, uint32_t* out) {
+	for (; p + 32 <= end; p += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+		uint32_t offset = (uint32_t)(p + 1 - base);
+		for (; mask; mask &= mask - 1) *out++ = offset + ctz32(mask);
+	}
+	_mm256_zeroupper();
+	return line_starts_sse2(p, end, base, out);
+}
+
+#endif
+
+const SCANNER SCANNERS[NUM_SCAN_LEVELS] = {
+	[SCAN_SCALAR] = { SCAN_SCALAR, scan_identifier_scalar, scan_whitespace_scalar, scan_line_end_scalar, scan_block_comment_end_scalar, line_starts_scalar },
+#ifdef SCAN_X86
+	[SCAN_SSE2] = { SCAN_SSE2, scan_identifier_sse2, scan_whitespace_sse2, scan_line_end_memchr, scan_block_comment_end_sse2, line_starts_sse2 },
+	[SCAN_AVX2] = { SCAN_AVX2, scan_identifier_avx2, scan_whitespace_avx2, scan_line_end_memchr, scan_block_comment_end_avx2, line_starts_avx2 },
+#endif
+};
+
+bool scan_supported(uint8_t level) {
+	if (level >= NUM_SCAN_LEVELS || !SCANNERS[level].identifier) return false;
+	if (level == SCAN_AVX2) {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#elif defined(SCAN_X86)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+	return true;
+}
+
+bool scan_select(uint8_t level) {
+	if (!scan_supported(level)) return false;
+	scanner = SCANNERS[level];
+	return true;
+}
+
+void scan_init() {
+	for (int level = NUM_SCAN_LEVELS - 1; level >= 0; level--) {
+		if (scan_select(level)) return;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bulk scanners used by the lexer. Every scanner reads [p, end) and returns a pointer to the first
+// byte that doesn't belong to the run, or end. The vector versions only load whole blocks that lie
+// before end and finish the tail with the scalar code, so they never read past the buffer.
+
+enum SCAN_LEVEL {
+	SCAN_SCALAR,
+	SCAN_SSE2,
+	SCAN_AVX2,
+
+	NUM_SCAN_LEVELS
+};
+
+typedef struct SCANNER_t {
+	uint8_t level;
+	const char* (*identifier)(const char* p, const char* end);
+	const char* (*whitespace)(const char* p, const char* end); // ' ', '\t' and '\r'
+	const char* (*line_end)(const char* p, const char* end); // first '\n'
+	const char* (*block_comment_end)(const char* p, const char* end); // first "*/"
+	// Writes the offset from base of the byte after every '\n' to out and returns the end of the written entries,
+	// out needs room for one entry per byte of the range
+	uint32_t* (*line_starts)(const char* p, const char* end, const char* base, uint32_t* out);
+} SCANNER;
+
+extern SCANNER scanner;
+extern const char* SCAN_LEVEL_NAMES[NUM_SCAN_LEVELS];
+
+// Selects the best level the CPU supports
+void scan_init();
+bool scan_supported(uint8_t level);
+// Returns false and keeps the current scanner if the level is not supported
+bool scan_select(uint8_t level);
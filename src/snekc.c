@@ -2,74 +2,413 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
 
 #include "file.h"
+#include "intern.h"
 #include "input.h"
+#include "scan.h"
+#include "stack.h"
 #include "lexer.h"
 #include "parser.h"
+#include "resolve.h"
 #include "printer.h"
 #include "gen.h"
+#include "thread.h"
+#include "stats.h"
+#include "alloc.h"
 
-void test_lexer(LEXER* l) {
-	printf("### TOKENS ###\n");
-	while (!lexer_eof(l)) {
-		TOKEN token = lexer_next(l);
-		printf("%d: %s\n", token.type, token.value);
+const char* EMIT_NAMES[NUM_EMIT_KINDS] = { "tokens", "ast", "llvm", "bc", "asm", "obj", "exe" };
+
+// Dumps and diagnostics go through full buffers instead of being written line by line
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+void dump_tokens(FILE* out, TOKEN_VEC* tokens) {
+	fputs("### TOKENS ###\n", out);
+	for (int i = 0; tokens->buffer[i].type != TOKEN_TYPE_NULL; i++) {
+		TOKEN token = tokens->buffer[i];
+		fprintf(out, "%d: %.*s\n", token.type, (int)token.len, token.value);
 	}
-	putchar('\n');
+	fputc('\n', out);
 }
 
-void test_parser(AST* ast) {
-	printf("### AST ###\n");
-	AST_PRINTER printer = printer_new();
+void dump_ast(FILE* out, AST* ast) {
+	fputs("### AST ###\n", out);
+	AST_PRINTER printer = printer_new(out);
 	print_ast(&printer, ast);
 	printer_delete(&printer);
+	size_t ast_size = ast_memory_size(ast);
+	fprintf(out, "# %u nodes, %zu bytes (%.1f bytes/node)\n", ast->num_nodes, ast_size, (double)ast_size / ast->num_nodes);
+	fputc('\n', out);
+}
+
+// Tokenizes the source repeatedly with every scanner the CPU supports
+void bench_lexer(char* filepath, SOURCE_FILE* source) {
+	printf("### LEXER BENCHMARK ###\n%s: %zu bytes\n", filepath, source->size);
+	uint8_t selected = scanner.level;
+	for (uint8_t level = 0; level < NUM_SCAN_LEVELS; level++) {
+		if (!scan_select(level)) continue;
+		int runs = 0;
+		long num_tokens = 0;
+		double elapsed = 0.0;
+		while (elapsed < 0.5 && runs < 1000) {
+			INPUTSTREAM input = input_new(source->data, (uint32_t)source->size);
+			LEXER lexer = lexer_new(&input);
+			double start = time_now();
+			num_tokens = lexer_tokenize(&lexer)->size;
+			elapsed += time_now() - start;
+			runs++;
+			lexer_delete(&lexer);
+			input_delete(&input);
+		}
+		printf("%-8s %10.1f MB/s  (%ld tokens, %d runs)\n", SCAN_LEVEL_NAMES[level], (double)source->size * runs / elapsed / 1e6, num_tokens, runs);
+	}
+	scan_select(selected);
 	putchar('\n');
 }
 
+// Visits every node reachable from the root with an explicit stack, the traversal measured by bench_parser
+uint64_t walk_ast(AST* ast, NODE_VEC* stack) {
+	uint64_t checksum = 0;
+	stack->size = 0;
+	for (uint32_t i = 0; i < ast->root.size; i++) nodevec_push(stack, AST_LIST_NODE(ast, ast->root, i));
+	while (stack->size) {
+		NODE node = stack->buffer[--stack->size];
+		if (node == NODE_NULL) continue;
+		checksum += AST_TYPE(ast, node);
+		switch (AST_TYPE(ast, node)) {
+		case EXPR_TYPE_COMPOUND_EXPR:
+		case EXPR_TYPE_RETURN: nodevec_push(stack, AST_CHILD(ast, node)); break;
+		case EXPR_TYPE_ASSIGN: nodevec_push(stack, AST_ASSIGN(ast, node)->left); nodevec_push(stack, AST_ASSIGN(ast, node)->right); break;
+		case EXPR_TYPE_BINARY_OP: nodevec_push(stack, AST_BINARY_OP(ast, node)->left); nodevec_push(stack, AST_BINARY_OP(ast, node)->right); break;
+		case EXPR_TYPE_UNARY_OP: nodevec_push(stack, AST_UNARY_OP(ast, node)->expr); break;
+		case EXPR_TYPE_COMPOUND: {
+			NODE_LIST block = AST_BLOCK(ast, node);
+			for (uint32_t i = 0; i < block.size; i++) nodevec_push(stack, AST_LIST_NODE(ast, block, i));
+			break;
+		}
+		case EXPR_TYPE_IF_STATEMENT: {
+			IF* if_statement = AST_IF(ast, node);
+			nodevec_push(stack, if_statement->condition);
+			nodevec_push(stack, if_statement->then_block);
+			nodevec_push(stack, if_statement->else_block);
+			break;
+		}
+		case EXPR_TYPE_LOOP: nodevec_push(stack, AST_LOOP(ast, node)->condition); nodevec_push(stack, AST_LOOP(ast, node)->body); break;
+		case EXPR_TYPE_FUNC_CALL: {
+			FUNC_CALL* call = AST_FUNC_CALL(ast, node);
+			nodevec_push(stack, call->callee);
+			for (uint32_t i = 0; i < call->args.size; i++) nodevec_push(stack, AST_LIST_NODE(ast, call->args, i));
+			break;
+		}
+		case EXPR_TYPE_FUNC_DEF: nodevec_push(stack, AST_FUNC_DEF(ast, node)->body); break;
+		}
+	}
+	return checksum;
+}
+
+// Parses the token array of the source repeatedly, then walks the last AST repeatedly
+void bench_parser(char* filepath, SOURCE_FILE* source) {
+	printf("### PARSER BENCHMARK ###\n%s: %zu bytes\n", filepath, source->size);
+	INPUTSTREAM input = input_new(source->data, (uint32_t)source->size);
+	LEXER lexer = lexer_new(&input);
+	long num_tokens = lexer_tokenize(&lexer)->size;
+	int runs = 0;
+	double elapsed = 0.0;
+	ARENA arena = arena_new(64 * 1024);
+	AST ast = { 0 };
+	while (elapsed < 0.5 && runs < 1000) {
+		if (runs) {
+			ast_delete(&ast);
+			arena_delete(&arena);
+			arena = arena_new(64 * 1024);
+		}
+		PARSER parser = parser_new(&lexer, &arena);
+		double start = time_now();
+		ast = parse_ast(&parser);
+		elapsed += time_now() - start;
+		runs++;
+		parser_delete(&parser);
+	}
+	printf("%10.1f MB/s  %8.1f Mtokens/s  (%ld tokens, %u nodes, %d runs)\n", (double)source->size * runs / elapsed / 1e6, (double)num_tokens * runs / elapsed / 1e6, num_tokens, ast.num_nodes, runs);
+
+	NODE_VEC stack = nodevec_new(64);
+	uint64_t checksum = 0;
+	int walks = 0;
+	elapsed = 0.0;
+	while (elapsed < 0.5 && walks < 100000) {
+		double start = time_now();
+		checksum += walk_ast(&ast, &stack);
+		elapsed += time_now() - start;
+		walks++;
+	}
+	// The checksum keeps the walks from being optimized away
+	printf("AST %.1f bytes/node, walk %.2f ns/node  (%d walks, checksum %llu)\n\n", (double)ast_memory_size(&ast) / ast.num_nodes, elapsed / walks / ast.num_nodes * 1e9, walks, (unsigned long long)(checksum / walks));
+	nodevec_delete(&stack);
+	ast_delete(&ast);
+	arena_delete(&arena);
+	lexer_delete(&lexer);
+	input_delete(&input);
+}
+
 char* get_name_from_path(char* path) {
 	char* c = strrchr(path, '/');
 	char* filename = c ? c + 1 : path;
-	char* module_name = malloc(strlen(filename) + 1);
-	int last_fullstop = -1;
-	for (int i = 0; i < strlen(filename); i++) if (filename[i] == '.') { last_fullstop = i; break; }
-	int len = last_fullstop >= 0 ? last_fullstop : strlen(filename);
-	memcpy(module_name, filename, len);
-	module_name[len] = 0;
-	return module_name;
+	// The module name ends at the first full stop
+	char* fullstop = strchr(filename, '.');
+	long len = fullstop ? (long)(fullstop - filename) : (long)strlen(filename);
+	return intern(filename, len);
+}
+
+// One source file on its way through the front end. Files are loaded, lexed and parsed in parallel,
+// everything that depends on other modules or prints happens afterwards in argument order.
+typedef struct FRONTEND_JOB_t {
+	char* filepath;
+	char* name; // of the module
+	SOURCE_FILE source;
+	int load_error; // errno of load_file
+	bool loaded;
+	INPUTSTREAM input;
+	LEXER lexer;
+	bool parse; // only tokens are emitted otherwise
+	ARENA arena;
+	AST ast;
+} FRONTEND_JOB;
+
+void parse_file(void* arg, long index) {
+	FRONTEND_JOB* job = (FRONTEND_JOB*)arg + index;
+	job->name = strcmp(job->filepath, "-") == 0 ? intern_str("stdin") : get_name_from_path(job->filepath);
+	double start = stats_begin();
+	if (!load_file(job->filepath, &job->source)) {
+		job->load_error = errno;
+		return;
+	}
+	job->loaded = true;
+	stats_end(PHASE_LOAD, job->name, start, job->source.size);
+	if (job->source.size > MAX_SOURCE_SIZE) return;
+
+	start = stats_begin();
+	job->input = input_new(job->source.data, (uint32_t)job->source.size);
+	job->lexer = lexer_new(&job->input);
+	stats_end(PHASE_LEX, job->name, start, lexer_tokenize(&job->lexer)->size);
+	if (!job->parse) return;
+
+	start = stats_begin();
+	job->arena = arena_new(64 * 1024);
+	PARSER parser = parser_new(&job->lexer, &job->arena);
+	job->ast = parse_ast(&parser);
+	parser_delete(&parser);
+	stats_end(PHASE_PARSE, job->name, start, job->ast.num_nodes);
+}
+
+// Every argument starting with '-' is an option, except "-" which reads the source from stdin
+bool is_option(char* arg) {
+	return arg[0] == '-' && arg[1];
+}
+
+// Adds the kinds of a comma separated list to emit, prints the unknown ones
+void parse_emit_list(char* list, uint8_t* emit) {
+	while (*list) {
+		size_t len = strcspn(list, ",");
+		uint8_t kind = 0;
+		while (kind < NUM_EMIT_KINDS && (strlen(EMIT_NAMES[kind]) != len || strncmp(list, EMIT_NAMES[kind], len) != 0)) kind++;
+		if (kind < NUM_EMIT_KINDS) *emit |= EMIT_FLAG(kind);
+		else printf("Unknown output '%.*s', expected tokens, ast, llvm, bc, asm, obj or exe\n", (int)len, list);
+		list += len + (list[len] == ',');
+	}
+}
+
+// Text outputs go to stdout, except for the last one which -o redirects to a file
+FILE* open_text_output(CODEGEN* g, uint8_t kind) {
+	if (!(g->emit & EMIT_FLAG(kind))) return NULL;
+	if (!g->output_path || g->emit >= EMIT_FLAG(kind + 1)) return stdout;
+	FILE* file = fopen(g->output_path, "w");
+	if (!file) {
+		printf("Can't write '%s': %s\n", g->output_path, strerror(errno));
+		return stdout;
+	}
+	setvbuf(file, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+	return file;
 }
 
 int main(int argc, char** argv) {
+	// The allocator has to be chosen before the first allocation
+	bool mem_report = false, leak_check = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--mem-report") == 0) mem_report = true;
+		else if (strcmp(argv[i], "--leak-check") == 0) leak_check = true;
+	}
+	mem_init(mem_report || leak_check ? &TRACKING_ALLOCATOR : &SYSTEM_ALLOCATOR);
+	// 1 MB is the smallest default main thread stack of the supported platforms
+	stack_init(1024 * 1024);
+	stats_init();
+	intern_init();
+	types_init();
+	lexer_init();
+	scan_init();
+
+	setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
 	CODEGEN gen = gen_new();
+	STRING_VEC input_files = strvec_new(4);
+	uint8_t emit = 0;
+	int num_threads = 0;
+	bool bench_lexer_enabled = false, bench_parser_enabled = false;
+	bool time_report = false;
+	char* stats_json_path = NULL;
+	char* time_trace_path = NULL;
 	for (int i = 1; i < argc; i++) {
-		char* filepath = argv[i];
-		char* name = get_name_from_path(filepath);
-		char* source = load_file(filepath);
-		INPUTSTREAM input = input_new(source);
+		char* arg = argv[i];
+		if (!is_option(arg)) {
+			strvec_push(&input_files, arg);
+			continue;
+		}
+		if (arg[1] == 'O') {
+			if (arg[2] >= '0' && arg[2] <= '3' && !arg[3]) gen.opt_level = arg[2] - '0';
+			else printf("Unknown optimization level '%s', expected -O0 to -O3\n", arg);
+		}
+		else if (arg[1] == 'j') {
+			// -jN or -j N, also the number of partitions the linked program is compiled in
+			char* count = arg[2] || i + 1 == argc ? arg + 2 : argv[++i];
+			num_threads = atoi(count);
+			if (num_threads < 1) printf("Invalid thread count '%s', expected -j followed by a positive number\n", count);
+			else gen.num_partitions = num_threads;
+		}
+		else if (arg[1] == 'o') {
+			char* path = arg[2] || i + 1 == argc ? arg + 2 : argv[++i];
+			if (*path) gen.output_path = path;
+			else printf("Missing output path after -o\n");
+		}
+		else if (strncmp(arg, "--emit=", 7) == 0) parse_emit_list(arg + 7, &emit);
+		else if (strcmp(arg, "--run") == 0) gen.run = true;
+		else if (strcmp(arg, "--time-report") == 0) time_report = true;
+		else if (strncmp(arg, "--stats-json=", 13) == 0) stats_json_path = arg + 13;
+		else if (strncmp(arg, "--time-trace=", 13) == 0) time_trace_path = arg + 13;
+		else if (strcmp(arg, "--mem-report") == 0 || strcmp(arg, "--leak-check") == 0) continue;
+		else if (strncmp(arg, "--passes=", 9) == 0) gen.passes = arg + 9;
+		else if (strcmp(arg, "--lto") == 0 || strcmp(arg, "--lto=full") == 0) gen.lto = LTO_FULL;
+		else if (strcmp(arg, "--lto=thin") == 0) gen.lto = LTO_THIN;
+		else if (strcmp(arg, "--bench-lexer") == 0) bench_lexer_enabled = true;
+		else if (strcmp(arg, "--bench-parser") == 0) bench_parser_enabled = true;
+		else if (strncmp(arg, "--scan=", 7) == 0) {
+			uint8_t level = 0;
+			while (level < NUM_SCAN_LEVELS && strcmp(arg + 7, SCAN_LEVEL_NAMES[level]) != 0) level++;
+			if (!scan_select(level)) printf("Scanner '%s' is not supported, using '%s'\n", arg + 7, SCAN_LEVEL_NAMES[scanner.level]);
+		} else printf("Unknown option '%s'\n", arg);
+	}
 
-		LEXER lexer = lexer_new(&input);
-		test_lexer(&lexer);
-		input_reset(&input);
+	bool bench = bench_lexer_enabled || bench_parser_enabled;
+	stats.enabled = time_report || stats_json_path || time_trace_path;
+	if (gen.run) emit |= EMIT_FLAG(EMIT_EXE);
+	if (emit) gen.emit = emit;
+	FILE* tokens_out = open_text_output(&gen, EMIT_TOKENS);
+	FILE* ast_out = open_text_output(&gen, EMIT_AST);
+	gen.llvm_out = open_text_output(&gen, EMIT_LLVM);
+	gen.asm_out = open_text_output(&gen, EMIT_ASM);
 
-		PARSER parser = parser_new(&lexer);
-		AST ast = parse_ast(&parser);
-		strvec_push(&gen.module_name_vec, name);
-		astvec_push(&gen.module_ast_vec, ast);
-		test_parser(&ast);
+	// The main thread works on every batch too
+	THREAD_POOL* pool = pool_new((num_threads > 0 ? num_threads : thread_count()) - 1);
+	gen.pool = pool;
 
-		parser_delete(&parser);
-		lexer_delete(&lexer);
-		input_delete(&input);
+	ARENA_VEC module_arenas = arenavec_new(2);
+	uint32_t num_errors = 0;
+	if (bench) {
+		for (int i = 0; i < input_files.size; i++) {
+			char* filepath = input_files.buffer[i];
+			SOURCE_FILE source;
+			if (!load_file(filepath, &source)) {
+				printf("Can't read file '%s': %s\n", filepath, strerror(errno));
+				num_errors++;
+				continue;
+			}
+			if (source.size > MAX_SOURCE_SIZE) {
+				printf("File '%s' is too large, source files are limited to 4 GB\n", filepath);
+				num_errors++;
+			} else {
+				if (bench_lexer_enabled) bench_lexer(filepath, &source);
+				if (bench_parser_enabled) bench_parser(filepath, &source);
+			}
+			unload_file(&source);
+		}
+	}
+
+	long num_jobs = bench ? 0 : input_files.size;
+	FRONTEND_JOB* jobs = mem_calloc(max(num_jobs, 1), sizeof(FRONTEND_JOB));
+	for (long i = 0; i < num_jobs; i++) {
+		jobs[i].filepath = input_files.buffer[i];
+		jobs[i].parse = gen.emit >= EMIT_FLAG(EMIT_AST);
 	}
+	pool_run(pool, parse_file, jobs, num_jobs);
+
+	for (long i = 0; i < num_jobs; i++) {
+		FRONTEND_JOB* job = &jobs[i];
+		if (!job->loaded) {
+			printf("Can't read file '%s': %s\n", job->filepath, strerror(job->load_error));
+			num_errors++;
+			continue;
+		}
+		if (job->source.size > MAX_SOURCE_SIZE) {
+			printf("File '%s' is too large, source files are limited to 4 GB\n", job->filepath);
+			unload_file(&job->source);
+			num_errors++;
+			continue;
+		}
+		char* name = job->name;
+
+		input_flush(&job->input);
+		if (tokens_out) dump_tokens(tokens_out, &job->lexer.tokens);
+
+		if (job->parse) {
+			strvec_push(&gen.module_name_vec, name);
+			astvec_push(&gen.module_ast_vec, job->ast);
+			arenavec_push(&module_arenas, job->arena);
+			if (ast_out) dump_ast(ast_out, &job->ast);
+		}
+		if (gen.emit >= EMIT_FLAG(EMIT_LLVM)) {
+			double start = stats_begin();
+			RESOLVER resolver = resolver_new(&gen.module_ast_vec.buffer[gen.module_ast_vec.size - 1], &job->input);
+			resolve_module(&resolver);
+			resolver_delete(&resolver);
+			stats_end(PHASE_RESOLVE, name, start, 0);
+			input_flush(&job->input);
+		}
+		num_errors += job->input.num_errors;
 
-	printf("### LLVM ###\n");
-	for (int i = 0; i < gen.module_ast_vec.size; i++) {
-		gen_create_module(&gen, &gen.module_ast_vec.buffer[i], gen.module_name_vec.buffer[i]);
+		lexer_delete(&job->lexer);
+		input_delete(&job->input);
+		unload_file(&job->source);
 	}
-	gen_link(&gen);
+	mem_free(jobs);
 
-	for (int i = 0; i < gen.module_ast_vec.size; i++) delete_ast(&gen.module_ast_vec.buffer[i]);
+	if (!bench && num_errors == 0 && gen.emit >= EMIT_FLAG(EMIT_LLVM)) {
+		if (gen.llvm_out) fputs("### LLVM ###\n", gen.llvm_out);
+		gen_create_modules(&gen);
+		// The IR of the linked program is an LLVM output too with full LTO
+		bool link = gen.emit >= EMIT_FLAG(EMIT_BC) || (gen.llvm_out && gen.lto == LTO_FULL);
+		if (link && !gen_link(&gen)) num_errors++;
+	}
+
+	FILE* outputs[] = { tokens_out, ast_out, gen.llvm_out, gen.asm_out };
+	for (int i = 0; i < 4; i++) if (outputs[i] && outputs[i] != stdout) fclose(outputs[i]);
+
+	if (time_report) stats_print_report(stdout);
+	if (stats_json_path) stats_write_json(stats_json_path);
+	if (time_trace_path) stats_write_trace(time_trace_path);
+
+	for (int i = 0; i < gen.module_ast_vec.size; i++) ast_delete(&gen.module_ast_vec.buffer[i]);
+	for (int i = 0; i < module_arenas.size; i++) arena_delete(&module_arenas.buffer[i]);
+	arenavec_delete(&module_arenas);
+	strvec_delete(&input_files);
 	gen_delete(&gen);
+	pool_delete(pool);
+	stats_delete();
+	types_delete();
+	intern_delete();
+
+	// After the cleanup the live blocks are the leaks
+	if (mem_report) mem_print_report(stdout);
+	if (leak_check && mem_check_leaks(stdout)) num_errors++;
 
-	return 0;
+	// A program run with --run passes its exit status on
+	return num_errors ? 1 : gen.run_status;
 }
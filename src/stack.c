@@ -0,0 +1,84 @@
+#include "stack.h"
+
+#include "thread.h"
+#include "alloc.h"
+
+#ifndef _WIN32
+#include <ucontext.h>
+#endif
+
+// Lowest address the current segment may grow to before a new one is needed (stacks grow down),
+// kept as an integer since it is compared against the addresses of locals of other frames
+THREAD_LOCAL uintptr_t stack_limit;
+
+typedef struct CONTINUATION_t {
+	void(*fn)(void*);
+	void* arg;
+#ifdef _WIN32
+	void* caller;
+#else
+	ucontext_t caller;
+#endif
+} CONTINUATION;
+
+THREAD_LOCAL CONTINUATION* pending_continuation;
+
+void stack_init(size_t size) {
+	char local;
+	uintptr_t here = (uintptr_t)&local;
+	stack_limit = here - size + STACK_RED_ZONE;
+}
+
+bool stack_low() {
+	char local;
+	return (uintptr_t)&local < stack_limit;
+}
+
+#ifdef _WIN32
+
+void WINAPI continuation_entry(void* param) {
+	CONTINUATION* c = param;
+	stack_init(STACK_SEGMENT_SIZE - STACK_RED_ZONE);
+	c->fn(c->arg);
+	SwitchToFiber(c->caller);
+}
+
+void stack_grow_call(void(*fn)(void*), void* arg) {
+	uintptr_t saved_limit = stack_limit;
+	bool was_fiber = IsThreadAFiber();
+	CONTINUATION c = { fn, arg, was_fiber ? GetCurrentFiber() : ConvertThreadToFiber(NULL) };
+	void* fiber = CreateFiber(STACK_SEGMENT_SIZE, continuation_entry, &c);
+	SwitchToFiber(fiber);
+	DeleteFiber(fiber);
+	if (!was_fiber) ConvertFiberToThread();
+	stack_limit = saved_limit;
+}
+
+#else
+
+void continuation_entry() {
+	CONTINUATION* c = pending_continuation;
+	stack_init(STACK_SEGMENT_SIZE - STACK_RED_ZONE);
+	c->fn(c->arg);
+	// Returning resumes c->caller through uc_link
+}
+
+void stack_grow_call(void(*fn)(void*), void* arg) {
+	uintptr_t saved_limit = stack_limit;
+	uint8_t subsystem = mem_enter(MEM_RUNTIME);
+	char* segment = mem_alloc(STACK_SEGMENT_SIZE);
+	mem_leave(subsystem);
+	CONTINUATION c = { .fn = fn, .arg = arg };
+	ucontext_t context;
+	getcontext(&context);
+	context.uc_stack.ss_sp = segment;
+	context.uc_stack.ss_size = STACK_SEGMENT_SIZE;
+	context.uc_link = &c.caller;
+	makecontext(&context, continuation_entry, 0);
+	pending_continuation = &c;
+	swapcontext(&c.caller, &context);
+	mem_free(segment);
+	stack_limit = saved_limit;
+}
+
+#endif
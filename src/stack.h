@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Segmented stack for the recursive walks over the AST (parser, codegen, printer).
+// A walk checks stack_low() at its recursion point and, if the current stack is nearly used up,
+// continues on a fresh heap allocated segment with stack_grow_call. Nesting depth is then only bounded by memory.
+
+#define STACK_SEGMENT_SIZE (8 * 1024 * 1024)
+#define STACK_RED_ZONE (256 * 1024)
+
+// Must be called once per thread, before any walk, with the usable size of the thread's stack
+void stack_init(size_t size);
+
+bool stack_low();
+// Calls fn(arg) on a new stack segment and frees the segment when it returns
+void stack_grow_call(void(*fn)(void*), void* arg);
@@ -0,0 +1,247 @@
+#include "stats.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+#include "intern.h"
+
+DEF_DYNAMIC_VECTOR(STATS_EVENT, STATS_EVENT_VEC, eventvec)
+
+const char* STATS_PHASE_NAMES[NUM_STATS_PHASES] = { "load", "lex", "parse", "resolve", "codegen", "optimize", "merge", "emit", "link" };
+const char* STATS_PHASE_UNITS[NUM_STATS_PHASES] = { "bytes", "tokens", "nodes", NULL, "instructions", "instructions", NULL, "bytes", "bytes" };
+
+STATS stats;
+
+// Index of the current thread in the events, assigned on its first event
+THREAD_LOCAL uint32_t stats_thread;
+THREAD_LOCAL bool stats_thread_known;
+
+double time_now() {
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+void stats_init() {
+	stats.enabled = false;
+	stats.start = time_now();
+	mutex_init(&stats.lock);
+	uint8_t subsystem = mem_enter(MEM_RUNTIME);
+	stats.events = eventvec_new(64);
+	mem_leave(subsystem);
+	// The main thread initializes the stats
+	stats.num_threads = 1;
+	stats_thread = 0;
+	stats_thread_known = true;
+}
+
+void stats_delete() {
+	eventvec_delete(&stats.events);
+	mutex_delete(&stats.lock);
+}
+
+double stats_begin() {
+	return stats.enabled ? time_now() : 0.0;
+}
+
+void stats_end(uint8_t phase, const char* module, double start, uint64_t count) {
+	if (!stats.enabled) return;
+	double end = time_now();
+	char* atom = module ? intern_str((char*)module) : NULL;
+	mutex_lock(&stats.lock);
+	if (!stats_thread_known) {
+		stats_thread = stats.num_threads++;
+		stats_thread_known = true;
+	}
+	uint8_t subsystem = mem_enter(MEM_RUNTIME);
+	eventvec_push(&stats.events, (STATS_EVENT){ phase, atom, stats_thread, start - stats.start, end - stats.start, count });
+	mem_leave(subsystem);
+	mutex_unlock(&stats.lock);
+}
+
+uint64_t peak_rss() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return (uint64_t)usage.ru_maxrss;
+#else
+	return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+typedef struct PHASE_TOTAL_t {
+	uint32_t num_events;
+	double total; // sum of the event durations
+	double first_start, last_end;
+	uint64_t count;
+} PHASE_TOTAL;
+
+typedef struct MODULE_TOTAL_t {
+	char* name;
+	double time[NUM_STATS_PHASES];
+	uint64_t count[NUM_STATS_PHASES]; // of the last event, optimize runs twice per module with ThinLTO
+} MODULE_TOTAL;
+
+void sum_phases(PHASE_TOTAL* phases) {
+	memset(phases, 0, NUM_STATS_PHASES * sizeof(PHASE_TOTAL));
+	for (long i = 0; i < stats.events.size; i++) {
+		STATS_EVENT* e = &stats.events.buffer[i];
+		PHASE_TOTAL* p = &phases[e->phase];
+		if (p->num_events == 0 || e->start < p->first_start) p->first_start = e->start;
+		if (p->num_events == 0 || e->end > p->last_end) p->last_end = e->end;
+		p->num_events++;
+		p->total += e->end - e->start;
+		p->count += e->count;
+	}
+}
+
+// Modules in the order of their first event
+MODULE_TOTAL* sum_modules(long* num_modules) {
+	MODULE_TOTAL* modules = mem_calloc(max(stats.events.size, 1), sizeof(MODULE_TOTAL));
+	long n = 0;
+	for (long i = 0; i < stats.events.size; i++) {
+		STATS_EVENT* e = &stats.events.buffer[i];
+		if (!e->module) continue;
+		long m = 0;
+		while (m < n && modules[m].name != e->module) m++;
+		if (m == n) modules[n++].name = e->module;
+		modules[m].time[e->phase] += e->end - e->start;
+		modules[m].count[e->phase] = e->count;
+	}
+	*num_modules = n;
+	return modules;
+}
+
+uint64_t module_instructions(MODULE_TOTAL* m) {
+	return m->count[PHASE_OPTIMIZE] ? m->count[PHASE_OPTIMIZE] : m->count[PHASE_CODEGEN];
+}
+
+void stats_print_report(FILE* out) {
+	double wall = time_now() - stats.start;
+	PHASE_TOTAL phases[NUM_STATS_PHASES];
+	mutex_lock(&stats.lock);
+	sum_phases(phases);
+
+	fputs("### TIME REPORT ###\n", out);
+	fprintf(out, "%-10s %7s %10s %10s %12s\n", "phase", "events", "total ms", "span ms", "size");
+	for (uint8_t i = 0; i < NUM_STATS_PHASES; i++) {
+		PHASE_TOTAL* p = &phases[i];
+		if (!p->num_events) continue;
+		fprintf(out, "%-10s %7u %10.3f %10.3f", STATS_PHASE_NAMES[i], p->num_events, p->total * 1e3, (p->last_end - p->first_start) * 1e3);
+		if (STATS_PHASE_UNITS[i]) fprintf(out, " %12llu %s", (unsigned long long)p->count, STATS_PHASE_UNITS[i]);
+		fputc('\n', out);
+	}
+	fprintf(out, "wall %.3f ms, %u threads, peak RSS %.1f MB\n", wall * 1e3, stats.num_threads, peak_rss() / (1024.0 * 1024.0));
+
+	long num_modules = 0;
+	MODULE_TOTAL* modules = sum_modules(&num_modules);
+	if (num_modules) {
+		fprintf(out, "\n%-16s", "module ms");
+		for (uint8_t i = 0; i < NUM_STATS_PHASES; i++) if (phases[i].num_events) fprintf(out, " %9s", STATS_PHASE_NAMES[i]);
+		fprintf(out, " %10s %10s %12s\n", "tokens", "nodes", "instructions");
+		for (long m = 0; m < num_modules; m++) {
+			fprintf(out, "%-16s", modules[m].name);
+			for (uint8_t i = 0; i < NUM_STATS_PHASES; i++) if (phases[i].num_events) fprintf(out, " %9.3f", modules[m].time[i] * 1e3);
+			fprintf(out, " %10llu %10llu %12llu\n", (unsigned long long)modules[m].count[PHASE_LEX], (unsigned long long)modules[m].count[PHASE_PARSE], (unsigned long long)module_instructions(&modules[m]));
+		}
+	}
+	mem_free(modules);
+	mutex_unlock(&stats.lock);
+	fputc('\n', out);
+}
+
+void write_json_string(FILE* out, const char* str) {
+	fputc('"', out);
+	for (const char* c = str; *c; c++) {
+		if (*c == '"' || *c == '\\') fprintf(out, "\\%c", *c);
+		else if ((unsigned char)*c < 0x20) fprintf(out, "\\u%04x", *c);
+		else fputc(*c, out);
+	}
+	fputc('"', out);
+}
+
+FILE* open_report(const char* path) {
+	FILE* file = fopen(path, "w");
+	if (!file) printf("Can't write '%s'\n", path);
+	return file;
+}
+
+bool stats_write_json(const char* path) {
+	FILE* out = open_report(path);
+	if (!out) return false;
+	double wall = time_now() - stats.start;
+	PHASE_TOTAL phases[NUM_STATS_PHASES];
+	mutex_lock(&stats.lock);
+	sum_phases(phases);
+
+	fprintf(out, "{\n  \"wall_ms\": %.3f,\n  \"threads\": %u,\n  \"peak_rss_bytes\": %llu,\n  \"phases\": {", wall * 1e3, stats.num_threads, (unsigned long long)peak_rss());
+	bool first = true;
+	for (uint8_t i = 0; i < NUM_STATS_PHASES; i++) {
+		PHASE_TOTAL* p = &phases[i];
+		if (!p->num_events) continue;
+		fprintf(out, "%s\n    \"%s\": { \"events\": %u, \"total_ms\": %.3f, \"span_ms\": %.3f", first ? "" : ",", STATS_PHASE_NAMES[i], p->num_events, p->total * 1e3, (p->last_end - p->first_start) * 1e3);
+		if (STATS_PHASE_UNITS[i]) fprintf(out, ", \"%s\": %llu", STATS_PHASE_UNITS[i], (unsigned long long)p->count);
+		fputs(" }", out);
+		first = false;
+	}
+	fputs("\n  },\n  \"modules\": [", out);
+
+	long num_modules = 0;
+	MODULE_TOTAL* modules = sum_modules(&num_modules);
+	for (long m = 0; m < num_modules; m++) {
+		fprintf(out, "%s\n    { \"name\": ", m ? "," : "");
+		write_json_string(out, modules[m].name);
+		for (uint8_t i = 0; i < NUM_STATS_PHASES; i++) if (phases[i].num_events) fprintf(out, ", \"%s_ms\": %.3f", STATS_PHASE_NAMES[i], modules[m].time[i] * 1e3);
+		fprintf(out, ", \"bytes\": %llu, \"tokens\": %llu, \"nodes\": %llu, \"instructions\": %llu }", (unsigned long long)modules[m].count[PHASE_LOAD],
+			(unsigned long long)modules[m].count[PHASE_LEX], (unsigned long long)modules[m].count[PHASE_PARSE], (unsigned long long)module_instructions(&modules[m]));
+	}
+	mem_free(modules);
+	mutex_unlock(&stats.lock);
+	fputs("\n  ]\n}\n", out);
+	fclose(out);
+	return true;
+}
+
+bool stats_write_trace(const char* path) {
+	FILE* out = open_report(path);
+	if (!out) return false;
+	mutex_lock(&stats.lock);
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+	const char* separator = "\n";
+	for (uint32_t t = 0; t < stats.num_threads; t++) {
+		fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}", separator, t, t ? "worker" : "main", t);
+		separator = ",\n";
+	}
+	for (long i = 0; i < stats.events.size; i++) {
+		STATS_EVENT* e = &stats.events.buffer[i];
+		const char* phase = STATS_PHASE_NAMES[e->phase];
+		fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"module\":", separator, phase, phase, e->thread, e->start * 1e6, (e->end - e->start) * 1e6);
+		if (e->module) write_json_string(out, e->module);
+		else fputs("null", out);
+		if (STATS_PHASE_UNITS[e->phase]) fprintf(out, ",\"%s\":%llu", STATS_PHASE_UNITS[e->phase], (unsigned long long)e->count);
+		fputs("}}", out);
+	}
+	mutex_unlock(&stats.lock);
+	fputs("\n]}\n", out);
+	fclose(out);
+	return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "utils.h"
+#include "thread.h"
+
+// Compile time profile: every phase of every module is recorded as an event with its thread, start and end time
+// and a size (bytes, tokens, nodes or instructions). Recording is off unless a report is requested, then an event
+// costs a lock and a push. The events are summed up per phase and per module, or written as a Chrome trace.
+
+enum STATS_PHASE {
+	PHASE_LOAD, // bytes
+	PHASE_LEX, // tokens
+	PHASE_PARSE, // nodes
+	PHASE_RESOLVE,
+	PHASE_CODEGEN, // instructions
+	PHASE_OPTIMIZE, // instructions after the passes
+	PHASE_MERGE, // moving the modules to the linked program or the ThinLTO index
+	PHASE_EMIT, // bytes of object code
+	PHASE_LINK, // bytes of the objects linked
+	NUM_STATS_PHASES
+};
+
+extern const char* STATS_PHASE_NAMES[NUM_STATS_PHASES];
+
+typedef struct STATS_EVENT_t {
+	uint8_t phase;
+	char* module; // atom
+	uint32_t thread; // 0 is the main thread
+	double start, end; // seconds since stats_init
+	uint64_t count;
+} STATS_EVENT;
+
+DECL_DYNAMIC_VECTOR(STATS_EVENT, STATS_EVENT_VEC, eventvec)
+
+typedef struct STATS_t {
+	bool enabled;
+	double start;
+	MUTEX lock;
+	STATS_EVENT_VEC events;
+	uint32_t num_threads;
+} STATS;
+
+extern STATS stats;
+
+// Monotonic, in seconds
+double time_now();
+
+// Starts the clock, the driver enables recording once it knows whether a report is requested
+void stats_init();
+void stats_delete();
+
+// Start time of an event, 0 when disabled
+double stats_begin();
+// module is interned, it may be NULL for whole program phases
+void stats_end(uint8_t phase, const char* module, double start, uint64_t count);
+
+// Largest resident set size of the process so far, 0 if unknown
+uint64_t peak_rss();
+
+void stats_print_report(FILE* out);
+bool stats_write_json(const char* path);
+// Chrome trace event format, for chrome://tracing, Perfetto or speedscope
+bool stats_write_trace(const char* path);
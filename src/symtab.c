@@ -0,0 +1,52 @@
+#include "symtab.h"
+
+DEF_DYNAMIC_VECTOR(SYMBOL, SYMBOL_VEC, symvec)
+
+uint32_t hash_atom(char* atom) {
+	uint64_t h = (uint64_t)(uintptr_t)atom * 0x9E3779B97F4A7C15ull;
+	return (uint32_t)(h >> 32);
+}
+
+// capacity must be a power of two
+SYMBOL_TABLE symtab_new(long capacity) {
+	return (SYMBOL_TABLE) { mem_calloc(capacity, sizeof(SYMBOL)), 0, capacity };
+}
+
+void symtab_delete(SYMBOL_TABLE* table) {
+	mem_free(table->entries);
+	*table = (SYMBOL_TABLE){ 0 };
+}
+
+SYMBOL* symtab_find(SYMBOL_TABLE* table, char* name) {
+	long idx = hash_atom(name) & (table->capacity - 1);
+	while (table->entries[idx].name && table->entries[idx].name != name) idx = (idx + 1) & (table->capacity - 1);
+	return &table->entries[idx];
+}
+
+void symtab_grow(SYMBOL_TABLE* table) {
+	SYMBOL* old_entries = table->entries;
+	long old_capacity = table->capacity;
+	table->capacity *= 2;
+	table->entries = mem_calloc(table->capacity, sizeof(SYMBOL));
+	for (long i = 0; i < old_capacity; i++) {
+		if (old_entries[i].name) *symtab_find(table, old_entries[i].name) = old_entries[i];
+	}
+	mem_free(old_entries);
+}
+
+uint32_t symtab_get(SYMBOL_TABLE* table, char* name) {
+	return symtab_find(table, name)->value;
+}
+
+uint32_t symtab_put(SYMBOL_TABLE* table, char* name, uint32_t value) {
+	SYMBOL* entry = symtab_find(table, name);
+	if (entry->name) {
+		uint32_t previous = entry->value;
+		entry->value = value;
+		return previous;
+	}
+
+	*entry = (SYMBOL){ name, value };
+	if (++table->size * 2 > table->capacity) symtab_grow(table);
+	return 0;
+}
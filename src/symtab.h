@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "utils.h"
+
+// Maps interned names to binding ids (see resolve.h). Keys are atoms (see intern.h), so they are hashed and compared by pointer.
+// Entries are never removed, a binding is undone by setting its value back to the previous one (or 0).
+
+typedef struct SYMBOL_t {
+	char* name;
+	uint32_t value;
+} SYMBOL;
+
+DECL_DYNAMIC_VECTOR(SYMBOL, SYMBOL_VEC, symvec)
+
+typedef struct SYMBOL_TABLE_t {
+	SYMBOL* entries;
+	long size;
+	long capacity;
+} SYMBOL_TABLE;
+
+SYMBOL_TABLE symtab_new(long capacity);
+void symtab_delete(SYMBOL_TABLE* table);
+
+uint32_t symtab_get(SYMBOL_TABLE* table, char* name);
+// Returns the value that was previously bound to name, or 0
+uint32_t symtab_put(SYMBOL_TABLE* table, char* name, uint32_t value);
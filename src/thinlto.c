@@ -0,0 +1,196 @@
+#include "thinlto.h"
+
+#include <string.h>
+
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Linker.h>
+
+#include "intern.h"
+
+DEF_DYNAMIC_VECTOR(FUNCTION_SUMMARY, FUNCTION_SUMMARY_VEC, fsumvec)
+DEF_DYNAMIC_VECTOR(MODULE_SUMMARY, MODULE_SUMMARY_VEC, msumvec)
+
+THIN_LTO thinlto_new() {
+	uint8_t subsystem = mem_enter(MEM_LTO);
+	THIN_LTO t;
+	t.modules = msumvec_new(4);
+	t.functions = fsumvec_new(16);
+	t.refs = strvec_new(64);
+	t.imports = strvec_new(16);
+	t.index = symtab_new(64);
+	t.exported = symtab_new(64);
+	mem_leave(subsystem);
+	return t;
+}
+
+void thinlto_delete(THIN_LTO* t) {
+	for (int i = 0; i < t->modules.size; i++) LLVMDisposeMemoryBuffer(t->modules.buffer[i].bitcode);
+	msumvec_delete(&t->modules);
+	fsumvec_delete(&t->functions);
+	strvec_delete(&t->refs);
+	strvec_delete(&t->imports);
+	symtab_delete(&t->index);
+	symtab_delete(&t->exported);
+}
+
+char* value_atom(LLVMValueRef value) {
+	size_t len = 0;
+	const char* name = LLVMGetValueName2(value, &len);
+	return intern(name, (long)len);
+}
+
+// Local symbols get the module name as suffix, so they stay unique when functions referring to them are imported
+void promote_local(LLVMValueRef value, char* module_name) {
+	LLVMLinkage linkage = LLVMGetLinkage(value);
+	if (linkage != LLVMPrivateLinkage && linkage != LLVMInternalLinkage) return;
+	size_t len = 0;
+	const char* name = LLVMGetValueName2(value, &len);
+	size_t promoted_len = len + 1 + strlen(module_name);
+	char* promoted = mem_alloc(promoted_len + 1);
+	snprintf(promoted, promoted_len + 1, "%.*s.%s", (int)len, name, module_name);
+	LLVMSetValueName2(value, promoted, promoted_len);
+	mem_free(promoted);
+	LLVMSetLinkage(value, LLVMExternalLinkage);
+	LLVMSetVisibility(value, LLVMHiddenVisibility);
+}
+
+// Global values used by an instruction, directly or inside constant expressions
+void add_refs(THIN_LTO* t, LLVMValueRef value) {
+	int num_operands = LLVMGetNumOperands(value);
+	for (int i = 0; i < num_operands; i++) {
+		LLVMValueRef operand = LLVMGetOperand(value, i);
+		if (LLVMIsAGlobalValue(operand)) strvec_push(&t->refs, value_atom(operand));
+		else if (LLVMIsAConstantExpr(operand)) add_refs(t, operand);
+	}
+}
+
+void thinlto_add_module(THIN_LTO* t, LLVMModuleRef module, char* name) {
+	uint8_t subsystem = mem_enter(MEM_LTO);
+	for (LLVMValueRef func = LLVMGetFirstFunction(module); func; func = LLVMGetNextFunction(func)) promote_local(func, name);
+	for (LLVMValueRef global = LLVMGetFirstGlobal(module); global; global = LLVMGetNextGlobal(global)) promote_local(global, name);
+
+	MODULE_SUMMARY summary = { name, NULL, (uint32_t)t->functions.size, 0, 0, 0 };
+	for (LLVMValueRef func = LLVMGetFirstFunction(module); func; func = LLVMGetNextFunction(func)) {
+		if (LLVMIsDeclaration(func)) continue;
+		FUNCTION_SUMMARY function = { value_atom(func), (uint32_t)t->modules.size, 0, (uint32_t)t->refs.size, 0 };
+		for (LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(func); block; block = LLVMGetNextBasicBlock(block)) {
+			for (LLVMValueRef inst = LLVMGetFirstInstruction(block); inst; inst = LLVMGetNextInstruction(inst)) {
+				function.num_instructions++;
+				add_refs(t, inst);
+			}
+		}
+		function.num_refs = (uint32_t)t->refs.size - function.first_ref;
+		fsumvec_push(&t->functions, function);
+	}
+	summary.num_functions = (uint32_t)t->functions.size - summary.first_function;
+	summary.bitcode = LLVMWriteBitcodeToMemoryBuffer(module);
+	msumvec_push(&t->modules, summary);
+	mem_leave(subsystem);
+}
+
+// Imports the small functions called by function from other modules, and what those call in turn with a lower limit
+void import_refs(THIN_LTO* t, uint32_t module, FUNCTION_SUMMARY* function, float limit, SYMBOL_TABLE* imported) {
+	for (uint32_t i = 0; i < function->num_refs; i++) {
+		uint32_t id = symtab_get(&t->index, t->refs.buffer[function->first_ref + i]);
+		if (!id) continue; // declaration or global variable
+		FUNCTION_SUMMARY* callee = &t->functions.buffer[id - 1];
+		if (callee->module == module || callee->num_instructions > limit || symtab_get(imported, callee->name)) continue;
+
+		symtab_put(imported, callee->name, 1);
+		strvec_push(&t->imports, callee->name);
+		symtab_put(&t->exported, callee->name, 1);
+		for (uint32_t j = 0; j < callee->num_refs; j++) symtab_put(&t->exported, t->refs.buffer[callee->first_ref + j], 1);
+		import_refs(t, module, callee, limit * THINLTO_IMPORT_DECAY, imported);
+	}
+}
+
+void thinlto_compute_imports(THIN_LTO* t) {
+	uint8_t subsystem = mem_enter(MEM_LTO);
+	for (uint32_t i = 0; i < t->functions.size; i++) symtab_put(&t->index, t->functions.buffer[i].name, i + 1);
+	for (uint32_t m = 0; m < t->modules.size; m++) {
+		MODULE_SUMMARY* summary = &t->modules.buffer[m];
+		summary->first_import = (uint32_t)t->imports.size;
+		SYMBOL_TABLE imported = symtab_new(16);
+		for (uint32_t i = 0; i < summary->num_functions; i++) {
+			import_refs(t, m, &t->functions.buffer[summary->first_function + i], THINLTO_IMPORT_LIMIT, &imported);
+		}
+		symtab_delete(&imported);
+		summary->num_imports = (uint32_t)t->imports.size - summary->first_import;
+	}
+	mem_leave(subsystem);
+}
+
+LLVMModuleRef parse_module(THIN_LTO* t, uint32_t module, LLVMContextRef context) {
+	LLVMModuleRef result = NULL;
+	LLVMMemoryBufferRef bitcode = t->modules.buffer[module].bitcode;
+	// The bitcode buffer is owned by the summary, the parser only gets a view of it
+	LLVMMemoryBufferRef view = LLVMCreateMemoryBufferWithMemoryRange(LLVMGetBufferStart(bitcode), LLVMGetBufferSize(bitcode), t->modules.buffer[module].name, false);
+	LLVMParseBitcodeInContext2(context, view, &result);
+	LLVMDisposeMemoryBuffer(view);
+	return result;
+}
+
+void delete_body(LLVMValueRef func) {
+	for (LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(func); block; block = LLVMGetNextBasicBlock(block)) {
+		for (LLVMValueRef inst = LLVMGetFirstInstruction(block); inst; inst = LLVMGetNextInstruction(inst)) {
+			if (LLVMGetTypeKind(LLVMTypeOf(inst)) != LLVMVoidTypeKind) LLVMReplaceAllUsesWith(inst, LLVMGetUndef(LLVMTypeOf(inst)));
+		}
+	}
+	LLVMBasicBlockRef block;
+	while ((block = LLVMGetFirstBasicBlock(func)) != NULL) {
+		LLVMValueRef inst;
+		while ((inst = LLVMGetFirstInstruction(block)) != NULL) LLVMInstructionEraseFromParent(inst);
+		LLVMDeleteBasicBlock(block);
+	}
+	LLVMSetLinkage(func, LLVMExternalLinkage);
+}
+
+LLVMModuleRef thinlto_load_module(THIN_LTO* t, uint32_t module, LLVMContextRef context) {
+	LLVMModuleRef result = parse_module(t, module, context);
+	if (!result) return NULL;
+
+	// Promoted symbols that no other module refers to are local again, so the optimizer can drop them after inlining
+	for (LLVMValueRef func = LLVMGetFirstFunction(result); func; func = LLVMGetNextFunction(func)) {
+		if (!LLVMIsDeclaration(func) && LLVMGetVisibility(func) == LLVMHiddenVisibility && !symtab_get(&t->exported, value_atom(func))) {
+			LLVMSetLinkage(func, LLVMInternalLinkage);
+			LLVMSetVisibility(func, LLVMDefaultVisibility);
+		}
+	}
+	for (LLVMValueRef global = LLVMGetFirstGlobal(result); global; global = LLVMGetNextGlobal(global)) {
+		if (!LLVMIsDeclaration(global) && LLVMGetVisibility(global) == LLVMHiddenVisibility && !symtab_get(&t->exported, value_atom(global))) {
+			LLVMSetLinkage(global, LLVMInternalLinkage);
+			LLVMSetVisibility(global, LLVMDefaultVisibility);
+		}
+	}
+
+	MODULE_SUMMARY* summary = &t->modules.buffer[module];
+	if (!summary->num_imports) return result;
+	SYMBOL_TABLE imported = symtab_new(16);
+	for (uint32_t i = 0; i < summary->num_imports; i++) symtab_put(&imported, t->imports.buffer[summary->first_import + i], 1);
+
+	// Every module that exports to this one is linked in with only the imported function bodies left
+	for (uint32_t m = 0; m < t->modules.size; m++) {
+		if (m == module) continue;
+		bool has_imports = false;
+		for (uint32_t i = 0; i < summary->num_imports && !has_imports; i++) {
+			has_imports = t->functions.buffer[symtab_get(&t->index, t->imports.buffer[summary->first_import + i]) - 1].module == m;
+		}
+		if (!has_imports) continue;
+
+		LLVMModuleRef exporter = parse_module(t, m, context);
+		if (!exporter) continue;
+		for (LLVMValueRef func = LLVMGetFirstFunction(exporter); func; func = LLVMGetNextFunction(func)) {
+			if (LLVMIsDeclaration(func)) continue;
+			if (symtab_get(&imported, value_atom(func))) LLVMSetLinkage(func, LLVMAvailableExternallyLinkage);
+			else delete_body(func);
+		}
+		for (LLVMValueRef global = LLVMGetFirstGlobal(exporter); global; global = LLVMGetNextGlobal(global)) {
+			if (!LLVMIsDeclaration(global)) LLVMSetLinkage(global, LLVMAvailableExternallyLinkage);
+		}
+		LLVMLinkModules2(result, exporter);
+	}
+	symtab_delete(&imported);
+
+	return result;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <llvm-c/Core.h>
+
+#include "utils.h"
+#include "symtab.h"
+
+// ThinLTO-style builds: every module is written as bitcode together with a summary of its functions (size and
+// referenced symbols). Cross-module imports are decided from the summaries alone, then every module is loaded on
+// its own with the imported functions as available_externally copies, so it can be optimized and compiled
+// independently of the others.
+
+#define THINLTO_IMPORT_LIMIT 100 // instructions, for functions called directly by the importing module
+#define THINLTO_IMPORT_DECAY 0.7f // limit factor for every further level of calls
+
+typedef struct FUNCTION_SUMMARY_t {
+	char* name; // atom
+	uint32_t module;
+	uint32_t num_instructions;
+	uint32_t first_ref; // range in THIN_LTO.refs, the functions and globals it refers to
+	uint32_t num_refs;
+} FUNCTION_SUMMARY;
+
+typedef struct MODULE_SUMMARY_t {
+	char* name;
+	LLVMMemoryBufferRef bitcode;
+	uint32_t first_function; // range in THIN_LTO.functions, only definitions
+	uint32_t num_functions;
+	uint32_t first_import; // range in THIN_LTO.imports, set by thinlto_compute_imports
+	uint32_t num_imports;
+} MODULE_SUMMARY;
+
+DECL_DYNAMIC_VECTOR(FUNCTION_SUMMARY, FUNCTION_SUMMARY_VEC, fsumvec)
+DECL_DYNAMIC_VECTOR(MODULE_SUMMARY, MODULE_SUMMARY_VEC, msumvec)
+
+typedef struct THIN_LTO_t {
+	MODULE_SUMMARY_VEC modules;
+	FUNCTION_SUMMARY_VEC functions;
+	STRING_VEC refs;
+	STRING_VEC imports; // names of the imported functions, grouped by importing module
+
+	SYMBOL_TABLE index; // function name -> 1 + index in functions
+	SYMBOL_TABLE exported; // symbols that are imported or referenced by an imported function
+} THIN_LTO;
+
+THIN_LTO thinlto_new();
+void thinlto_delete(THIN_LTO* t);
+
+// Promotes the module's local symbols to hidden globals with unique names, summarizes it and writes its bitcode.
+// The module itself is not needed afterwards.
+void thinlto_add_module(THIN_LTO* t, LLVMModuleRef module, char* name);
+void thinlto_compute_imports(THIN_LTO* t);
+// Loads a module into context with its imports linked in, ready to be optimized and compiled
+LLVMModuleRef thinlto_load_module(THIN_LTO* t, uint32_t module, LLVMContextRef context);
+
+// Turns a definition into a declaration, LLVM-C has no equivalent of Function::deleteBody
+void delete_body(LLVMValueRef func);
@@ -0,0 +1,148 @@
+#include "thread.h"
+
+#include "stack.h"
+#include "alloc.h"
+#include "utils.h"
+
+#ifdef _WIN32
+
+void mutex_init(MUTEX* m) { InitializeCriticalSection(m); }
+void mutex_delete(MUTEX* m) { DeleteCriticalSection(m); }
+void mutex_lock(MUTEX* m) { EnterCriticalSection(m); }
+void mutex_unlock(MUTEX* m) { LeaveCriticalSection(m); }
+
+void condition_init(CONDITION* c) { InitializeConditionVariable(c); }
+void condition_delete(CONDITION* c) {}
+void condition_wait(CONDITION* c, MUTEX* m) { SleepConditionVariableCS(c, m, INFINITE); }
+void condition_signal(CONDITION* c) { WakeConditionVariable(c); }
+void condition_broadcast(CONDITION* c) { WakeAllConditionVariable(c); }
+
+int thread_count() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+}
+
+#else
+
+#include <unistd.h>
+
+void mutex_init(MUTEX* m) { pthread_mutex_init(m, NULL); }
+void mutex_delete(MUTEX* m) { pthread_mutex_destroy(m); }
+void mutex_lock(MUTEX* m) { pthread_mutex_lock(m); }
+void mutex_unlock(MUTEX* m) { pthread_mutex_unlock(m); }
+
+void condition_init(CONDITION* c) { pthread_cond_init(c, NULL); }
+void condition_delete(CONDITION* c) { pthread_cond_destroy(c); }
+void condition_wait(CONDITION* c, MUTEX* m) { pthread_cond_wait(c, m); }
+void condition_signal(CONDITION* c) { pthread_cond_signal(c); }
+void condition_broadcast(CONDITION* c) { pthread_cond_broadcast(c); }
+
+int thread_count() {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int)n : 1;
+}
+
+#endif
+
+// Takes tasks until the batch is used up, called with the pool locked
+void pool_work(THREAD_POOL* pool) {
+	while (pool->next < pool->count) {
+		TASK_FN fn = pool->fn;
+		void* arg = pool->arg;
+		long index = pool->next++;
+		mutex_unlock(&pool->lock);
+		fn(arg, index);
+		mutex_lock(&pool->lock);
+		if (--pool->remaining == 0) condition_signal(&pool->work_done);
+	}
+}
+
+void pool_worker(THREAD_POOL* pool) {
+	stack_init(THREAD_STACK_SIZE);
+	mutex_lock(&pool->lock);
+	while (!pool->stop) {
+		pool_work(pool);
+		if (!pool->stop) condition_wait(&pool->work_ready, &pool->lock);
+	}
+	mutex_unlock(&pool->lock);
+}
+
+#ifdef _WIN32
+
+DWORD WINAPI pool_thread_entry(void* param) {
+	pool_worker(param);
+	return 0;
+}
+
+THREAD thread_start(THREAD_POOL* pool) {
+	return CreateThread(NULL, THREAD_STACK_SIZE, pool_thread_entry, pool, STACK_SIZE_PARAM_IS_A_RESERVATION, NULL);
+}
+
+void thread_join(THREAD thread) {
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+
+#else
+
+void* pool_thread_entry(void* param) {
+	pool_worker(param);
+	return NULL;
+}
+
+THREAD thread_start(THREAD_POOL* pool) {
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+	THREAD thread;
+	pthread_create(&thread, &attr, pool_thread_entry, pool);
+	pthread_attr_destroy(&attr);
+	return thread;
+}
+
+void thread_join(THREAD thread) {
+	pthread_join(thread, NULL);
+}
+
+#endif
+
+THREAD_POOL* pool_new(int num_threads) {
+	uint8_t subsystem = mem_enter(MEM_RUNTIME);
+	THREAD_POOL* pool = mem_calloc(1, sizeof(THREAD_POOL));
+	mutex_init(&pool->lock);
+	condition_init(&pool->work_ready);
+	condition_init(&pool->work_done);
+	pool->num_threads = num_threads;
+	pool->threads = mem_alloc(max(num_threads, 1) * sizeof(THREAD));
+	for (int i = 0; i < num_threads; i++) pool->threads[i] = thread_start(pool);
+	mem_leave(subsystem);
+	return pool;
+}
+
+void pool_delete(THREAD_POOL* pool) {
+	mutex_lock(&pool->lock);
+	pool->stop = true;
+	condition_broadcast(&pool->work_ready);
+	mutex_unlock(&pool->lock);
+	for (int i = 0; i < pool->num_threads; i++) thread_join(pool->threads[i]);
+	mem_free(pool->threads);
+	condition_delete(&pool->work_ready);
+	condition_delete(&pool->work_done);
+	mutex_delete(&pool->lock);
+	mem_free(pool);
+}
+
+void pool_run(THREAD_POOL* pool, TASK_FN fn, void* arg, long count) {
+	if (count == 0) return;
+	mutex_lock(&pool->lock);
+	pool->fn = fn;
+	pool->arg = arg;
+	pool->count = count;
+	pool->next = 0;
+	pool->remaining = count;
+	condition_broadcast(&pool->work_ready);
+	pool_work(pool);
+	while (pool->remaining > 0) condition_wait(&pool->work_done, &pool->lock);
+	mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef CRITICAL_SECTION MUTEX;
+typedef CONDITION_VARIABLE CONDITION;
+typedef HANDLE THREAD;
+#define THREAD_LOCAL __declspec(thread)
+#else
+#include <pthread.h>
+typedef pthread_mutex_t MUTEX;
+typedef pthread_cond_t CONDITION;
+typedef pthread_t THREAD;
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// Worker threads get the smallest default main thread stack too, deeper walks continue on heap segments (see stack.h)
+#define THREAD_STACK_SIZE (1024 * 1024)
+
+void mutex_init(MUTEX* m);
+void mutex_delete(MUTEX* m);
+void mutex_lock(MUTEX* m);
+void mutex_unlock(MUTEX* m);
+
+// Number of logical processors
+int thread_count();
+
+// Runs a batch of independent tasks fn(arg, 0) .. fn(arg, count - 1) on a fixed set of threads.
+// The calling thread works on the batch as well, so a pool without threads runs everything in order on the caller.
+typedef void(*TASK_FN)(void* arg, long index);
+
+typedef struct THREAD_POOL_t {
+	THREAD* threads;
+	int num_threads;
+
+	MUTEX lock;
+	CONDITION work_ready;
+	CONDITION work_done;
+	TASK_FN fn;
+	void* arg;
+	long count;
+	long next; // first task no thread has taken yet
+	long remaining; // tasks that have not finished yet
+	bool stop;
+} THREAD_POOL;
+
+THREAD_POOL* pool_new(int num_threads);
+void pool_delete(THREAD_POOL* pool);
+
+// Returns when every task of the batch has finished
+void pool_run(THREAD_POOL* pool, TASK_FN fn, void* arg, long count);
@@ -0,0 +1,144 @@
+#include "types.h"
+
+#include <string.h>
+
+#include "intern.h"
+
+DEF_DYNAMIC_VECTOR(TYPE_INFO, TYPE_INFO_VEC, typevec)
+
+TYPE_TABLE type_table;
+
+TYPE_ID add_type(TYPE_INFO info) {
+	typevec_push(&type_table.types, info);
+	return (TYPE_ID)(type_table.types.size - 1);
+}
+
+void add_builtin_type(TYPE_ID id, uint8_t kind, uint8_t bits, const char* name) {
+	char* atom = intern_str(name);
+	add_type((TYPE_INFO){ kind, bits, TYPE_VOID, 0, NULL, atom });
+	// Builtin type names are recognized through the tag of their atom
+	if (id != TYPE_VOID) intern_set_tag(atom, (uint8_t)id);
+}
+
+void types_init() {
+	uint8_t subsystem = mem_enter(MEM_RESOLVER);
+	type_table.types = typevec_new(64);
+	type_table.data = arena_new(4 * 1024);
+	add_builtin_type(TYPE_VOID, TYPE_KIND_VOID, 0, "void");
+	add_builtin_type(TYPE_BOOL, TYPE_KIND_BOOL, 1, "bool");
+	add_builtin_type(TYPE_I8, TYPE_KIND_INT, 8, "i8");
+	add_builtin_type(TYPE_I16, TYPE_KIND_INT, 16, "i16");
+	add_builtin_type(TYPE_I32, TYPE_KIND_INT, 32, "i32");
+	add_builtin_type(TYPE_I64, TYPE_KIND_INT, 64, "i64");
+	add_builtin_type(TYPE_F32, TYPE_KIND_FLOAT, 32, "f32");
+	add_builtin_type(TYPE_F64, TYPE_KIND_FLOAT, 64, "f64");
+	type_table.capacity = 64;
+	type_table.slots = mem_calloc(type_table.capacity, sizeof(TYPE_ID));
+	type_pointer(TYPE_I8);
+	mem_leave(subsystem);
+}
+
+void types_delete() {
+	typevec_delete(&type_table.types);
+	arena_delete(&type_table.data);
+	mem_free(type_table.slots);
+	type_table = (TYPE_TABLE){ 0 };
+}
+
+uint32_t hash_type(uint8_t kind, TYPE_ID element, TYPE_ID* params, uint8_t num_params) {
+	uint32_t hash = 2166136261u;
+	uint32_t words[] = { kind, element, num_params };
+	for (int i = 0; i < 3; i++) hash = (hash ^ words[i]) * 16777619u;
+	for (uint8_t i = 0; i < num_params; i++) hash = (hash ^ params[i]) * 16777619u;
+	return hash;
+}
+
+// Slot of the composite type with these fields, or the free slot it would go in
+TYPE_ID* find_type_slot(uint8_t kind, TYPE_ID element, TYPE_ID* params, uint8_t num_params) {
+	long idx = hash_type(kind, element, params, num_params) & (type_table.capacity - 1);
+	while (type_table.slots[idx]) {
+		TYPE_INFO* info = TYPE_INFO_OF(type_table.slots[idx]);
+		if (info->kind == kind && info->element == element && info->num_params == num_params
+			&& (num_params == 0 || memcmp(info->params, params, num_params * sizeof(TYPE_ID)) == 0)) break;
+		idx = (idx + 1) & (type_table.capacity - 1);
+	}
+	return &type_table.slots[idx];
+}
+
+TYPE_ID add_composite_type(TYPE_ID* slot, TYPE_INFO info) {
+	TYPE_ID type = add_type(info);
+	*slot = type;
+	if (++type_table.num_composites * 2 <= type_table.capacity) return type;
+
+	mem_free(type_table.slots);
+	type_table.capacity *= 2;
+	type_table.slots = mem_calloc(type_table.capacity, sizeof(TYPE_ID));
+	for (long i = NUM_BUILTIN_TYPES; i < type_table.types.size; i++) {
+		TYPE_INFO* composite = &type_table.types.buffer[i];
+		*find_type_slot(composite->kind, composite->element, composite->params, composite->num_params) = (TYPE_ID)i;
+	}
+	return type;
+}
+
+TYPE_ID type_pointer(TYPE_ID element) {
+	TYPE_ID* slot = find_type_slot(TYPE_KIND_POINTER, element, NULL, 0);
+	if (*slot) return *slot;
+	char* element_name = type_name(element);
+	long len = (long)strlen(element_name);
+	char* name = arena_alloc(&type_table.data, len + 2);
+	name[0] = '&';
+	memcpy(name + 1, element_name, len + 1);
+	return add_composite_type(slot, (TYPE_INFO){ TYPE_KIND_POINTER, 64, element, 0, NULL, name });
+}
+
+TYPE_ID type_function(TYPE_ID return_type, TYPE_ID* params, uint8_t num_params) {
+	TYPE_ID* slot = find_type_slot(TYPE_KIND_FUNCTION, return_type, params, num_params);
+	if (*slot) return *slot;
+	DYNAMIC_STRING name = string_new(32);
+	string_push_s(&name, "func(");
+	for (uint8_t i = 0; i < num_params; i++) {
+		if (i) string_push_s(&name, ", ");
+		string_push_s(&name, type_name(params[i]));
+	}
+	string_push_s(&name, ") ");
+	string_push_s(&name, type_name(return_type));
+	TYPE_INFO info = { TYPE_KIND_FUNCTION, 0, return_type, num_params, arena_copy(&type_table.data, params, num_params * sizeof(TYPE_ID)), arena_strn(&type_table.data, name.buffer, name.size) };
+	string_delete(&name);
+	return add_composite_type(slot, info);
+}
+
+TYPE_ID type_from_name(char* atom) {
+	return intern_tag(atom);
+}
+
+char* type_name(TYPE_ID type) {
+	return TYPE_INFO_OF(type)->name;
+}
+
+bool type_is_numeric(TYPE_ID type) {
+	uint8_t kind = TYPE_KIND_OF(type);
+	return kind == TYPE_KIND_BOOL || kind == TYPE_KIND_INT || kind == TYPE_KIND_FLOAT;
+}
+
+uint8_t type_conversion(TYPE_ID from, TYPE_ID to) {
+	if (from == to) return CONV_NONE;
+	TYPE_INFO* src = TYPE_INFO_OF(from);
+	TYPE_INFO* dst = TYPE_INFO_OF(to);
+	switch (dst->kind) {
+	case TYPE_KIND_BOOL:
+		return src->kind == TYPE_KIND_INT ? CONV_INT_TO_BOOL : CONV_INVALID;
+	case TYPE_KIND_INT:
+		if (src->kind == TYPE_KIND_BOOL) return CONV_BOOL_TO_INT;
+		if (src->kind == TYPE_KIND_INT) return src->bits < dst->bits ? CONV_INT_EXTEND : CONV_INT_TRUNCATE;
+		if (src->kind == TYPE_KIND_FLOAT) return CONV_FLOAT_TO_INT;
+		return CONV_INVALID;
+	case TYPE_KIND_FLOAT:
+		if (src->kind == TYPE_KIND_INT) return CONV_INT_TO_FLOAT;
+		if (src->kind == TYPE_KIND_FLOAT) return src->bits < dst->bits ? CONV_FLOAT_EXTEND : CONV_FLOAT_TRUNCATE;
+		return CONV_INVALID;
+	case TYPE_KIND_POINTER:
+		return dst->element == from ? CONV_ADDRESS : CONV_INVALID;
+	default:
+		return CONV_INVALID;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "utils.h"
+
+// Types are interned once into a global table and referred to by their index, so two types are equal iff their ids are.
+// The builtin types have fixed ids, pointer and function types are added on first use and found again through a hash index.
+
+typedef uint16_t TYPE_ID;
+
+enum TYPE_KIND {
+	TYPE_KIND_VOID,
+	TYPE_KIND_BOOL,
+	TYPE_KIND_INT,
+	TYPE_KIND_FLOAT,
+	TYPE_KIND_POINTER,
+	TYPE_KIND_FUNCTION,
+};
+
+enum BUILTIN_TYPE {
+	TYPE_VOID,
+	TYPE_BOOL,
+	TYPE_I8,
+	TYPE_I16,
+	TYPE_I32,
+	TYPE_I64,
+	TYPE_F32,
+	TYPE_F64,
+
+	NUM_BUILTIN_TYPES,
+	// &i8, the type of string literals, registered by types_init as the first composite type
+	TYPE_STRING = NUM_BUILTIN_TYPES
+};
+
+typedef struct TYPE_INFO_t {
+	uint8_t kind;
+	uint8_t bits; // int and float types
+	TYPE_ID element; // pointer element type, function return type
+	uint8_t num_params;
+	TYPE_ID* params;
+	char* name;
+} TYPE_INFO;
+
+DECL_DYNAMIC_VECTOR(TYPE_INFO, TYPE_INFO_VEC, typevec)
+
+typedef struct TYPE_TABLE_t {
+	TYPE_INFO_VEC types;
+	ARENA data; // names and parameter lists
+	// Open addressing index of the pointer and function types, 0 is a free slot since TYPE_VOID is no composite type
+	TYPE_ID* slots;
+	long num_composites;
+	long capacity; // power of two
+} TYPE_TABLE;
+
+extern TYPE_TABLE type_table;
+
+#define TYPE_INFO_OF(type) (&type_table.types.buffer[type])
+#define TYPE_KIND_OF(type) (type_table.types.buffer[type].kind)
+
+// Conversion of a value to the type its user expects, decided by the resolver and applied by codegen
+enum CONVERSION {
+	CONV_NONE,
+	CONV_INT_EXTEND,
+	CONV_INT_TRUNCATE,
+	CONV_BOOL_TO_INT,
+	CONV_INT_TO_BOOL, // != 0
+	CONV_INT_TO_FLOAT,
+	CONV_FLOAT_TO_INT,
+	CONV_FLOAT_EXTEND,
+	CONV_FLOAT_TRUNCATE,
+	CONV_ADDRESS, // passed by reference, the value's storage is used instead of the value
+
+	CONV_INVALID
+};
+
+// Registers the builtin types and tags their names, must be called after intern_init
+void types_init();
+void types_delete();
+
+TYPE_ID type_pointer(TYPE_ID element);
+TYPE_ID type_function(TYPE_ID return_type, TYPE_ID* params, uint8_t num_params);
+// Type named by an atom, TYPE_VOID if the atom is no type name
+TYPE_ID type_from_name(char* atom);
+char* type_name(TYPE_ID type);
+
+bool type_is_numeric(TYPE_ID type);
+// Conversion that turns a value of type from into one of type to, CONV_INVALID if there is none
+uint8_t type_conversion(TYPE_ID from, TYPE_ID to);
@@ -6,11 +6,9 @@
 
 DEF_DYNAMIC_VECTOR_TERMINATED(char, DYNAMIC_STRING, string, 0)
 DEF_DYNAMIC_VECTOR(char*, STRING_VEC, strvec)
-DEF_DYNAMIC_VECTOR(VAR_DECL, VAR_DECL_VEC, vdvec)
-DEF_DYNAMIC_VECTOR(EXPRESSION, EXPR_VEC, evec)
 DEF_DYNAMIC_VECTOR(LLVMModuleRef, MODULE_VEC, mdvec)
-DEF_DYNAMIC_VECTOR(AST, AST_VEC, astvec)
 DEF_DYNAMIC_VECTOR(LLVMValueRef, VALUE_VEC, valvec)
+DEF_DYNAMIC_VECTOR(ARENA, ARENA_VEC, arenavec)
 
 void string_push_s(DYNAMIC_STRING* str, char* s) {
 	int len = strlen(s);
@@ -19,11 +17,18 @@ void string_push_s(DYNAMIC_STRING* str, char* s) {
 
 char* copy_str(char* str) {
 	int len = strlen(str);
-	char* ptr = malloc(len + 1);
+	char* ptr = mem_alloc(len + 1);
 	memcpy(ptr, str, len + 1);
 	return ptr;
 }
 
+char* copy_strn(char* str, long len) {
+	char* ptr = mem_alloc(len + 1);
+	memcpy(ptr, str, len);
+	ptr[len] = 0;
+	return ptr;
+}
+
 /*
 DYNAMIC_STRING string_new(int size) {
 	DYNAMIC_STRING str;
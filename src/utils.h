@@ -2,7 +2,15 @@
 
 #include <llvm-c/Core.h>
 
-#include "ast.h"
+#include "arena.h"
+#include "alloc.h"
+
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
 
 #define DECL_DYNAMIC_VECTOR(element, name, prefix) \
 typedef struct name##_t {\
@@ -17,13 +25,13 @@ void prefix##_push(name* v, element e);
 
 #define DEF_DYNAMIC_VECTOR(element, name, prefix) \
 name prefix##_new(long size) {\
-	return (name) { malloc(size * sizeof(element)), 0, size };\
+	return (name) { mem_alloc(size * sizeof(element)), 0, size };\
 }\
 void prefix##_delete(name* v) {\
-	free(v->buffer);\
+	mem_free(v->buffer);\
 }\
 void prefix##_resize(name* v, long size) {\
-	element* newbuf = realloc(v->buffer, size * sizeof(element));\
+	element* newbuf = mem_realloc(v->buffer, size * sizeof(element));\
 	v->buffer = newbuf;\
 	v->size = min(v->size, size);\
 	v->capacity = size;\
@@ -35,15 +43,15 @@ void prefix##_push(name* v, element e) {\
 
 #define DEF_DYNAMIC_VECTOR_TERMINATED(element, name, prefix, terminator) \
 name prefix##_new(long size) {\
-	name n = (name) { malloc((size + 1) * sizeof(element)), 0, size };\
+	name n = (name) { mem_alloc((size + 1) * sizeof(element)), 0, size };\
 	n.buffer[0] = terminator;\
 	return n;\
 }\
 void prefix##_delete(name* v) {\
-	free(v->buffer);\
+	mem_free(v->buffer);\
 }\
 void prefix##_resize(name* v, long size) {\
-	element* newbuf = realloc(v->buffer, (size + 1) * sizeof(element));\
+	element* newbuf = mem_realloc(v->buffer, (size + 1) * sizeof(element));\
 	v->buffer = newbuf;\
 	v->size = min(v->size, size);\
 	v->capacity = size;\
@@ -57,15 +65,14 @@ void prefix##_push(name* v, element e) {\
 
 DECL_DYNAMIC_VECTOR(char, DYNAMIC_STRING, string)
 DECL_DYNAMIC_VECTOR(char*, STRING_VEC, strvec)
-DECL_DYNAMIC_VECTOR(VAR_DECL, VAR_DECL_VEC, vdvec)
-DECL_DYNAMIC_VECTOR(EXPRESSION, EXPR_VEC, evec)
 DECL_DYNAMIC_VECTOR(LLVMModuleRef, MODULE_VEC, mdvec)
-DECL_DYNAMIC_VECTOR(AST, AST_VEC, astvec)
 DECL_DYNAMIC_VECTOR(LLVMValueRef, VALUE_VEC, valvec)
+DECL_DYNAMIC_VECTOR(ARENA, ARENA_VEC, arenavec)
 
 void string_push_s(DYNAMIC_STRING* str, char* s);
 
 char* copy_str(char* str);
+char* copy_strn(char* str, long len);
 
 /*
 typedef struct DYNAMIC_STRING_t {
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# AST memory and traversal benchmark: generates a 20k-line program of expressions, blocks and calls, runs
+# snekc --bench-parser on it and compares bytes per node and walk time per node with the pointer-based AST
+# the compiler had before node handles and per-kind pools.
+# Usage: test/bench_ast.py [path to snekc] [lines]
+
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+SNEKC = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), "..", "build", "snekc")
+LINES = int(sys.argv[2]) if len(sys.argv) > 2 else 20000
+
+# Measured on this program with the baseline sources at -O2 on x86-64: 117305 nodes in 40 byte EXPRESSION unions
+# plus 5333 heap allocated blocks, walked recursively through the child pointers. The same machine walks the
+# current AST at 5-6 ns/node.
+BASELINE_BYTES_PER_NODE = 40.7
+BASELINE_WALK_NS_PER_NODE = 19.5
+
+def generate(lines):
+	out = ["decl printf(i8 format)"]
+	f = 0
+	while len(out) + 15 <= lines:
+		out += [
+			"def f%d(i64 a, i64 b) {" % f,
+			"\tx = a * 3 + (b - 1) / 2 - a % 7",
+			"\ty = (x + a) * (x - b) + f%d(x, a + 1)" % max(f - 1, 0),
+			"\tif x > y && a != 0 {",
+			"\t\tb = b + x * 2",
+			"\t} else {",
+			"\t\tb = b - y / 3",
+			"\t}",
+			"\ti = 0",
+			"\twhile i++ < 10 {",
+			"\t\tx = x + i * (a - b)",
+			"\t}",
+			"\tprintf(\"%d\\n\")",
+			"\tret x + y + b",
+			"}",
+		]
+		f += 1
+	return "\n".join(out) + "\n"
+
+with tempfile.TemporaryDirectory() as tmp:
+	path = os.path.join(tmp, "bench_ast.sn")
+	with open(path, "w") as f:
+		f.write(generate(LINES))
+	output = subprocess.run([SNEKC, path, "--bench-parser"], stdout=subprocess.PIPE, check=True).stdout.decode()
+
+print(output.rstrip())
+match = re.search(r"AST ([\d.]+) bytes/node, walk ([\d.]+) ns/node", output)
+if not match:
+	sys.exit("No AST figures in the --bench-parser output")
+bytes_per_node, walk_ns = float(match.group(1)), float(match.group(2))
+print()
+print("%-12s %12s %12s" % ("", "bytes/node", "walk ns/node"))
+print("%-12s %12.1f %12.2f" % ("baseline", BASELINE_BYTES_PER_NODE, BASELINE_WALK_NS_PER_NODE))
+print("%-12s %12.1f %12.2f" % ("current", bytes_per_node, walk_ns))
+print("%-12s %11.2fx %11.2fx" % ("ratio", bytes_per_node / BASELINE_BYTES_PER_NODE, walk_ns / BASELINE_WALK_NS_PER_NODE))
@@ -0,0 +1,22 @@
+#!/bin/sh
+# Compiles the test programs with --leak-check in the main configurations and fails if any block is left allocated.
+# Compile errors in the programs are expected (test.sn checks diagnostics), only leaks fail the check.
+# Usage: test/check_leaks.sh [path to snekc]
+cd "$(dirname "$0")"
+SNEKC=${1:-../build/snekc}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+status=0
+for options in "" "-O2 -j2" "--lto" "--lto=thin -j2"; do
+	for files in main.sn syntax.sn test.sn "main.sn test_module.sn"; do
+		leaks=$("$SNEKC" $files $options --emit=tokens,ast,llvm,exe -o "$OUT/out" --leak-check 2>&1 | grep "^Leaked")
+		if [ -n "$leaks" ]; then
+			echo "FAIL $files $options"
+			echo "$leaks"
+			status=1
+		else
+			echo "ok   $files $options"
+		fi
+	done
+done
+exit $status
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+# Stress checks for deep nesting and long files: generates each shape at 1/4, 1/2 and full size, compiles it with
+# snekc and fails if a compile fails or the time grows clearly faster than the input (linear would be 4x over the range).
+# Usage: test/stress.py [path to snekc] [full size]
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+SNEKC = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), "..", "build", "snekc")
+SIZE = int(sys.argv[2]) if len(sys.argv) > 2 else 1000000
+MAX_GROWTH = 6.0
+
+def function(body):
+	return "def f(i64 a) {\n" + body + "\n}\n"
+
+SHAPES = {
+	"assign chain": lambda n: function("\ta" + " = a" * n),
+	"add chain": lambda n: function("\tx = a" + " + a" * n),
+	"prefix minus": lambda n: function("\tx = " + "- " * n + "a"),
+	"nested parentheses": lambda n: function("\tx = " + "(" * n + "a" + ")" * n),
+	# Blocks generate a basic block per level, a tenth of the size is already deep enough
+	"nested blocks": lambda n: function("if a {\n" * (n // 10) + "a = 1\n" + "}\n" * (n // 10)),
+	"statements": lambda n: function("\ta = a + 1\n" * n),
+}
+
+def compile_time(path):
+	start = time.perf_counter()
+	result = subprocess.run([SNEKC, path, "--emit=ast,llvm", "-o", os.devnull], stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+	elapsed = time.perf_counter() - start
+	if result.returncode != 0:
+		raise RuntimeError("exit code %d %s" % (result.returncode, result.stderr.decode(errors="replace").strip()))
+	return elapsed
+
+failed = False
+with tempfile.TemporaryDirectory() as tmp:
+	path = os.path.join(tmp, "stress.sn")
+	for name, generate in SHAPES.items():
+		times = []
+		try:
+			for n in (SIZE // 4, SIZE // 2, SIZE):
+				with open(path, "w") as f:
+					f.write(generate(n))
+				times.append(compile_time(path))
+		except RuntimeError as e:
+			print("FAIL %-20s %s" % (name, e))
+			failed = True
+			continue
+		growth = times[-1] / max(times[0], 1e-3)
+		status = "ok" if growth <= MAX_GROWTH else "FAIL"
+		failed |= status != "ok"
+		print("%-4s %-20s %s  (%.1fx for 4x the size)" % (status, name, "  ".join("%.3fs" % t for t in times), growth))
+
+sys.exit(1 if failed else 0)